@@ -17,50 +17,57 @@
 
 #include <esp_gpio.h>
 #include <esp_dht22.h>
+#include <esp_sched.h>
 #include <esp_sdo.h>
 #include <esp_util.h>
 #include <user_interface.h>
 #include <mem.h>
 
-os_timer_t timer;
 
-
-void ICACHE_FLASH_ATTR
-sys_init_done(void* arg)
+bool ICACHE_FLASH_ATTR
+dht22_job(void* arg)
 {
   esp_dht22_err err;
-  esp_dht22_dev *dev = esp_dht22_new_dev(GPIO2);
+  esp_dht22_dev *dev = arg;
 
   // Get temperature.
   err = esp_dht22_get(dev);
   if (err != ESP_DHT22_OK) {
-    os_free(dev);
     os_printf("DHT22 error code: %d\n", err);
-    return;
+    return false;
   }
 
   os_printf("Temp: %s\n", esp_util_ftoa(dev->temp, 3));
   os_printf("Hum: %s\n", esp_util_ftoa(dev->hum, 3));
   os_printf("--------------------\n");
-  os_free(dev);
+
+  return false;
 }
 
 void ICACHE_FLASH_ATTR
 user_init()
 {
+  esp_sched_job *job;
+
   // No need for wifi for this example.
   wifi_station_disconnect();
   wifi_set_opmode_current(NULL_MODE);
 
-  //system_init_done_cb(sys_init_done);
   stdout_init(BIT_RATE_74880);
 
   // Initialize DHT22 on GPIO 2.
   esp_dht22_init(GPIO2);
 
-  // Wait before running main code.
+  // Read the sensor every 2.5s. Bit-banged read is exclusive.
+  job = esp_sched_new(dht22_job, esp_dht22_new_dev(GPIO2), 2500, 0, true);
+  if (job == NULL || job->arg == NULL) {
+    os_printf("Out of memory.\n");
+    return;
+  }
+
   os_printf("Initialized.\n");
-  os_timer_disarm(&timer);
-  os_timer_setfn(&timer, sys_init_done, NULL);
-  os_timer_arm(&timer, 1500, true);
+  esp_sched_add(job);
+  // Give the sensor time to wake up before the first read.
+  esp_sched_delay(job, 1500);
+  esp_sched_start();
 }
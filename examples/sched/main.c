@@ -0,0 +1,164 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <esp_sched.h>
+#include <esp_ds18b20.h>
+#include <esp_dht22.h>
+#include <esp_sht21.h>
+#include <esp_gpio.h>
+#include <esp_eb.h>
+#include <esp_sdo.h>
+#include <esp_util.h>
+#include <user_interface.h>
+
+#define OW_GPIO GPIO2
+#define DHT22_GPIO GPIO4
+#define SCL GPIO0
+#define SDA GPIO5
+
+// List of found devices on the OneWire bus.
+static esp_ow_device *root = NULL;
+static esp_dht22_dev *dht22;
+static esp_sht21_dev *sht21;
+
+static esp_sched_job *ds18b20_job;
+static esp_sched_job *dht22_job;
+static esp_sched_job *sht21_job;
+static esp_sched_job *stats_job;
+
+
+// Bus conversion finished, the job gives the bus back.
+static void ICACHE_FLASH_ATTR
+ds18b20_ready(const char *event, void *arg)
+{
+  esp_ow_device *dev;
+  esp_ds18b20_st *st;
+
+  for (dev = arg; dev; dev = dev->next) {
+    st = dev->custom;
+    os_printf("DS18B20 %02X%02X: %d mC\n", dev->rom[6], dev->rom[7],
+              esp_ds18b20_raw_to_mc(st->raw));
+  }
+
+  esp_sched_done(ds18b20_job);
+}
+
+static bool ICACHE_FLASH_ATTR
+ds18b20_run(void *arg)
+{
+  // Finishes asynchronously in ds18b20_ready.
+  return esp_ds18b20_convert_all(OW_GPIO, root) == ESP_DS18B20_OK;
+}
+
+static bool ICACHE_FLASH_ATTR
+dht22_run(void *arg)
+{
+  esp_dht22_err err = esp_dht22_get(dht22);
+
+  if (err != ESP_DHT22_OK) {
+    os_printf("DHT22 error code: %d\n", err);
+  } else {
+    os_printf("DHT22: %s deg. C, ", esp_util_ftoa(dht22->temp, 1));
+    os_printf("%s%%\n", esp_util_ftoa(dht22->hum, 1));
+  }
+
+  return false;
+}
+
+static bool ICACHE_FLASH_ATTR
+sht21_run(void *arg)
+{
+  esp_sht21_smpl smpl;
+  esp_i2c_err err = esp_sht21_sample(sht21, &smpl);
+
+  if (err != ESP_I2C_OK) {
+    os_printf("SHT21 error code: %d\n", err);
+  } else {
+    os_printf("SHT21: %s deg. C, ", esp_util_ftoa(smpl.temp, 2));
+    os_printf("%s%%\n", esp_util_ftoa(smpl.rh, 2));
+  }
+
+  return false;
+}
+
+static void ICACHE_FLASH_ATTR
+print_job(const char *name, esp_sched_job *job)
+{
+  os_printf("%s: runs %d, missed %d, jitter max %dus avg %dus\n",
+            name, job->runs, job->missed, job->jitter_max_us,
+            job->runs ? job->jitter_sum_us / job->runs : 0);
+
+  esp_sched_reset_stats(job);
+}
+
+static bool ICACHE_FLASH_ATTR
+stats_run(void *arg)
+{
+  print_job("DS18B20", ds18b20_job);
+  print_job("DHT22", dht22_job);
+  print_job("SHT21", sht21_job);
+
+  return false;
+}
+
+static void ICACHE_FLASH_ATTR
+sys_init_done()
+{
+  esp_ow_err err;
+
+  esp_ds18b20_init(OW_GPIO);
+  err = esp_ds18b20_search(OW_GPIO, false, &root);
+  if (err != ESP_OW_OK) os_printf("DS18B20 search error: %d\n", err);
+
+  esp_dht22_init(DHT22_GPIO);
+  dht22 = esp_dht22_new_dev(DHT22_GPIO);
+
+  esp_sht21_init(SCL, SDA);
+  sht21 = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+
+  esp_eb_attach(ESP_DS18B20_EV_BUS_READY, ds18b20_ready);
+
+  // Bit-banged DHT22 and SHT21 reads are exclusive. DS18B20 job holds
+  // the bus only to send commands and read scratchpads so it's not.
+  ds18b20_job = esp_sched_new(ds18b20_run, NULL, 5000, 0, false);
+  dht22_job = esp_sched_new(dht22_run, NULL, 2500, 1, true);
+  sht21_job = esp_sched_new(sht21_run, NULL, 5000, 2, true);
+  stats_job = esp_sched_new(stats_run, NULL, 60000, 10, false);
+
+  if (!ds18b20_job || !dht22_job || !sht21_job || !stats_job) {
+    os_printf("Out of memory.\n");
+    return;
+  }
+
+  esp_sched_add(ds18b20_job);
+  esp_sched_add(dht22_job);
+  esp_sched_add(sht21_job);
+  esp_sched_add(stats_job);
+
+  esp_sched_start();
+}
+
+void ICACHE_FLASH_ATTR
+user_init()
+{
+  // No need for wifi for this example.
+  wifi_station_disconnect();
+  wifi_set_opmode_current(NULL_MODE);
+
+  stdout_init(BIT_RATE_74880);
+  system_init_done_cb(sys_init_done);
+}
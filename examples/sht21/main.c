@@ -19,6 +19,7 @@
 #include <esp_sdo.h>
 #include <esp_util.h>
 #include <user_interface.h>
+#include <mem.h>
 
 #define SCL GPIO0
 #define SDA GPIO2
@@ -29,9 +30,10 @@ void ICACHE_FLASH_ATTR
 run_sht21()
 {
   uint8_t rev;
-  float value;
+  esp_sht21_smpl smpl;
   uint8_t sn[8];
   esp_i2c_err err;
+  esp_sht21_dev *dev;
 
   err = esp_sht21_init(SCL, SDA);
   if (err != ESP_I2C_OK) {
@@ -39,27 +41,31 @@ run_sht21()
     return;
   }
 
-  err = esp_sht21_get_sn(sn);
+  dev = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+  if (dev == NULL) {
+    os_printf("SHT21 out of memory.\n");
+    return;
+  }
+
+  err = esp_sht21_get_sn(dev, sn);
   if (err != ESP_I2C_OK) os_printf("SHT21 sn error %d.\n", err);
 
   os_printf("SHT21 SN: %02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X\n",
             sn[0], sn[1], sn[2], sn[3],
             sn[4], sn[5], sn[6], sn[7]);
 
-  err = esp_sht21_get_rev(&rev);
+  err = esp_sht21_get_rev(dev, &rev);
   if (err != ESP_I2C_OK) os_printf("SHT21 sn error %d.\n", err);
 
   os_printf("Firmware rev: 0x%02X\n", rev);
 
-  err = esp_sht21_get_rh(&value);
-  if (err != ESP_I2C_OK) os_printf("Get RH error: %d\n", err);
-
-  os_printf("Humidity: %s%%\n", esp_util_ftoa(value, 2));
+  err = esp_sht21_sample(dev, &smpl);
+  if (err != ESP_I2C_OK) os_printf("Get sample error: %d\n", err);
 
-  err = esp_sht21_get_temp_last(&value);
-  if (err != ESP_I2C_OK) os_printf("Get TEMP error: %d\n", err);
+  os_printf("Humidity: %s%%\n", esp_util_ftoa(smpl.rh, 2));
+  os_printf("Temperature: %s deg. C\n", esp_util_ftoa(smpl.temp, 2));
 
-  os_printf("Temperature: %s deg. C\n", esp_util_ftoa(value, 2));
+  os_free(dev);
 }
 
 void ICACHE_FLASH_ATTR
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <esp_batch.h>
+#include <esp_crc.h>
+
+// Record header bits.
+#define HDR_SLOT_MASK 0x3F // Series slot index.
+#define HDR_STATUS 0x40    // Status byte follows, no value.
+#define HDR_NEW 0x80       // New series, id and type bytes follow.
+
+#if ESP_BATCH_SERIES > HDR_SLOT_MASK + 1
+  #error "ESP_BATCH_SERIES does not fit in record header slot index (max 64)."
+#endif
+
+// Series state.
+typedef struct {
+  uint8_t id;
+  uint8_t type;
+  uint16_t last[2]; // Last values (DHT22 uses both halves).
+  uint32_t tq;      // Last time in ESP_BATCH_TIME_US units from the first record.
+  int32_t dtq;      // Last time delta.
+} series_st;
+
+// Encoder / decoder buffer.
+typedef struct {
+  uint8_t *buf;
+  uint16_t len;
+  uint16_t size;
+} stream;
+
+
+/**
+ * Get number of 16 bit values in the record type.
+ */
+static uint8_t ICACHE_FLASH_ATTR
+val_cnt(uint8_t type)
+{
+  return (uint8_t) (type == ESP_RING_DHT22 ? 2 : 1);
+}
+
+/**
+ * Get number of always zero low bits in the record type values.
+ */
+static uint8_t ICACHE_FLASH_ATTR
+val_shift(uint8_t type)
+{
+  // SHT21 status bits are cleared.
+  return (uint8_t) (type == ESP_RING_SHT21_RH || type == ESP_RING_SHT21_TEMP ? 2 : 0);
+}
+
+static uint32_t ICACHE_FLASH_ATTR
+zigzag(int32_t val)
+{
+  return ((uint32_t) val << 1) ^ (uint32_t) (val >> 31);
+}
+
+static int32_t ICACHE_FLASH_ATTR
+unzigzag(uint32_t val)
+{
+  return (int32_t) (val >> 1) ^ -(int32_t) (val & 1);
+}
+
+static bool ICACHE_FLASH_ATTR
+put_byte(stream *s, uint8_t val)
+{
+  if (s->len >= s->size) return false;
+  s->buf[s->len++] = val;
+
+  return true;
+}
+
+static bool ICACHE_FLASH_ATTR
+put_varint(stream *s, uint32_t val)
+{
+  while (val > 0x7F) {
+    if (!put_byte(s, (uint8_t) (val | 0x80))) return false;
+    val >>= 7;
+  }
+
+  return put_byte(s, (uint8_t) val);
+}
+
+static bool ICACHE_FLASH_ATTR
+get_byte(stream *s, uint8_t *val)
+{
+  if (s->len >= s->size) return false;
+  *val = s->buf[s->len++];
+
+  return true;
+}
+
+static bool ICACHE_FLASH_ATTR
+get_varint(stream *s, uint32_t *val)
+{
+  uint8_t byte;
+  uint8_t shift = 0;
+
+  *val = 0;
+  do {
+    if (shift > 28 || !get_byte(s, &byte)) return false;
+    *val |= (uint32_t) (byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  return true;
+}
+
+/**
+ * Split record raw value into 16 bit values.
+ */
+static void ICACHE_FLASH_ATTR
+rec_vals(const esp_ring_rec *rec, uint16_t *vals)
+{
+  uint8_t shift = val_shift(rec->type);
+
+  if (val_cnt(rec->type) == 2) {
+    vals[0] = (uint16_t) (rec->raw >> 16);
+    vals[1] = (uint16_t) rec->raw;
+  } else {
+    vals[0] = (uint16_t) (rec->raw >> shift);
+  }
+}
+
+/**
+ * Encode one record.
+ *
+ * @return Returns false when frame buffer or series table is full.
+ */
+static bool ICACHE_FLASH_ATTR
+encode_rec(stream *s, const esp_ring_rec *rec, uint32_t t0, series_st *series, uint8_t *series_cnt)
+{
+  uint8_t idx;
+  uint8_t hdr;
+  uint16_t vals[2];
+  series_st *ser = NULL;
+  uint32_t tq = (rec->time - t0) / ESP_BATCH_TIME_US;
+  int32_t dtq;
+
+  for (idx = 0; idx < *series_cnt; idx++) {
+    if (series[idx].id == rec->id && series[idx].type == rec->type) {
+      ser = &series[idx];
+      break;
+    }
+  }
+
+  hdr = idx;
+  if (rec->status != 0) hdr |= HDR_STATUS;
+
+  if (ser == NULL) {
+    if (*series_cnt == ESP_BATCH_SERIES) return false;
+    hdr |= HDR_NEW;
+
+    if (!put_byte(s, hdr)) return false;
+    if (!put_byte(s, rec->id)) return false;
+    if (!put_byte(s, rec->type)) return false;
+    if (!put_varint(s, tq)) return false;
+    dtq = 0;
+  } else {
+    // Periodic series have constant time delta.
+    dtq = (int32_t) (tq - ser->tq);
+
+    if (!put_byte(s, hdr)) return false;
+    if (!put_varint(s, zigzag(dtq - ser->dtq))) return false;
+  }
+
+  if (rec->status != 0) {
+    if (!put_byte(s, rec->status)) return false;
+  } else {
+    rec_vals(rec, vals);
+    for (idx = 0; idx < val_cnt(rec->type); idx++) {
+      // First value of the series is stored as delta from zero.
+      int16_t delta = (int16_t) (vals[idx] - (ser ? ser->last[idx] : 0));
+      if (!put_varint(s, zigzag(delta))) return false;
+    }
+  }
+
+  // Commit series state only when whole record fits.
+  if (ser == NULL) {
+    ser = &series[(*series_cnt)++];
+    ser->id = rec->id;
+    ser->type = rec->type;
+    ser->last[0] = 0;
+    ser->last[1] = 0;
+  }
+
+  if (rec->status == 0) {
+    ser->last[0] = vals[0];
+    if (val_cnt(rec->type) == 2) ser->last[1] = vals[1];
+  }
+  ser->tq = tq;
+  ser->dtq = dtq;
+
+  return true;
+}
+
+uint16_t ICACHE_FLASH_ATTR
+esp_batch_encode(const esp_ring_rec *recs, uint16_t cnt, uint8_t *buf, uint16_t size, uint16_t *len)
+{
+  uint16_t idx;
+  uint16_t rec_len;
+  uint8_t series_cnt = 0;
+  series_st series[ESP_BATCH_SERIES];
+  stream s = {buf, 0, (uint16_t) (size - 1)}; // Leave space for CRC.
+
+  *len = 0;
+  if (cnt > 0xFF) cnt = 0xFF;
+  if (size < ESP_BATCH_OVERHEAD) return 0;
+
+  put_byte(&s, ESP_BATCH_VERSION);
+  put_byte(&s, 0); // Record count set at the end.
+  put_varint(&s, cnt ? recs[0].time : 0);
+
+  for (idx = 0; idx < cnt; idx++) {
+    rec_len = s.len;
+    if (!encode_rec(&s, &recs[idx], recs[0].time, series, &series_cnt)) {
+      s.len = rec_len;
+      break;
+    }
+  }
+
+  buf[1] = (uint8_t) idx;
+  buf[s.len] = esp_crc8_ow(0, buf, s.len);
+  *len = (uint16_t) (s.len + 1);
+
+  return idx;
+}
+
+bool ICACHE_FLASH_ATTR
+esp_batch_decode(const uint8_t *buf, uint16_t len, esp_ring_rec *recs, uint16_t max, uint16_t *cnt)
+{
+  uint8_t hdr;
+  uint8_t idx;
+  uint8_t rec_cnt;
+  uint8_t series_cnt = 0;
+  uint16_t vals[2];
+  uint32_t t0;
+  uint32_t val;
+  series_st *ser;
+  esp_ring_rec *rec;
+  series_st series[ESP_BATCH_SERIES];
+  stream s = {(uint8_t *) buf, 0, (uint16_t) (len - 1)};
+
+  *cnt = 0;
+  if (len < 4 || esp_crc8_ow(0, buf, len) != 0) return false;
+
+  get_byte(&s, &hdr);
+  if (hdr != ESP_BATCH_VERSION) return false;
+  get_byte(&s, &rec_cnt);
+  if (!get_varint(&s, &t0)) return false;
+
+  while (*cnt < rec_cnt && *cnt < max) {
+    rec = &recs[*cnt];
+    *rec = (esp_ring_rec) {0};
+
+    if (!get_byte(&s, &hdr)) return false;
+    idx = (uint8_t) (hdr & HDR_SLOT_MASK);
+
+    if (hdr & HDR_NEW) {
+      if (idx != series_cnt || series_cnt == ESP_BATCH_SERIES) return false;
+      ser = &series[series_cnt++];
+      *ser = (series_st) {0};
+      if (!get_byte(&s, &ser->id)) return false;
+      if (!get_byte(&s, &ser->type)) return false;
+      if (!get_varint(&s, &ser->tq)) return false;
+    } else {
+      if (idx >= series_cnt) return false;
+      ser = &series[idx];
+      if (!get_varint(&s, &val)) return false;
+      ser->dtq += unzigzag(val);
+      ser->tq += ser->dtq;
+    }
+
+    rec->id = ser->id;
+    rec->type = ser->type;
+    rec->time = t0 + ser->tq * ESP_BATCH_TIME_US;
+
+    if (hdr & HDR_STATUS) {
+      if (!get_byte(&s, &rec->status)) return false;
+    } else {
+      for (idx = 0; idx < val_cnt(ser->type); idx++) {
+        if (!get_varint(&s, &val)) return false;
+        ser->last[idx] = (uint16_t) (ser->last[idx] + unzigzag(val));
+        vals[idx] = ser->last[idx];
+      }
+
+      if (val_cnt(ser->type) == 2) {
+        rec->raw = ((uint32_t) vals[0] << 16) | vals[1];
+      } else {
+        rec->raw = (uint32_t) vals[0] << val_shift(ser->type);
+      }
+    }
+
+    (*cnt)++;
+  }
+
+  return true;
+}
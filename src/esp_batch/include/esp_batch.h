@@ -0,0 +1,91 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef ESP_BATCH_H
+#define ESP_BATCH_H
+
+#include <esp_ring.h>
+#ifdef __XTENSA__
+  #include <c_types.h>
+#else
+  // Host (gateway) build without ESP8266 SDK.
+  #include <stdint.h>
+  #include <stdbool.h>
+  #include <stddef.h>
+  #ifndef ICACHE_FLASH_ATTR
+    #define ICACHE_FLASH_ATTR
+  #endif
+#endif
+
+// Batch frame format version.
+#define ESP_BATCH_VERSION 1
+
+// Maximum number of series (sensor id and type pairs) in one batch.
+// Series index is 6 bits of record header so it's at most 64.
+#ifndef ESP_BATCH_SERIES
+  #define ESP_BATCH_SERIES 16
+#endif
+
+// Time resolution in microseconds.
+#ifndef ESP_BATCH_TIME_US
+  #define ESP_BATCH_TIME_US 1000
+#endif
+
+// Frame header, first record time and CRC worst case size.
+#define ESP_BATCH_OVERHEAD 8
+
+
+/**
+ * Encode sample records into batch frame.
+ *
+ * Records are stored in order. Each sensor series (sensor id and type pair)
+ * is delta encoded with zigzag varints. Record times are delta-of-delta
+ * encoded per series with ESP_BATCH_TIME_US resolution. Raw values of
+ * failed reads are not stored. Frame ends with OneWire CRC8.
+ *
+ * A series sampled at constant period with slowly changing value takes
+ * 3 bytes per record (4 bytes for DHT22).
+ *
+ * @param recs The records to encode.
+ * @param cnt  The number of records (maximum 255).
+ * @param buf  The frame buffer.
+ * @param size The frame buffer size.
+ * @param len  Set to the frame length.
+ *
+ * @return The number of encoded records. Fewer then cnt when frame buffer
+ *         or series table is full.
+ */
+uint16_t ICACHE_FLASH_ATTR
+esp_batch_encode(const esp_ring_rec *recs, uint16_t cnt, uint8_t *buf, uint16_t size, uint16_t *len);
+
+/**
+ * Decode batch frame.
+ *
+ * Decoded record times are rounded down to ESP_BATCH_TIME_US
+ * (relative to the first record). Failed reads have raw set to zero.
+ *
+ * @param buf  The frame.
+ * @param len  The frame length.
+ * @param recs The buffer for decoded records.
+ * @param max  The buffer size.
+ * @param cnt  Set to the number of decoded records.
+ *
+ * @return Returns true on success, false on CRC or format error.
+ */
+bool ICACHE_FLASH_ATTR
+esp_batch_decode(const uint8_t *buf, uint16_t len, esp_ring_rec *recs, uint16_t max, uint16_t *cnt);
+
+#endif //ESP_BATCH_H
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <esp_bulk.h>
+#include <esp_crc.h>
+#include <esp_conv.h>
+
+// DS18B20 and SHT21 kernels run in two passes. The first validates all
+// frames with CRC kernel working on many frames at once, the second
+// converts them with straight line integer code (esp_conv.h). Both
+// vectorize on hosts. Invalid frames are converted too and flagged.
+
+
+/**
+ * Validate SHT21 measurements and extract raw words.
+ *
+ * @return The number of measurements with valid CRC.
+ */
+static uint32_t ICACHE_FLASH_ATTR
+sht21_raw(const uint8_t *meas, uint32_t cnt, esp_bulk_sht21 *out)
+{
+  uint32_t idx;
+  uint32_t valid = 0;
+
+  // CRC over measurement and its CRC is zero.
+  esp_crc8_sht_frames(meas, 3, cnt, out->ok);
+  for (idx = 0; idx < cnt; idx++) {
+    out->ok[idx] = (uint8_t) (out->ok[idx] == 0);
+    valid += out->ok[idx];
+  }
+
+  for (idx = 0; idx < cnt; idx++) {
+    out->raw[idx] = esp_conv_sht21_word(&meas[idx * 3]);
+  }
+
+  return valid;
+}
+
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_ds18b20_decode(const uint8_t *sp, uint32_t cnt, esp_bulk_ds18b20 *out)
+{
+  uint32_t idx;
+  uint32_t valid = 0;
+
+  esp_crc8_ow_frames(sp, 9, cnt, out->ok);
+  for (idx = 0; idx < cnt; idx++) {
+    out->ok[idx] = (uint8_t) (out->ok[idx] == 0);
+    valid += out->ok[idx];
+  }
+
+  for (idx = 0; idx < cnt; idx++) {
+    out->raw[idx] = esp_conv_ds18b20_raw(&sp[idx * 9]);
+  }
+
+  for (idx = 0; idx < cnt; idx++) {
+    out->temp_mc[idx] = esp_conv_ds18b20_mc(out->raw[idx]);
+  }
+
+  return valid;
+}
+
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_dht22_decode(const uint8_t *frame, uint32_t cnt, esp_bulk_dht22 *out)
+{
+  uint32_t idx;
+  uint32_t valid = 0;
+
+  // Parity is cheap so validation and conversion share one pass.
+  for (idx = 0; idx < cnt; idx++) {
+    out->ok[idx] = (uint8_t) esp_conv_dht22_parity(&frame[idx * 5]);
+    out->hum_dp[idx] = esp_conv_dht22_hum(&frame[idx * 5]);
+    out->temp_dc[idx] = esp_conv_dht22_temp(&frame[idx * 5]);
+    valid += out->ok[idx];
+  }
+
+  return valid;
+}
+
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_sht21_rh_decode(const uint8_t *meas, uint32_t cnt, esp_bulk_sht21 *out)
+{
+  uint32_t idx;
+  uint32_t valid = sht21_raw(meas, cnt, out);
+
+  for (idx = 0; idx < cnt; idx++) {
+    out->value[idx] = esp_conv_sht21_rh(out->raw[idx]);
+  }
+
+  return valid;
+}
+
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_sht21_temp_decode(const uint8_t *meas, uint32_t cnt, esp_bulk_sht21 *out)
+{
+  uint32_t idx;
+  uint32_t valid = sht21_raw(meas, cnt, out);
+
+  for (idx = 0; idx < cnt; idx++) {
+    out->value[idx] = esp_conv_sht21_temp(out->raw[idx]);
+  }
+
+  return valid;
+}
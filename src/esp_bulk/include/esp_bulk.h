@@ -0,0 +1,104 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef ESP_BULK_H
+#define ESP_BULK_H
+
+#ifdef __XTENSA__
+  #include <c_types.h>
+#else
+  // Host (gateway) build without ESP8266 SDK.
+  #include <stdint.h>
+  #include <stdbool.h>
+  #ifndef ICACHE_FLASH_ATTR
+    #define ICACHE_FLASH_ATTR
+  #endif
+#endif
+
+// Decoded DS18B20 scratchpads (structure of arrays).
+typedef struct {
+  int16_t *raw;     // Temperature register in 1/16 Celsius.
+  int32_t *temp_mc; // Temperature in milli Celsius.
+  uint8_t *ok;      // Set to 1 when CRC is valid, 0 otherwise.
+} esp_bulk_ds18b20;
+
+// Decoded DHT22 frames (structure of arrays).
+typedef struct {
+  int16_t *hum_dp;  // Humidity in 0.1 percent.
+  int16_t *temp_dc; // Temperature in 0.1 Celsius.
+  uint8_t *ok;      // Set to 1 when parity is valid, 0 otherwise.
+} esp_bulk_dht22;
+
+// Decoded SHT21 measurements (structure of arrays).
+typedef struct {
+  uint16_t *raw;    // Measurement word with status bits cleared.
+  int32_t *value;   // Humidity in 0.01 percent or temperature in 0.01 Celsius.
+  uint8_t *ok;      // Set to 1 when CRC is valid, 0 otherwise.
+} esp_bulk_sht21;
+
+
+/**
+ * Decode DS18B20 scratchpads.
+ *
+ * Undefined bits for the resolution set in configuration register
+ * are cleared the same way the driver does it.
+ *
+ * @param sp  The cnt * 9 bytes of scratchpads.
+ * @param cnt The number of scratchpads.
+ * @param out The output arrays with at least cnt elements each.
+ *
+ * @return The number of scratchpads with valid CRC.
+ */
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_ds18b20_decode(const uint8_t *sp, uint32_t cnt, esp_bulk_ds18b20 *out);
+
+/**
+ * Decode DHT22 frames.
+ *
+ * @param frame The cnt * 5 bytes of frames.
+ * @param cnt   The number of frames.
+ * @param out   The output arrays with at least cnt elements each.
+ *
+ * @return The number of frames with valid parity.
+ */
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_dht22_decode(const uint8_t *frame, uint32_t cnt, esp_bulk_dht22 *out);
+
+/**
+ * Decode SHT21 humidity measurements.
+ *
+ * @param meas The cnt * 3 bytes of measurements (MSB, LSB, CRC).
+ * @param cnt  The number of measurements.
+ * @param out  The output arrays with at least cnt elements each.
+ *
+ * @return The number of measurements with valid CRC.
+ */
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_sht21_rh_decode(const uint8_t *meas, uint32_t cnt, esp_bulk_sht21 *out);
+
+/**
+ * Decode SHT21 temperature measurements.
+ *
+ * @param meas The cnt * 3 bytes of measurements (MSB, LSB, CRC).
+ * @param cnt  The number of measurements.
+ * @param out  The output arrays with at least cnt elements each.
+ *
+ * @return The number of measurements with valid CRC.
+ */
+uint32_t ICACHE_FLASH_ATTR
+esp_bulk_sht21_temp_decode(const uint8_t *meas, uint32_t cnt, esp_bulk_sht21 *out);
+
+#endif //ESP_BULK_H
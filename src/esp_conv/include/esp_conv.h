@@ -0,0 +1,180 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#ifndef ESP_CONV_H
+#define ESP_CONV_H
+
+#ifdef __XTENSA__
+  #include <c_types.h>
+#else
+  // Host (gateway) build without ESP8266 SDK.
+  #include <stdint.h>
+  #include <stdbool.h>
+#endif
+
+// Raw device value conversions shared by the drivers and the bulk decoder.
+//
+// All functions are static inline and branch free so they inline into
+// the bulk decoder loops which compilers can vectorize.
+
+
+/**
+ * Get DS18B20 temperature register from scratchpad.
+ *
+ * Bits undefined for the resolution set in configuration register
+ * are cleared.
+ *
+ * @param sp The 9 bytes of scratchpad.
+ *
+ * @return The temperature in 1/16 Celsius.
+ */
+static inline int16_t
+esp_conv_ds18b20_raw(const uint8_t *sp)
+{
+  int16_t raw = (int16_t) (sp[0] | (sp[1] << 8));
+
+  // At 12 bits all bits are defined, at 9 bits three LSB bits are undefined.
+  return (int16_t) (raw & ~((0x8 >> ((sp[4] & 0x60) >> 5)) - 1));
+}
+
+/**
+ * Convert DS18B20 temperature register to milli Celsius.
+ *
+ * @param raw The temperature in 1/16 Celsius.
+ *
+ * @return The temperature in milli Celsius.
+ */
+static inline int32_t
+esp_conv_ds18b20_mc(int16_t raw)
+{
+  // One LSB is 1/16 Celsius which is 62.5 milli Celsius.
+  return ((int32_t) raw * 125) / 2;
+}
+
+/**
+ * Check DHT22 frame parity.
+ *
+ * @param frame The 5 bytes of frame.
+ *
+ * @return Returns true when parity is valid.
+ */
+static inline bool
+esp_conv_dht22_parity(const uint8_t *frame)
+{
+  return (uint8_t) (frame[0] + frame[1] + frame[2] + frame[3]) == frame[4];
+}
+
+/**
+ * Get DHT22 humidity.
+ *
+ * @param frame The 5 bytes of frame.
+ *
+ * @return The humidity in 0.1 percent.
+ */
+static inline int16_t
+esp_conv_dht22_hum(const uint8_t *frame)
+{
+  return (int16_t) ((frame[0] << 8) | frame[1]);
+}
+
+/**
+ * Get DHT22 temperature.
+ *
+ * @param frame The 5 bytes of frame.
+ *
+ * @return The temperature in 0.1 Celsius.
+ */
+static inline int16_t
+esp_conv_dht22_temp(const uint8_t *frame)
+{
+  // Temperature is sign and magnitude.
+  int16_t temp = (int16_t) (((frame[2] & 0x7F) << 8) | frame[3]);
+
+  return (int16_t) ((frame[2] & 0x80) ? -temp : temp);
+}
+
+/**
+ * Get SHT21 measurement word.
+ *
+ * @param meas The measurement MSB and LSB.
+ *
+ * @return The measurement with status bits cleared.
+ */
+static inline uint16_t
+esp_conv_sht21_word(const uint8_t *meas)
+{
+  return (uint16_t) (((meas[0] << 8) | meas[1]) & ~0x3);
+}
+
+/**
+ * Convert SHT21 humidity measurement.
+ *
+ * RH = -6 + 125 * S / 2^16
+ *
+ * @param word The measurement with status bits cleared.
+ *
+ * @return The humidity in 0.01 percent.
+ */
+static inline int32_t
+esp_conv_sht21_rh(uint16_t word)
+{
+  return (int32_t) ((12500 * (uint32_t) word) >> 16) - 600;
+}
+
+/**
+ * Convert SHT21 temperature measurement.
+ *
+ * T = -46.85 + 175.72 * S / 2^16
+ *
+ * @param word The measurement with status bits cleared.
+ *
+ * @return The temperature in 0.01 Celsius.
+ */
+static inline int32_t
+esp_conv_sht21_temp(uint16_t word)
+{
+  return (int32_t) ((17572 * (uint32_t) word) >> 16) - 4685;
+}
+
+/**
+ * Convert SHT21 humidity measurement to percent.
+ *
+ * @param word The measurement with status bits cleared.
+ *
+ * @return The humidity in percent.
+ */
+static inline float
+esp_conv_sht21_rh_f(uint16_t word)
+{
+  return (float) (125.0 / 65536.0) * word - 6;
+}
+
+/**
+ * Convert SHT21 temperature measurement to Celsius.
+ *
+ * @param word The measurement with status bits cleared.
+ *
+ * @return The temperature in Celsius.
+ */
+static inline float
+esp_conv_sht21_temp_f(uint16_t word)
+{
+  return (float) ((float) (175.72 / 65536.0) * word - 46.85);
+}
+
+#endif //ESP_CONV_H
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <esp_crc.h>
+
+#if ESP_CRC_MODE == ESP_CRC_MODE_TABLE
+
+// Tables are packed into 32 bit words because flash
+// on ESP8266 can be read only with aligned 32 bit access.
+static const uint32_t ow_table[64] ICACHE_RODATA_ATTR = {
+  0xE2BC5E00, 0x83DD3F61, 0x207E9CC2, 0x411FFDA3,
+  0x7F21C39D, 0x1E40A2FC, 0xBDE3015F, 0xDC82603E,
+  0xC19F7D23, 0xA0FE1C42, 0x035DBFE1, 0x623CDE80,
+  0x5C02E0BE, 0x3D6381DF, 0x9EC0227C, 0xFFA1431D,
+  0xA4FA1846, 0xC59B7927, 0x6638DA84, 0x0759BBE5,
+  0x396785DB, 0x5806E4BA, 0xFBA54719, 0x9AC42678,
+  0x87D93B65, 0xE6B85A04, 0x451BF9A7, 0x247A98C6,
+  0x1A44A6F8, 0x7B25C799, 0xD886643A, 0xB9E7055B,
+  0x6E30D28C, 0x0F51B3ED, 0xACF2104E, 0xCD93712F,
+  0xF3AD4F11, 0x92CC2E70, 0x316F8DD3, 0x500EECB2,
+  0x4D13F1AF, 0x2C7290CE, 0x8FD1336D, 0xEEB0520C,
+  0xD08E6C32, 0xB1EF0D53, 0x124CAEF0, 0x732DCF91,
+  0x287694CA, 0x4917F5AB, 0xEAB45608, 0x8BD53769,
+  0xB5EB0957, 0xD48A6836, 0x7729CB95, 0x1648AAF4,
+  0x0B55B7E9, 0x6A34D688, 0xC997752B, 0xA8F6144A,
+  0x96C82A74, 0xF7A94B15, 0x540AE8B6, 0x356B89D7,
+};
+
+static const uint32_t sht_table[64] ICACHE_RODATA_ATTR = {
+  0x53623100, 0x97A6F5C4, 0xEADB88B9, 0x2E1F4C7D,
+  0x10217243, 0xD4E5B687, 0xA998CBFA, 0x6D5C0F3E,
+  0xD5E4B786, 0x11207342, 0x6C5D0E3F, 0xA899CAFB,
+  0x96A7F4C5, 0x52633001, 0x2F1E4D7C, 0xEBDA89B8,
+  0x6E5F0C3D, 0xAA9BC8F9, 0xD7E6B584, 0x13227140,
+  0x2D1C4F7E, 0xE9D88BBA, 0x94A5F6C7, 0x50613203,
+  0xE8D98ABB, 0x2C1D4E7F, 0x51603302, 0x95A4F7C6,
+  0xAB9AC9F8, 0x6F5E0D3C, 0x12237041, 0xD6E7B485,
+  0x29184B7A, 0xEDDC8FBE, 0x90A1F2C3, 0x54653607,
+  0x6A5B0839, 0xAE9FCCFD, 0xD3E2B180, 0x17267544,
+  0xAF9ECDFC, 0x6B5A0938, 0x16277445, 0xD2E3B081,
+  0xECDD8EBF, 0x28194A7B, 0x55643706, 0x91A0F3C2,
+  0x14257647, 0xD0E1B283, 0xAD9CCFFE, 0x69580B3A,
+  0x57663504, 0x93A2F1C0, 0xEEDF8CBD, 0x2A1B4879,
+  0x92A3F0C1, 0x56673405, 0x2B1A4978, 0xEFDE8DBC,
+  0xD1E0B382, 0x15247746, 0x68590A3B, 0xAC9DCEFF,
+};
+
+// Get byte from packed flash table.
+#define TABLE_GET(table, idx) \
+  ((uint8_t) ((table)[(idx) >> 2] >> (((idx) & 0x3) << 3)))
+
+#elif ESP_CRC_MODE == ESP_CRC_MODE_NIBBLE
+
+static const uint8_t ow_nibble[16] = {
+  0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8, 0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+
+static const uint8_t sht_nibble[16] = {
+  0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E
+};
+
+#endif
+
+uint8_t ICACHE_FLASH_ATTR
+esp_crc8_ow(uint8_t crc, const uint8_t *data, uint16_t len)
+{
+#if ESP_CRC_MODE == ESP_CRC_MODE_BITWISE
+  uint8_t bit;
+#endif
+
+  while (len--) {
+    crc ^= *data++;
+
+#if ESP_CRC_MODE == ESP_CRC_MODE_TABLE
+    crc = TABLE_GET(ow_table, crc);
+#elif ESP_CRC_MODE == ESP_CRC_MODE_NIBBLE
+    crc = (crc >> 4) ^ ow_nibble[crc & 0x0F];
+    crc = (crc >> 4) ^ ow_nibble[crc & 0x0F];
+#else
+    for (bit = 0; bit < 8; bit++) {
+      if (crc & 0x01) crc = (uint8_t) ((crc >> 1) ^ 0x8C);
+      else crc >>= 1;
+    }
+#endif
+  }
+
+  return crc;
+}
+
+uint8_t ICACHE_FLASH_ATTR
+esp_crc8_sht(uint8_t crc, const uint8_t *data, uint16_t len)
+{
+#if ESP_CRC_MODE == ESP_CRC_MODE_BITWISE
+  uint8_t bit;
+#endif
+
+  while (len--) {
+    crc ^= *data++;
+
+#if ESP_CRC_MODE == ESP_CRC_MODE_TABLE
+    crc = TABLE_GET(sht_table, crc);
+#elif ESP_CRC_MODE == ESP_CRC_MODE_NIBBLE
+    crc = (uint8_t) (crc << 4) ^ sht_nibble[crc >> 4];
+    crc = (uint8_t) (crc << 4) ^ sht_nibble[crc >> 4];
+#else
+    for (bit = 0; bit < 8; bit++) {
+      if (crc & 0x80) crc = (uint8_t) ((crc << 1) ^ 0x131);
+      else crc <<= 1;
+    }
+#endif
+  }
+
+  return crc;
+}
+
+// Frames kernels are for bulk decoding on the gateway. Their column
+// buffers need about 0.5KB of stack so they are not built for ESP8266.
+#ifndef __XTENSA__
+
+// Number of frames processed side by side by the frames kernels.
+#define LANES 32
+// Number of frame bytes gathered at once by the frames kernels.
+#define COLS 16
+
+// Frames kernel helpers are inlined so frame size can be a constant.
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// Host builds on x86-64 Linux get AVX2 version of the frames kernels
+// selected at run time.
+#if defined(__x86_64__) && defined(__linux__)
+  #define FRAMES_ATTR __attribute__((target_clones("avx2", "default")))
+#else
+  #define FRAMES_ATTR
+#endif
+
+/**
+ * Gather frame bytes so every column holds one byte position of all lanes.
+ *
+ * @param frames The first frame.
+ * @param size   The frame size.
+ * @param pos    The first byte position to gather.
+ * @param cols   The number of byte positions to gather.
+ * @param lanes  The number of frames.
+ * @param col    The columns.
+ */
+ALWAYS_INLINE void
+gather(const uint8_t *frames, uint8_t size, uint8_t pos, uint8_t cols, uint32_t lanes, uint8_t col[COLS][LANES])
+{
+  uint32_t idx;
+  uint8_t byte;
+
+  for (idx = 0; idx < lanes; idx++, frames += size) {
+    for (byte = 0; byte < cols; byte++) col[byte][idx] = frames[pos + byte];
+  }
+}
+
+/**
+ * Calculate CRC8 of many frames.
+ *
+ * @param frames The cnt * size bytes of frames.
+ * @param size   The frame size.
+ * @param cnt    The number of frames.
+ * @param crc    The array for cnt CRCs.
+ * @param ow     Set to true for OneWire CRC, false for SHT21 CRC.
+ */
+ALWAYS_INLINE void
+frames_crc(const uint8_t *frames, uint8_t size, uint32_t cnt, uint8_t *crc, bool ow)
+{
+  uint8_t col[COLS][LANES] = {{0}};
+  uint8_t acc[LANES];
+  uint32_t base, idx, lanes;
+  uint8_t pos, cols, byte, bit, val;
+
+  for (base = 0; base < cnt; base += lanes) {
+    lanes = cnt - base < LANES ? cnt - base : LANES;
+
+    // All lanes are computed so loops have constant trip count. Lanes past
+    // the last frame hold stale bytes and are not copied out.
+    for (idx = 0; idx < LANES; idx++) acc[idx] = 0;
+
+    for (pos = 0; pos < size; pos += cols) {
+      cols = (uint8_t) (size - pos < COLS ? size - pos : COLS);
+      gather(&frames[(size_t) base * size], size, pos, cols, lanes, col);
+
+      // Branch free bit loop vectorizes across lanes.
+      for (byte = 0; byte < cols; byte++) {
+        for (idx = 0; idx < LANES; idx++) {
+          val = acc[idx] ^ col[byte][idx];
+          for (bit = 0; bit < 8; bit++) {
+            if (ow) val = (uint8_t) ((val >> 1) ^ (0x8C & -(val & 0x01)));
+            else val = (uint8_t) ((val << 1) ^ (0x31 & -(val >> 7)));
+          }
+          acc[idx] = val;
+        }
+      }
+    }
+
+    for (idx = 0; idx < lanes; idx++) crc[base + idx] = acc[idx];
+  }
+}
+
+FRAMES_ATTR void
+esp_crc8_ow_frames(const uint8_t *frames, uint8_t size, uint32_t cnt, uint8_t *crc)
+{
+  // Constant size of DS18B20 scratchpad unrolls the gather.
+  if (size == 9) frames_crc(frames, 9, cnt, crc, true);
+  else frames_crc(frames, size, cnt, crc, true);
+}
+
+FRAMES_ATTR void
+esp_crc8_sht_frames(const uint8_t *frames, uint8_t size, uint32_t cnt, uint8_t *crc)
+{
+  // Constant size of SHT21 measurement unrolls the gather.
+  if (size == 3) frames_crc(frames, 3, cnt, crc, false);
+  else frames_crc(frames, size, cnt, crc, false);
+}
+
+#endif
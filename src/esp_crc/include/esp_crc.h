@@ -0,0 +1,110 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef ESP_CRC_H
+#define ESP_CRC_H
+
+#ifdef __XTENSA__
+  #include <c_types.h>
+#else
+  // Host (gateway) build without ESP8266 SDK.
+  #include <stdint.h>
+  #include <stdbool.h>
+  #include <stddef.h>
+  #ifndef ICACHE_FLASH_ATTR
+    #define ICACHE_FLASH_ATTR
+  #endif
+  #ifndef ICACHE_RODATA_ATTR
+    #define ICACHE_RODATA_ATTR
+  #endif
+#endif
+
+// CRC implementations.
+// Bit by bit loop. Smallest code, slowest.
+#define ESP_CRC_MODE_BITWISE 0
+// 16 entry nibble table. Two lookups per byte.
+#define ESP_CRC_MODE_NIBBLE 1
+// 256 entry table kept in flash. One lookup per byte.
+#define ESP_CRC_MODE_TABLE 2
+
+// The CRC implementation selected at compile time.
+#ifndef ESP_CRC_MODE
+  #define ESP_CRC_MODE ESP_CRC_MODE_NIBBLE
+#endif
+
+
+/**
+ * Calculate Dallas / Maxim OneWire CRC8.
+ *
+ * Polynomial x^8 + x^5 + x^4 + 1 (0x31, LSB first).
+ *
+ * @param crc  The initial CRC value.
+ * @param data The data to calculate CRC for.
+ * @param len  The data length.
+ *
+ * @return The CRC.
+ */
+uint8_t ICACHE_FLASH_ATTR
+esp_crc8_ow(uint8_t crc, const uint8_t *data, uint16_t len);
+
+/**
+ * Calculate Sensirion SHT21 CRC8.
+ *
+ * Polynomial x^8 + x^5 + x^4 + 1 (0x131, MSB first).
+ *
+ * @param crc  The initial CRC value.
+ * @param data The data to calculate CRC for.
+ * @param len  The data length.
+ *
+ * @return The CRC.
+ */
+uint8_t ICACHE_FLASH_ATTR
+esp_crc8_sht(uint8_t crc, const uint8_t *data, uint16_t len);
+
+#ifndef __XTENSA__
+
+/**
+ * Calculate OneWire CRC8 of many frames.
+ *
+ * Frames are processed side by side with branch free bit loop which
+ * compilers can vectorize across frames (bulk decoding on the host).
+ * Not available in ESP8266 builds.
+ * Frames ending with their CRC (DS18B20 scratchpad) give zero when valid.
+ *
+ * @param frames The cnt * size bytes of frames.
+ * @param size   The frame size.
+ * @param cnt    The number of frames.
+ * @param crc    The array for cnt CRCs.
+ */
+void
+esp_crc8_ow_frames(const uint8_t *frames, uint8_t size, uint32_t cnt, uint8_t *crc);
+
+/**
+ * Calculate Sensirion SHT21 CRC8 of many frames.
+ *
+ * See esp_crc8_ow_frames.
+ *
+ * @param frames The cnt * size bytes of frames.
+ * @param size   The frame size.
+ * @param cnt    The number of frames.
+ * @param crc    The array for cnt CRCs.
+ */
+void
+esp_crc8_sht_frames(const uint8_t *frames, uint8_t size, uint32_t cnt, uint8_t *crc);
+
+#endif
+
+#endif //ESP_CRC_H
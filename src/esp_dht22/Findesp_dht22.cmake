@@ -30,6 +30,10 @@ find_path(esp_dht22_INCLUDE_DIR esp_dht22.h)
 find_library(esp_dht22_LIBRARY NAMES esp_dht22)
 
 find_package(esp_gpio REQUIRED)
+find_package(esp_eb REQUIRED)
+find_package(esp_ring REQUIRED)
+find_package(esp_stats REQUIRED)
+find_package(esp_conv REQUIRED)
 
 include(FindPackageHandleStandardArgs)
 FIND_PACKAGE_HANDLE_STANDARD_ARGS(esp_dht22
@@ -39,8 +43,16 @@ FIND_PACKAGE_HANDLE_STANDARD_ARGS(esp_dht22
 
 set(esp_dht22_INCLUDE_DIRS
     ${esp_dht22_INCLUDE_DIR}
-    ${esp_gpio_INCLUDE_DIRS})
+    ${esp_gpio_INCLUDE_DIRS}
+    ${esp_eb_INCLUDE_DIRS}
+    ${esp_ring_INCLUDE_DIRS}
+    ${esp_stats_INCLUDE_DIRS}
+    ${esp_conv_INCLUDE_DIRS})
 
 set(esp_dht22_LIBRARIES
     ${esp_dht22_LIBRARY}
-    ${esp_gpio_LIBRARIES})
+    ${esp_gpio_LIBRARIES}
+    ${esp_eb_LIBRARIES}
+    ${esp_ring_LIBRARIES}
+    ${esp_stats_LIBRARIES}
+    ${esp_conv_LIBRARIES})
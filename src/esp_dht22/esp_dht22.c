@@ -16,55 +16,228 @@
 
 
 #include <esp_dht22.h>
+#include <esp_conv.h>
 #include <esp_gpio.h>
+#include <esp_eb.h>
+#include <gpio.h>
 #include <mem.h>
 #include <user_interface.h>
 
 #define BUS_LOW(gpio_num) (GPIO_OUT_EN_S = (0x1 << (gpio_num)))
 #define BUS_RELEASE(gpio_num) (GPIO_OUT_EN_C = (0x1 << (gpio_num)))
-#define BUS_READ(gpio_num) ((GPIO_IN & (0x1 << (gpio_num))) != 0)
+#ifndef BUS_READ
+  #define BUS_READ(gpio_num) ((GPIO_IN & (0x1 << (gpio_num))) != 0)
+#endif
+
+// Number of high state samples for bit 1.
+#define BIT1_HIGH_CNT (ESP_DHT22_BIT1_HIGH_US / ESP_DHT22_POLL_US)
+// Maximum number of samples for 40 bits.
+#define FRAME_CNT (ESP_DHT22_FRAME_US / ESP_DHT22_POLL_US)
+// Maximum time to wait for the bus to change state in microseconds.
+#define STATE_MAX_US 500
+
+// The device with asynchronous read in progress.
+static esp_dht22_dev *active;
+
+// Sample ring.
+static esp_ring *ring;
+
+// Application GPIO interrupt handler restored after asynchronous read.
+static void (*app_isr)(void *arg);
+static void *app_arg;
 
 
 /**
- * Measure number of 10us slots the state was kept.
+ * Measure how long the bus keeps the state.
  *
- * The maximum wait time for GPIO to change state is 500us.
+ * The bus is sampled every ESP_DHT22_POLL_US and the length is taken
+ * from the system clock so it does not depend on the sampling loop
+ * overhead. The maximum wait time for GPIO to change state is
+ * STATE_MAX_US.
  *
  * @param gpio_num  The GPIO number.
  * @param exp_state The state.
  *
- * @return The number time slots.
+ * @return The state length in microseconds.
  */
-static uint8_t ICACHE_FLASH_ATTR
-state_lenght(uint8_t gpio_num, bool exp_state)
+static uint16_t ICACHE_FLASH_ATTR
+state_length(uint8_t gpio_num, bool exp_state)
 {
-  uint8_t slot = 0;
+  uint32_t start = system_get_time();
+  uint32_t elapsed = 0;
 
   while (BUS_READ(gpio_num) == exp_state) {
-    if (slot++ > 50) break;
-    os_delay_us(8);
+    elapsed = system_get_time() - start;
+    if (elapsed > STATE_MAX_US) break;
+    os_delay_us(ESP_DHT22_POLL_US);
+  }
+
+  return (uint16_t) elapsed;
+}
+
+/**
+ * Check length of response signal state.
+ *
+ * @param us The state length in microseconds.
+ *
+ * @return Returns true when valid, false otherwise.
+ */
+static bool ICACHE_FLASH_ATTR
+resp_ok(uint16_t us)
+{
+  return us >= ESP_DHT22_RESP_MIN_US && us <= ESP_DHT22_RESP_MAX_US;
+}
+
+/**
+ * Validate device frame and set temperature and humidity.
+ *
+ * @param device The device.
+ *
+ * @return Error code.
+ */
+static esp_dht22_err ICACHE_FLASH_ATTR
+decode_frame(esp_dht22_dev *device)
+{
+  const uint8_t *data = device->frame;
+
+  if (!esp_conv_dht22_parity(data)) return ESP_DHT22_ERR_PARITY;
+
+  device->temp = esp_conv_dht22_temp(data) / 10.0f;
+  device->hum = esp_conv_dht22_hum(data) / 10.0f;
+  device->last_good = system_get_time();
+
+  return ESP_DHT22_OK;
+}
+
+/**
+ * Finish read. Update statistics and add result to the sample ring.
+ *
+ * @param device The device.
+ * @param err    The read error code.
+ *
+ * @return The read error code.
+ */
+static esp_dht22_err ICACHE_FLASH_ATTR
+read_done(esp_dht22_dev *device, esp_dht22_err err)
+{
+  const uint8_t *data = device->frame;
+
+  ESP_STATS_INC(device->stats.reads);
+  if (err == ESP_DHT22_ERR_PARITY) ESP_STATS_INC(device->stats.parity_errs);
+  if (err == ESP_DHT22_ERR_BAD_RESP_SIGNAL) ESP_STATS_INC(device->stats.bad_resp);
+
+  if (ring != NULL) {
+    esp_ring_push(ring, device->id, ESP_RING_DHT22, (uint8_t) err,
+                  ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16)
+                  | ((uint32_t) data[2] << 8) | data[3]);
   }
 
-  return slot;
+  return err;
 }
 
 /**
- * Calculate temperature.
+ * Decode 5 byte frame from falling edges timestamps.
  *
- * @param data The pointer to 5 bytes read from the bus.
+ * @param edges The ESP_DHT22_EDGES CCOUNT timestamps.
+ * @param data  The 5 byte frame to set bits on.
+ */
+static void ICACHE_FLASH_ATTR
+decode_edges(const uint32_t *edges, uint8_t *data)
+{
+  uint8_t idx;
+  uint32_t threshold = ESP_DHT22_BIT1_US * system_get_cpu_freq();
+
+  for (idx = 0; idx < ESP_DHT22_EDGES - 1; idx++) {
+    // Unsigned subtraction handles CCOUNT overflow.
+    if (edges[idx + 1] - edges[idx] > threshold) {
+      data[idx >> 3] |= 0x80 >> (idx & 0x7);
+    }
+  }
+}
+
+/**
+ * GPIO interrupt handler capturing falling edges.
  *
- * @return Temperature in Celsius.
+ * Clears only the device pin status bit. Interrupts from other pins are
+ * passed to the application handler which clears them.
+ *
+ * Must be kept in IRAM.
  */
-static float calc_temp(const uint8_t *data)
+static void
+edge_isr(void *arg)
+{
+  uint32_t ccount = esp_stats_ccount();
+  uint32_t status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);
+  esp_dht22_dev *dev = active;
+  uint32_t mask = dev == NULL ? 0 : BIT(dev->gpio_num);
+
+  if ((status & ~mask) != 0 && app_isr != NULL) app_isr(app_arg);
+  if ((status & mask) == 0) return;
+
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, mask);
+
+  // The first falling edge starts the response signal.
+  if (dev->edge_cnt >= 0) dev->edges[dev->edge_cnt] = ccount;
+  dev->edge_cnt++;
+
+  if (dev->edge_cnt == ESP_DHT22_EDGES) {
+    gpio_pin_intr_state_set(GPIO_ID_PIN(dev->gpio_num), GPIO_PIN_INTR_DISABLE);
+  }
+}
+
+static void ICACHE_FLASH_ATTR
+frame_done(void *arg)
+{
+  esp_dht22_dev *dev = arg;
+
+  // Give GPIO interrupt back to the application.
+  ETS_GPIO_INTR_DISABLE();
+  gpio_pin_intr_state_set(GPIO_ID_PIN(dev->gpio_num), GPIO_PIN_INTR_DISABLE);
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, BIT(dev->gpio_num));
+  active = NULL;
+  if (app_isr != NULL) {
+    ETS_GPIO_INTR_ATTACH(app_isr, app_arg);
+    ETS_GPIO_INTR_ENABLE();
+  }
+
+  memset(dev->frame, 0, 5);
+
+  if (dev->edge_cnt != ESP_DHT22_EDGES) {
+    read_done(dev, ESP_DHT22_ERR_BAD_RESP_SIGNAL);
+    esp_eb_trigger(ESP_DHT22_EV_ERROR, dev);
+    return;
+  }
+
+  ESP_STATS_CYCLES(dev->stats.frame, dev->edges[ESP_DHT22_EDGES - 1] - dev->edges[0]);
+  decode_edges(dev->edges, dev->frame);
+
+  if (read_done(dev, decode_frame(dev)) == ESP_DHT22_OK) {
+    esp_eb_trigger(ESP_DHT22_EV_READY, dev);
+  } else {
+    esp_eb_trigger(ESP_DHT22_EV_ERROR, dev);
+  }
+}
+
+static void ICACHE_FLASH_ATTR
+start_done(void *arg)
 {
-  // Remove negative temp indicator bit.
-  float temp = data[2] & 0x7F;
-  temp *= 0x100;
-  temp += data[3];
-  temp /= 10;
-  if ((data[2] & 0x80) > 0) temp *= -1;
+  esp_dht22_dev *dev = arg;
 
-  return temp;
+  dev->edge_cnt = -1;
+  active = dev;
+
+  ETS_GPIO_INTR_DISABLE();
+  ETS_GPIO_INTR_ATTACH(edge_isr, NULL);
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, BIT(dev->gpio_num));
+  gpio_pin_intr_state_set(GPIO_ID_PIN(dev->gpio_num), GPIO_PIN_INTR_NEGEDGE);
+  ETS_GPIO_INTR_ENABLE();
+
+  // End start signal.
+  BUS_RELEASE(dev->gpio_num);
+
+  // The whole frame takes no more then 5ms.
+  os_timer_setfn(&dev->timer, frame_done, dev);
+  os_timer_arm(&dev->timer, 10, false);
 }
 
 void ICACHE_FLASH_ATTR
@@ -103,8 +276,10 @@ esp_dht22_get(esp_dht22_dev *device)
 
   if (device == NULL) return ESP_DHT22_ERR_DEV_NULL;
 
-  data = os_zalloc(5);
-  if (data == NULL) return ESP_DHT22_ERR_MEM;
+  data = device->frame;
+  memset(data, 0, 5);
+
+  device->last_measure = system_get_time();
 
   // Emmit start signal.
   BUS_LOW(device->gpio_num);
@@ -112,22 +287,19 @@ esp_dht22_get(esp_dht22_dev *device)
 
   // End start signal.
   BUS_RELEASE(device->gpio_num);
-  os_delay_us(25);
 
   // Entering time critical code.
+  ESP_STATS_START(irq_start);
   ETS_GPIO_INTR_DISABLE();
 
-  // Device responds with 80us low followed by 80us high.
-  cnt = state_lenght(device->gpio_num, 0);
-  if (cnt < 8 || cnt > 10) {
+  // Device starts response 20us to 200us after the start signal
+  // and responds with 80us low followed by 80us high.
+  if (state_length(device->gpio_num, 1) > STATE_MAX_US
+      || !resp_ok(state_length(device->gpio_num, 0))
+      || !resp_ok(state_length(device->gpio_num, 1))) {
+    ESP_STATS_HIST(device->stats.irq_off, irq_start);
     ETS_GPIO_INTR_ENABLE();
-    return ESP_DHT22_ERR_BAD_RESP_SIGNAL;
-  }
-
-  cnt = state_lenght(device->gpio_num, 1);
-  if (cnt < 8 || cnt > 10) {
-    ETS_GPIO_INTR_ENABLE();
-    return ESP_DHT22_ERR_BAD_RESP_SIGNAL;
+    return read_done(device, ESP_DHT22_ERR_BAD_RESP_SIGNAL);
   }
 
   // Sample data bus for 40 bits.
@@ -139,15 +311,15 @@ esp_dht22_get(esp_dht22_dev *device)
   // Data is transmitted MSB first.
   //
   // This means 40 bits transfer takes between 3000us and 4800us.
-  // The code below samples the bus no more then 4800us (10us * 480).
-  // During that time we count falling edges and count number of
-  // high states seen since last falling edge. The number of seen
-  // high states tells us if this was o or 1.
+  // The code below samples the bus every ESP_DHT22_POLL_US for no more
+  // then ESP_DHT22_FRAME_US. During that time we count falling edges
+  // and count number of high states seen since last falling edge.
+  // The number of seen high states tells us if this was 0 or 1.
   do {
     bit = BUS_READ(device->gpio_num);
     if (bit) high_cnt++;
     if (bit == false && prev_bit == true) {
-      if (high_cnt >= 6) data[data_byte_idx] |= data_byte_mask;
+      if (high_cnt >= BIT1_HIGH_CNT) data[data_byte_idx] |= data_byte_mask;
       high_cnt = 0;
       data_byte_mask >>= 1;
       if (data_byte_mask == 0) {
@@ -157,23 +329,84 @@ esp_dht22_get(esp_dht22_dev *device)
     }
     prev_bit = bit;
     cnt++;
-    os_delay_us(10);
-  } while (data_byte_idx < 5 && cnt <= 480);
+    os_delay_us(ESP_DHT22_POLL_US);
+  } while (data_byte_idx < 5 && cnt <= FRAME_CNT);
 
+  ESP_STATS_HIST(device->stats.irq_off, irq_start);
   ETS_GPIO_INTR_ENABLE();
 
-  device->last_measure = system_get_time();
+  return read_done(device, decode_frame(device));
+}
+
+esp_dht22_err ICACHE_FLASH_ATTR
+esp_dht22_get_cached(esp_dht22_dev *device, uint32_t *age_us)
+{
+  esp_dht22_err err;
+  uint32_t now = system_get_time();
+
+  if (device == NULL) return ESP_DHT22_ERR_DEV_NULL;
 
-  if (((uint8_t) (data[0] + data[1] + data[2] + data[3])) != data[4]) {
-    return ESP_DHT22_ERR_PARITY;
+  // Serve from cache when the device is not ready for another read.
+  if (device->last_measure != 0
+      && now - device->last_measure < ESP_DHT22_MIN_INTERVAL_US) {
+
+    if (device->last_good == 0) {
+      device->cache_empty++;
+      return ESP_DHT22_ERR_TOO_SOON;
+    }
+
+    device->cache_hits++;
+    if (age_us != NULL) *age_us = now - device->last_good;
+
+    return ESP_DHT22_OK;
   }
 
-  device->temp = calc_temp(data);
-  device->hum = data[0] * 0x100;
-  device->hum += data[1];
-  device->hum /= 10;
+  device->cache_misses++;
+  err = esp_dht22_get(device);
+  if (err == ESP_DHT22_OK && age_us != NULL) *age_us = 0;
+
+  return err;
+}
+
+esp_dht22_err ICACHE_FLASH_ATTR
+esp_dht22_get_async(esp_dht22_dev *device)
+{
+  if (device == NULL) return ESP_DHT22_ERR_DEV_NULL;
+  if (active != NULL) return ESP_DHT22_ERR_BUSY;
+
+  active = device;
+  device->edge_cnt = -1;
+  device->last_measure = system_get_time();
+
+  // Emmit start signal. The timer ends it.
+  BUS_LOW(device->gpio_num);
+  os_timer_disarm(&device->timer);
+  os_timer_setfn(&device->timer, start_done, device);
+  os_timer_arm(&device->timer, 1, false);
 
-  //os_free(data);
   return ESP_DHT22_OK;
 }
 
+void ICACHE_FLASH_ATTR
+esp_dht22_set_gpio_isr(void (*isr)(void *arg), void *arg)
+{
+  app_isr = isr;
+  app_arg = arg;
+}
+
+void ICACHE_FLASH_ATTR
+esp_dht22_set_ring(esp_ring *r)
+{
+  ring = r;
+}
+
+#ifdef ESP_DRV_STATS
+
+void ICACHE_FLASH_ATTR
+esp_dht22_stats_get(esp_dht22_dev *device, esp_dht22_stats *stats, bool reset)
+{
+  os_memcpy(stats, &device->stats, sizeof(esp_dht22_stats));
+  if (reset) os_memset(&device->stats, 0, sizeof(esp_dht22_stats));
+}
+
+#endif
@@ -18,7 +18,65 @@
 #ifndef ESP_DHT22_H
 #define ESP_DHT22_H
 
+#include <esp_ring.h>
+#include <esp_stats.h>
 #include <c_types.h>
+#include <osapi.h>
+
+// Temperature and humidity ready (asynchronous mode).
+#define ESP_DHT22_EV_READY "dht22Ready"
+// Temperature and humidity read error (asynchronous mode).
+#define ESP_DHT22_EV_ERROR "dht22Error"
+
+// Minimum interval between bus transactions in microseconds.
+#define ESP_DHT22_MIN_INTERVAL_US 2000000
+
+// Number of falling edges captured in asynchronous mode.
+// One edge ends the response signal and 40 edges end data bits.
+#define ESP_DHT22_EDGES 41
+
+// Data bits with longer period (low + high) are decoded as 1.
+// Device transmits 0 as 75us period and 1 as 120us period.
+#ifndef ESP_DHT22_BIT1_US
+  #define ESP_DHT22_BIT1_US 98
+#endif
+
+// Bus sampling interval in microseconds (blocking mode).
+#ifndef ESP_DHT22_POLL_US
+  #define ESP_DHT22_POLL_US 10
+#endif
+
+// Data bits with longer high state are decoded as 1 (blocking mode).
+// Device transmits 0 as 25us high and 1 as 70us high.
+#ifndef ESP_DHT22_BIT1_HIGH_US
+  #define ESP_DHT22_BIT1_HIGH_US 60
+#endif
+
+// Maximum time to sample 40 data bits in microseconds (blocking mode).
+#ifndef ESP_DHT22_FRAME_US
+  #define ESP_DHT22_FRAME_US 4800
+#endif
+
+// Accepted length of response signal low and high states in
+// microseconds (blocking mode). Device keeps each state for 80us.
+#ifndef ESP_DHT22_RESP_MIN_US
+  #define ESP_DHT22_RESP_MIN_US 60
+#endif
+#ifndef ESP_DHT22_RESP_MAX_US
+  #define ESP_DHT22_RESP_MAX_US 110
+#endif
+
+// DHT22 statistics (compiled in with ESP_DRV_STATS).
+//
+// The stats field changes esp_dht22_dev layout so ESP_DRV_STATS must be
+// defined for the driver and all the code using it (set it globally).
+typedef struct {
+  uint32_t reads;         // Number of reads.
+  uint32_t parity_errs;   // Number of frames with bad parity.
+  uint32_t bad_resp;      // Number of bad response signals or incomplete frames.
+  esp_stats_hist irq_off; // Interrupts disabled window CPU cycles (blocking mode).
+  esp_stats_hist frame;   // First to last falling edge CPU cycles (asynchronous mode).
+} esp_dht22_stats;
 
 // Structure representing DHT22 device.
 typedef struct {
@@ -26,6 +84,23 @@ typedef struct {
   float temp;            // Temperature in Celsius.
   uint8_t gpio_num;      // The GPIO this device is connected to.
   uint32_t last_measure; // Last measure time. Uses system_get_time().
+  uint32_t last_good;    // Last successful measure time. Uses system_get_time().
+  uint8_t frame[5];      // Last raw frame read from the bus.
+  uint8_t id;            // Sensor id for sample ring records.
+
+  // Cached mode.
+  uint32_t cache_hits;   // Number of reads served from cache.
+  uint32_t cache_misses; // Number of reads served from the bus.
+  uint32_t cache_empty;  // Number of ESP_DHT22_ERR_TOO_SOON returns.
+
+  // Asynchronous mode.
+  os_timer_t timer;                // Start signal and frame timer.
+  uint32_t edges[ESP_DHT22_EDGES]; // Falling edges CCOUNT timestamps.
+  int8_t edge_cnt;                 // Number of captured falling edges.
+
+#ifdef ESP_DRV_STATS
+  esp_dht22_stats stats;
+#endif
 } esp_dht22_dev;
 
 // Error codes.
@@ -35,6 +110,8 @@ typedef enum {
   ESP_DHT22_ERR_DEV_NULL,
   ESP_DHT22_ERR_BAD_RESP_SIGNAL,
   ESP_DHT22_ERR_PARITY,
+  ESP_DHT22_ERR_BUSY,
+  ESP_DHT22_ERR_TOO_SOON, // No valid sample within minimum interval.
 } esp_dht22_err;
 
 // Espressif SDK missing includes.
@@ -74,4 +151,81 @@ esp_dht22_new_dev(uint8_t gpio_num);
 esp_dht22_err ICACHE_FLASH_ATTR
 esp_dht22_get(esp_dht22_dev *device);
 
+/**
+ * Get temperature and humidity respecting minimum read interval.
+ *
+ * When called within ESP_DHT22_MIN_INTERVAL_US from the last bus
+ * transaction the last good temperature and humidity are served
+ * without touching the bus. Otherwise it works as esp_dht22_get.
+ *
+ * @param device The device structure to set values on.
+ * @param age_us The age of returned values in microseconds. May be NULL.
+ *
+ * @return Error code.
+ */
+esp_dht22_err ICACHE_FLASH_ATTR
+esp_dht22_get_cached(esp_dht22_dev *device, uint32_t *age_us);
+
+/**
+ * Start asynchronous temperature and humidity read.
+ *
+ * The start signal is driven by a timer and the data bits are decoded
+ * from falling edges timestamps captured in GPIO interrupt so the CPU
+ * is never blocked. When done ESP_DHT22_EV_READY or ESP_DHT22_EV_ERROR
+ * event is triggered with the device as the argument.
+ *
+ * NOTE: While the read is in progress the driver owns GPIO interrupt
+ *       handler. Interrupts from other pins are passed to the handler
+ *       registered with esp_dht22_set_gpio_isr and the handler is attached
+ *       back when the read is done. Without registered handler GPIO
+ *       interrupt stays disabled after the read.
+ *       Only one asynchronous read can be in progress at a time.
+ *       You must keep calls to this function at least 2s apart.
+ *
+ * @param device The device structure to set values on.
+ *
+ * @return Error code.
+ */
+esp_dht22_err ICACHE_FLASH_ATTR
+esp_dht22_get_async(esp_dht22_dev *device);
+
+/**
+ * Set application GPIO interrupt handler.
+ *
+ * The SDK keeps only one GPIO interrupt handler and there is no way to get
+ * it back. Register yours here (instead of ETS_GPIO_INTR_ATTACH) when using
+ * asynchronous reads so the driver can share and restore it. The handler
+ * must clear GPIO status bits of its own pins only.
+ *
+ * @param isr The interrupt handler or NULL.
+ * @param arg The handler argument.
+ */
+void ICACHE_FLASH_ATTR
+esp_dht22_set_gpio_isr(void (*isr)(void *arg), void *arg);
+
+#ifdef ESP_DRV_STATS
+
+/**
+ * Get device statistics.
+ *
+ * @param device The device.
+ * @param stats  The statistics snapshot.
+ * @param reset  Reset statistics after taking the snapshot.
+ */
+void ICACHE_FLASH_ATTR
+esp_dht22_stats_get(esp_dht22_dev *device, esp_dht22_stats *stats, bool reset);
+
+#endif
+
+/**
+ * Set sample ring.
+ *
+ * Every read (successful or not) is added to the ring as ESP_RING_DHT22
+ * record with esp_dht22_dev.id as sensor id.
+ *
+ * @param ring The ring or NULL to disable.
+ */
+void ICACHE_FLASH_ATTR
+esp_dht22_set_ring(esp_ring *ring);
+
 #endif //ESP_DHT22_H
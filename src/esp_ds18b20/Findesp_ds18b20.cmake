@@ -32,6 +32,10 @@ find_library(esp_ds18b20_LIBRARY NAMES esp_ds18b20)
 find_package(esp_ow REQUIRED)
 find_package(esp_eb REQUIRED)
 find_package(esp_tim REQUIRED)
+find_package(esp_crc REQUIRED)
+find_package(esp_ring REQUIRED)
+find_package(esp_stats REQUIRED)
+find_package(esp_conv REQUIRED)
 
 include(FindPackageHandleStandardArgs)
 FIND_PACKAGE_HANDLE_STANDARD_ARGS(esp_ds18b20
@@ -43,10 +47,18 @@ set(esp_ds18b20_INCLUDE_DIRS
     ${esp_ds18b20_INCLUDE_DIR}
     ${esp_ow_INCLUDE_DIRS}
     ${esp_eb_INCLUDE_DIRS}
-    ${esp_tim_INCLUDE_DIRS})
+    ${esp_tim_INCLUDE_DIRS}
+    ${esp_crc_INCLUDE_DIRS}
+    ${esp_ring_INCLUDE_DIRS}
+    ${esp_stats_INCLUDE_DIRS}
+    ${esp_conv_INCLUDE_DIRS})
 
 set(esp_ds18b20_LIBRARIES
     ${esp_ds18b20_LIBRARY}
     ${esp_ow_LIBRARIES}
     ${esp_eb_LIBRARIES}
-    ${esp_tim_LIBRARIES})
+    ${esp_tim_LIBRARIES}
+    ${esp_crc_LIBRARIES}
+    ${esp_ring_LIBRARIES}
+    ${esp_stats_LIBRARIES}
+    ${esp_conv_LIBRARIES})
@@ -16,10 +16,54 @@
 
 
 #include <esp_ds18b20.h>
+#include <esp_crc.h>
+#include <esp_conv.h>
 #include <esp_tim.h>
 #include <esp_eb.h>
 #include <mem.h>
+#include <osapi.h>
+#include <user_interface.h>
 
+// ROM inventory magic number.
+#define INV_MAGIC 0xD518B20
+
+// ROM inventory header as stored in RTC memory.
+typedef struct {
+  uint32_t magic;   // The INV_MAGIC.
+  uint8_t gpio_num; // The GPIO where OneWire bus is connected.
+  uint8_t cnt;      // The number of devices.
+  uint8_t crc;      // The CRC8 of gpio_num, cnt and all devices.
+  uint8_t pad;
+} inv_hdr;
+
+// ROM inventory device as stored in RTC memory.
+typedef struct {
+  uint8_t rom[8];
+  uint8_t sp[3]; // Th, Tl and configuration register.
+  uint8_t pad;
+} inv_dev;
+
+// Number of RTC memory blocks (4 bytes) taken by the structures.
+#define INV_HDR_BLOCKS (sizeof(inv_hdr) / 4)
+#define INV_DEV_BLOCKS (sizeof(inv_dev) / 4)
+
+// Sample ring.
+static esp_ring *ring;
+
+// Is true when ROM inventory in RTC memory is valid.
+static bool inv_valid;
+
+#ifdef ESP_DRV_STATS
+  // ROM search pass histogram.
+  static esp_stats_hist search_hist;
+
+  #define STATS_CONV(list, polls) stats_conv((list), (polls))
+#else
+  #define STATS_CONV(list, polls) ((void) 0)
+#endif
+
+
+#ifndef ESP_DS18B20_NO_FLOAT
 
 /**
  * Decode temperature.
@@ -77,15 +121,68 @@ decode_temp(const uint8_t *sp)
   return decimal;
 }
 
+#endif
+
+/**
+ * Initialize device status.
+ *
+ * @param st The device status.
+ */
+static void ICACHE_FLASH_ATTR
+st_init(esp_ds18b20_st *st)
+{
+  st->raw = ESP_DS18B20_RAW_ERR;
+  st->last_temp = ESP_DS18B20_TEMP_ERR;
+  st->retries = -1;
+  st->res = ESP_DS18B20_RES_12;
+  st->parasite = -1;
+}
+
+/**
+ * Mark last temperature as invalid.
+ *
+ * @param st The device status.
+ */
+static void ICACHE_FLASH_ATTR
+st_temp_err(esp_ds18b20_st *st)
+{
+  st->raw = ESP_DS18B20_RAW_ERR;
+  st->last_temp = ESP_DS18B20_TEMP_ERR;
+}
+
+#ifdef ESP_DRV_STATS
+
+/**
+ * Record status polls used by finished conversion.
+ *
+ * @param list  The list of devices which took part in the conversion.
+ * @param polls The number of status polls.
+ */
+static void ICACHE_FLASH_ATTR
+stats_conv(esp_ow_device *list, uint8_t polls)
+{
+  esp_ds18b20_stats *stats;
+
+  for (; list; list = list->next) {
+    stats = &((esp_ds18b20_st *) list->custom)->stats;
+    stats->convs++;
+    stats->polls += polls;
+    stats->polls_last = polls;
+    if (polls > stats->polls_max) stats->polls_max = polls;
+  }
+}
+
+#endif
+
 esp_ow_err ICACHE_FLASH_ATTR
 esp_d18b20_read_sp(esp_ow_device *device)
 {
-  uint8_t idx;
-  uint8_t crc = 0;
-
   esp_ds18b20_st *st = device->custom;
+  ESP_STATS_START(start);
 
+  ESP_STATS_INC(st->stats.reads);
   if (esp_ow_reset(device->gpio_num) == false) {
+    ESP_STATS_INC(st->stats.presence_errs);
     st->retries = -1;
     return ESP_OW_ERR_NO_DEV;
   }
@@ -93,16 +190,16 @@ esp_d18b20_read_sp(esp_ow_device *device)
   esp_ow_match_dev(device);
   esp_ow_write(device->gpio_num, ESP_DS18B20_CMD_READ_SP);
   esp_ow_read_bytes(device->gpio_num, st->sp, 9);
+  ESP_STATS_HIST(st->stats.read, start);
 
-  for (idx = 0; idx < 9; idx++) {
-    crc = esp_ow_crc8(crc, st->sp[idx]);
-  }
-
-  if (crc != 0) {
+  if (esp_crc8_ow(0, st->sp, 9) != 0) {
+    ESP_STATS_INC(st->stats.crc_errs);
     memset(st->sp, 0, 9);
     return ESP_OW_ERR_BAD_CRC;
   }
 
+  st->res = (uint8_t) ((st->sp[4] & 0x60) >> 5);
+
   return ESP_OW_OK;
 }
 
@@ -111,6 +208,7 @@ esp_ds18b20_write_sp(esp_ow_device *device)
 {
   uint8_t *start;
   esp_ds18b20_st *st = device->custom;
+  ESP_STATS_START(cycles);
 
   if (esp_ow_reset(device->gpio_num) == false) {
     return ESP_OW_ERR_NO_DEV;
@@ -123,6 +221,7 @@ esp_ds18b20_write_sp(esp_ow_device *device)
   start = &st->sp[2];
 
   esp_ow_write_bytes(device->gpio_num, start, 3);
+  ESP_STATS_HIST(st->stats.write, cycles);
 
   return ESP_OW_OK;
 }
@@ -134,11 +233,84 @@ read_temp(esp_ow_device *device)
   esp_ow_err err = esp_d18b20_read_sp(device);
 
   st->retries = -1;
-  if (err != ESP_OW_OK) return err;
+  if (err == ESP_OW_OK) {
+    st->raw = esp_conv_ds18b20_raw(st->sp);
+#ifndef ESP_DS18B20_NO_FLOAT
+    st->last_temp = decode_temp(st->sp);
+#endif
+  }
 
-  st->last_temp = decode_temp(st->sp);
+  // Device stopped answering, next restore must search the bus.
+  if (err != ESP_OW_OK && inv_valid) esp_ds18b20_inv_clear();
 
-  return ESP_OW_OK;
+  if (ring != NULL) {
+    esp_ring_push(ring, st->id, ESP_RING_DS18B20, (uint8_t) err,
+                  (uint16_t) (err == ESP_OW_OK ? st->raw : ESP_DS18B20_RAW_ERR));
+  }
+
+  return err;
+}
+
+/**
+ * Get maximum conversion time for given resolution.
+ *
+ * @param res The resolution. One of ESP_DS18B20_RES_* defines.
+ *
+ * @return The conversion time in milliseconds.
+ */
+static uint16_t ICACHE_FLASH_ATTR
+conv_time(uint8_t res)
+{
+  switch (res) {
+    case ESP_DS18B20_RES_9:
+      return ESP_DS18B20_CONV_MS_9;
+
+    case ESP_DS18B20_RES_10:
+      return ESP_DS18B20_CONV_MS_10;
+
+    case ESP_DS18B20_RES_11:
+      return ESP_DS18B20_CONV_MS_11;
+
+    default:
+      return ESP_DS18B20_CONV_MS_12;
+  }
+}
+
+/**
+ * Get the number of status polls before conversion is considered failed.
+ *
+ * The first poll is done after half of the maximum conversion time then
+ * we poll every ESP_DS18B20_POLL_MS until maximum conversion time
+ * plus 10% margin elapses.
+ *
+ * @param res The resolution. One of ESP_DS18B20_RES_* defines.
+ *
+ * @return The number of polls.
+ */
+static int8_t ICACHE_FLASH_ATTR
+conv_polls(uint8_t res)
+{
+  uint16_t ms = conv_time(res);
+
+  return (int8_t) ((ms / 2 + ms / 10) / ESP_DS18B20_POLL_MS + 1);
+}
+
+/**
+ * Check if device is parasite powered.
+ *
+ * @param device The device.
+ *
+ * @return Returns 1 if parasite powered, 0 if not and -1 on error.
+ */
+static int8_t ICACHE_FLASH_ATTR
+read_pwr(esp_ow_device *device)
+{
+  if (esp_ow_reset(device->gpio_num) == false) return -1;
+
+  esp_ow_match_dev(device);
+  esp_ow_write(device->gpio_num, ESP_DS18B20_CMD_READ_PWR);
+
+  return (int8_t) (esp_ow_read_bit(device->gpio_num) ? 0 : 1);
 }
 
 static void ICACHE_FLASH_ATTR
@@ -146,44 +318,318 @@ start_conversion(void *arg)
 {
   esp_tim_timer *timer = arg;
 
-  bool done = false;
+  esp_ow_err err;
   esp_ow_device *dev = timer->payload;
   esp_ds18b20_st *st = dev->custom;
-  uint32_t sample_count = 200;
+  uint32_t start = system_get_time();
 
   st->retries++;
 
-  do {
-    if (esp_ow_read_bit(dev->gpio_num)) {
-      done = true;
-      break;
-    }
-    os_delay_us(5);
-    sample_count--;
-  } while (sample_count > 0);
+  // Device keeps the bus low until conversion is done. We sample
+  // the bus only once per timer tick so the CPU is free between ticks.
+  // Parasite powered device can't do it but then the first tick is
+  // after the maximum conversion time.
+  if (st->parasite == 1 || esp_ow_read_bit(dev->gpio_num)) {
+    STATS_CONV(dev, (uint8_t) st->retries);
+    err = read_temp(dev);
+    st->cpu_us += system_get_time() - start;
 
-  if (done == true) {
-    if (read_temp(dev) != ESP_OW_OK) {
+    if (err != ESP_OW_OK) {
       esp_eb_trigger(ESP_DS18B20_EV_TEMP_ERROR, dev);
     } else {
       esp_eb_trigger(ESP_DS18B20_EV_TEMP_READY, dev);
     }
+    return;
+  }
+
+  st->cpu_us += system_get_time() - start;
+
+  // Make sure we are not calling ourselves forever.
+  if (st->retries > conv_polls(st->res)) {
+    STATS_CONV(dev, (uint8_t) st->retries);
+    ESP_STATS_INC(st->stats.timeouts);
+    st->retries = -1;
+    esp_eb_trigger(ESP_DS18B20_EV_TEMP_ERROR, dev);
   } else {
-    // The worst case from datasheet is 750ms when
-    // 12 bits of resolution is set.
-    // Each call to this function takes about 200*5us (1ms).
-    // If temperature is not available we call ourselves again
-    // after 10ms. That gives 11ms per call. 68 calls * 11ms = 748ms.
-    // This condition basically makes sure we are not
-    // calling ourselves forever.
-    if (st->retries > 68) {
-      st->retries = -1;
-      esp_eb_trigger(ESP_DS18B20_EV_TEMP_ERROR, dev);
+    // Try again.
+    timer->delay = ESP_DS18B20_POLL_MS;
+    esp_tim_continue(timer);
+  }
+}
+
+/**
+ * Read temperatures from all devices on the list.
+ *
+ * @param list The list of devices.
+ */
+static void ICACHE_FLASH_ATTR
+bus_read(esp_ow_device *list)
+{
+  esp_ds18b20_st *st;
+  uint32_t start;
+
+  while (list) {
+    st = list->custom;
+    start = system_get_time();
+    if (read_temp(list) != ESP_OW_OK) st_temp_err(st);
+    st->cpu_us += system_get_time() - start;
+    list = list->next;
+  }
+}
+
+/**
+ * Mark conversion on all devices on the list as failed.
+ *
+ * @param list    The list of devices.
+ * @param timeout Set to true when conversion did not finish in time.
+ */
+static void ICACHE_FLASH_ATTR
+bus_fail(esp_ow_device *list, bool timeout)
+{
+  esp_ds18b20_st *st;
+
+  while (list) {
+    st = list->custom;
+    if (timeout) ESP_STATS_INC(st->stats.timeouts);
+    st->retries = -1;
+    st_temp_err(st);
+    list = list->next;
+  }
+}
+
+/**
+ * Start conversion on all devices on the bus.
+ *
+ * On success all devices on the list are marked as busy.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param list     The list of devices on the bus.
+ * @param res      Set to the highest resolution found on the list.
+ *
+ * @return Error code.
+ */
+static esp_ds18b20_err ICACHE_FLASH_ATTR
+bus_convert(uint8_t gpio_num, esp_ow_device *list, uint8_t *res)
+{
+  esp_ow_device *curr;
+  esp_ds18b20_st *st;
+  ESP_STATS_START(start);
+
+  if (list == NULL) return ESP_DS18B20_NO_DEV;
+
+  // Find the slowest device and make sure none is busy.
+  for (curr = list; curr; curr = curr->next) {
+    st = curr->custom;
+    if (st->retries >= 0) return ESP_DS18B20_ERR_CONV_IN_PROG;
+    if (st->res > *res) *res = st->res;
+  }
+
+  if (esp_ow_reset(gpio_num) == false) return ESP_DS18B20_NO_DEV;
+
+  // Send conversion command to all devices at once.
+  esp_ow_write(gpio_num, ESP_OW_CMD_SKIP_ROM);
+  esp_ow_write(gpio_num, ESP_DS18B20_CMD_CONVERT);
+
+  // The bus command is shared so it's not accounted to any device
+  // CPU time but every device records it in its histogram.
+  for (curr = list; curr; curr = curr->next) {
+    st = curr->custom;
+    st->retries = 0;
+    st->cpu_us = 0;
+    ESP_STATS_HIST(st->stats.conv, start);
+  }
+
+  return ESP_DS18B20_OK;
+}
+
+static void ICACHE_FLASH_ATTR
+bus_conversion(void *arg)
+{
+  esp_tim_timer *timer = arg;
+  esp_ow_device *list = timer->payload;
+
+  // All devices finished conversion, read them back to back.
+  bus_read(list);
+
+  esp_eb_trigger(ESP_DS18B20_EV_BUS_READY, list);
+}
+
+static void ICACHE_FLASH_ATTR
+sampler_conversion(void *arg)
+{
+  uint8_t idx;
+  esp_ds18b20_bus *bus;
+  esp_tim_timer *timer = arg;
+  esp_ds18b20_sampler *smp = timer->payload;
+
+  smp->retries++;
+
+  // Read buses in the order they finish conversion.
+  for (idx = 0; idx < smp->bus_cnt; idx++) {
+    bus = &smp->buses[idx];
+    if (bus->busy == false) continue;
+
+    // Parasite powered devices can't signal end of conversion but
+    // the first tick is after the maximum conversion time then.
+    if (bus->parasite || esp_ow_read_bit(bus->gpio_num)) {
+      STATS_CONV(bus->list, (uint8_t) smp->retries);
+      bus_read(bus->list);
+    } else if (smp->retries > conv_polls(smp->res)) {
+      STATS_CONV(bus->list, (uint8_t) smp->retries);
+      bus_fail(bus->list, true);
+    } else {
+      continue;
+    }
+
+    bus->busy = false;
+    smp->busy--;
+    esp_eb_trigger(ESP_DS18B20_EV_BUS_READY, bus->list);
+  }
+
+  if (smp->busy == 0) {
+    smp->retries = -1;
+    esp_eb_trigger(ESP_DS18B20_EV_SAMPLER_READY, smp);
+    return;
+  }
+
+  timer->delay = ESP_DS18B20_POLL_MS;
+  esp_tim_continue(timer);
+}
+
+/**
+ * Find next device on OneWire bus.
+ *
+ * @param search The search state.
+ *
+ * @return OneWire error code. ESP_OW_ERR_NO_DEV when there are no more devices.
+ */
+static esp_ow_err ICACHE_FLASH_ATTR
+rom_next(esp_ds18b20_search_st *search)
+{
+  uint8_t bit;
+  uint8_t id;
+  uint8_t cmp;
+  uint8_t dir;
+  uint8_t mask;
+  uint8_t *byte;
+  uint8_t last_zero = 0;
+  uint8_t gpio_num = search->gpio_num;
+
+  if (search->done) return ESP_OW_ERR_NO_DEV;
+  if (!esp_ow_reset(gpio_num)) return ESP_OW_ERR_NO_DEV;
+
+  esp_ow_write(gpio_num, search->cmd);
+
+  for (bit = 1; bit <= 64; bit++) {
+    id = esp_ow_read_bit(gpio_num);
+    cmp = esp_ow_read_bit(gpio_num);
+    if (id && cmp) return ESP_OW_ERR_NO_DEV;
+
+    byte = &search->rom[(bit - 1) / 8];
+    mask = (uint8_t) (1 << ((bit - 1) % 8));
+
+    if (id != cmp) {
+      dir = id;
+    } else {
+      // Discrepancy. Follow previous path up to the last one.
+      if (bit < search->last_disc) {
+        dir = (uint8_t) ((*byte & mask) != 0);
+      } else {
+        dir = (uint8_t) (bit == search->last_disc);
+      }
+      if (dir == 0) last_zero = bit;
+    }
+
+    if (dir) {
+      *byte |= mask;
+    } else {
+      *byte &= ~mask;
+    }
+
+    esp_ow_write_bit(gpio_num, dir);
+  }
+
+  search->last_disc = last_zero;
+  search->done = (bool) (last_zero == 0);
+
+  if (esp_crc8_ow(0, search->rom, 8) != 0) return ESP_OW_ERR_BAD_CRC;
+
+  return ESP_OW_OK;
+}
+
+/**
+ * Find next device in asynchronous search.
+ *
+ * @param arg The timer.
+ */
+static void ICACHE_FLASH_ATTR
+search_tick(void *arg)
+{
+  esp_tim_timer *timer = arg;
+
+  esp_ow_device *dev;
+  esp_ds18b20_search_st *search = timer->payload;
+
+  search->err = esp_ds18b20_search_next(search);
+  if (search->err == ESP_OW_OK) {
+    dev = esp_ds18b20_new_dev(search->rom);
+    if (dev == NULL) {
+      search->err = ESP_OW_ERR_MEM;
     } else {
-      // Try again.
+      dev->gpio_num = search->gpio_num;
+      esp_eb_trigger(ESP_DS18B20_EV_DEV_FOUND, dev);
+
+      timer->delay = ESP_DS18B20_SEARCH_MS;
       esp_tim_continue(timer);
+      return;
     }
   }
+
+  // Running out of devices is not an error.
+  if (search->err == ESP_OW_ERR_NO_DEV) search->err = ESP_OW_OK;
+  esp_eb_trigger(ESP_DS18B20_EV_SEARCH_DONE, search);
+}
+
+/**
+ * Find device on the list by ROM address.
+ *
+ * @param list The list of devices.
+ * @param rom  The ROM address.
+ *
+ * @return The device or NULL.
+ */
+static esp_ow_device *ICACHE_FLASH_ATTR
+find_dev(esp_ow_device *list, const uint8_t *rom)
+{
+  while (list) {
+    if (os_memcmp(list->rom, rom, 8) == 0) return list;
+    list = list->next;
+  }
+
+  return NULL;
+}
+
+static void ICACHE_FLASH_ATTR
+monitor_conversion(void *arg)
+{
+  esp_tim_timer *timer = arg;
+
+  esp_ow_device *dev;
+  esp_ds18b20_monitor *mon = timer->payload;
+
+  // Only devices with temperature outside of TL..TH answer.
+  esp_ds18b20_search_first(&mon->search, mon->gpio_num, true);
+  while (esp_ds18b20_search_next(&mon->search) == ESP_OW_OK) {
+    dev = find_dev(mon->list, mon->search.rom);
+    if (dev == NULL) continue;
+
+    mon->alarms++;
+    if (read_temp(dev) != ESP_OW_OK) st_temp_err(dev->custom);
+    esp_eb_trigger(ESP_DS18B20_EV_ALARM, dev);
+  }
+
+  mon->busy = false;
+  esp_eb_trigger(ESP_DS18B20_EV_MONITOR_DONE, mon);
 }
 
 bool ICACHE_FLASH_ATTR
@@ -206,8 +652,7 @@ esp_ds18b20_search(uint8_t gpio_num, bool in_alert, esp_ow_device **list)
   curr = *list;
   while (curr) {
     curr->custom = os_zalloc(sizeof(esp_ds18b20_st));
-    ((esp_ds18b20_st *) curr->custom)->last_temp = ESP_DS18B20_TEMP_ERR;
-    ((esp_ds18b20_st *) curr->custom)->retries = -1;
+    st_init(curr->custom);
     curr = curr->next;
   }
 
@@ -226,8 +671,7 @@ esp_ds18b20_new_dev(uint8_t *rom)
     return NULL;
   }
 
-  st->last_temp = ESP_DS18B20_TEMP_ERR;
-  st->retries = -1;
+  st_init(st);
   device->custom = st;
 
   return device;
@@ -265,33 +709,201 @@ esp_ds18b20_set_alarm(esp_ow_device *dev, int8_t low, int8_t high)
   return esp_ds18b20_write_sp(dev);
 }
 
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_set_res(esp_ow_device *dev, uint8_t res)
+{
+  esp_ds18b20_st *st = dev->custom;
+  esp_ow_err err = esp_d18b20_read_sp(dev);
+  if (err != ESP_OW_OK) return err;
+
+  // Bits 5 and 6 set resolution, the rest is always 1.
+  st->sp[4] = (uint8_t) (((res & 0x3) << 5) | 0x1F);
+
+  err = esp_ds18b20_write_sp(dev);
+  if (err == ESP_OW_OK) st->res = (uint8_t) (res & 0x3);
+
+  return err;
+}
+
 void ICACHE_FLASH_ATTR
 esp_ds18b20_free_list(esp_ow_device *list)
 {
   esp_ow_free_device_list(list, true);
 }
 
+int32_t ICACHE_FLASH_ATTR
+esp_ds18b20_raw_to_mc(int16_t raw)
+{
+  if (raw == ESP_DS18B20_RAW_ERR) return ESP_DS18B20_TEMP_ERR_MC;
+
+  return esp_conv_ds18b20_mc(raw);
+}
+
 esp_ds18b20_err ICACHE_FLASH_ATTR
 esp_ds18b20_convert(esp_ow_device *device)
 {
+  uint32_t start;
+  uint16_t delay;
   esp_ds18b20_st *st = device->custom;
 
   // We are already waiting for the conversion.
   if (st->retries >= 0) return ESP_DS18B20_ERR_CONV_IN_PROG;
 
+  start = system_get_time();
+
+  // Power supply is checked once, the device is remembered.
+  if (st->parasite < 0) st->parasite = read_pwr(device);
+  if (st->parasite < 0) return ESP_DS18B20_NO_DEV;
+
+  ESP_STATS_START(cycles);
   if (esp_ow_reset(device->gpio_num) == false) return ESP_DS18B20_NO_DEV;
 
   // Send conversion command.
   esp_ow_match_dev(device);
   esp_ow_write(device->gpio_num, ESP_DS18B20_CMD_CONVERT);
+  ESP_STATS_HIST(st->stats.conv, cycles);
+  st->cpu_us = system_get_time() - start;
 
-  if (esp_tim_start(start_conversion, device)) {
+  // Conversion never finishes before half of the maximum time. Parasite
+  // powered device can't be polled so we wait the maximum time.
+  delay = conv_time(st->res);
+  if (st->parasite == 0) delay /= 2;
+
+  if (esp_tim_start_delay(start_conversion, device, delay)) {
     st->retries = 0;
   }
 
   return ESP_DS18B20_OK;
 }
 
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_convert_all(uint8_t gpio_num, esp_ow_device *list)
+{
+  uint8_t res = ESP_DS18B20_RES_9;
+  esp_ds18b20_err err = bus_convert(gpio_num, list, &res);
+  if (err != ESP_DS18B20_OK) return err;
+
+  if (esp_tim_start_delay(bus_conversion, list, conv_time(res))) {
+    return ESP_DS18B20_OK;
+  }
+
+  bus_fail(list, false);
+
+  return ESP_DS18B20_ERR_MEM;
+}
+
+esp_ds18b20_sampler *ICACHE_FLASH_ATTR
+esp_ds18b20_sampler_new(const uint8_t *gpios, uint8_t bus_cnt)
+{
+  uint8_t idx;
+  esp_ds18b20_bus *bus;
+  esp_ds18b20_sampler *smp;
+
+  smp = os_zalloc(sizeof(esp_ds18b20_sampler) + bus_cnt * sizeof(esp_ds18b20_bus));
+  if (smp == NULL) return NULL;
+
+  smp->buses = (esp_ds18b20_bus *) (smp + 1);
+  smp->bus_cnt = bus_cnt;
+  smp->retries = -1;
+
+  for (idx = 0; idx < bus_cnt; idx++) {
+    bus = &smp->buses[idx];
+    bus->gpio_num = gpios[idx];
+    esp_ds18b20_init(gpios[idx]);
+
+    // One broken bus must not take down the others.
+    bus->err = esp_ds18b20_search(gpios[idx], false, &bus->list);
+    if (bus->err != ESP_OW_OK) {
+      esp_ds18b20_free_list(bus->list);
+      bus->list = NULL;
+    }
+
+    if (bus->list) bus->parasite = esp_ds18b20_has_parasite(gpios[idx]);
+  }
+
+  return smp;
+}
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_sampler_free(esp_ds18b20_sampler *smp)
+{
+  uint8_t idx;
+
+  for (idx = 0; idx < smp->bus_cnt; idx++) {
+    esp_ds18b20_free_list(smp->buses[idx].list);
+  }
+
+  os_free(smp);
+}
+
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_sampler_start(esp_ds18b20_sampler *smp)
+{
+  uint8_t idx;
+  uint16_t delay;
+  esp_ds18b20_bus *bus;
+  bool parasite = false;
+
+  if (smp->retries >= 0) return ESP_DS18B20_ERR_CONV_IN_PROG;
+
+  smp->res = ESP_DS18B20_RES_9;
+
+  // Start conversions on all buses together.
+  for (idx = 0; idx < smp->bus_cnt; idx++) {
+    bus = &smp->buses[idx];
+    bus->busy = bus_convert(bus->gpio_num, bus->list, &smp->res) == ESP_DS18B20_OK;
+    if (bus->busy) smp->busy++;
+    if (bus->busy && bus->parasite) parasite = true;
+  }
+
+  if (smp->busy == 0) return ESP_DS18B20_NO_DEV;
+
+  // Conversion never finishes before half of the maximum time. With
+  // parasite powered devices there is nothing to poll so we wait the
+  // maximum time.
+  delay = conv_time(smp->res);
+  if (parasite == false) delay /= 2;
+
+  if (esp_tim_start_delay(sampler_conversion, smp, delay)) {
+    smp->retries = 0;
+    return ESP_DS18B20_OK;
+  }
+
+  for (idx = 0; idx < smp->bus_cnt; idx++) {
+    if (smp->buses[idx].busy) bus_fail(smp->buses[idx].list, false);
+    smp->buses[idx].busy = false;
+  }
+  smp->busy = 0;
+
+  return ESP_DS18B20_ERR_MEM;
+}
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_set_ring(esp_ring *r)
+{
+  ring = r;
+}
+
+#ifdef ESP_DRV_STATS
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_stats_get(esp_ow_device *dev, esp_ds18b20_stats *stats, bool reset)
+{
+  esp_ds18b20_st *st = dev->custom;
+
+  os_memcpy(stats, &st->stats, sizeof(esp_ds18b20_stats));
+  if (reset) os_memset(&st->stats, 0, sizeof(esp_ds18b20_stats));
+}
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_search_stats_get(esp_stats_hist *hist, bool reset)
+{
+  os_memcpy(hist, &search_hist, sizeof(esp_stats_hist));
+  if (reset) esp_stats_hist_reset(&search_hist);
+}
+
+#endif
+
 bool ICACHE_FLASH_ATTR
 esp_ds18b20_has_parasite(uint8_t gpio_num)
 {
@@ -307,3 +919,304 @@ esp_ds18b20_has_parasite(uint8_t gpio_num)
 
   return has_parasite;
 }
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_search_first(esp_ds18b20_search_st *search, uint8_t gpio_num, bool in_alert)
+{
+  os_memset(search, 0, sizeof(esp_ds18b20_search_st));
+  search->gpio_num = gpio_num;
+  search->cmd = in_alert ? ESP_OW_CMD_SEARCH_ROM_ALERT : ESP_OW_CMD_SEARCH_ROM;
+}
+
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_search_next(esp_ds18b20_search_st *search)
+{
+  esp_ow_err err;
+  ESP_STATS_START(start);
+
+  // Skip devices from other families.
+  do {
+    err = rom_next(search);
+  } while (err == ESP_OW_OK && search->rom[0] != ESP_DS18B20_FAMILY_CODE);
+
+  ESP_STATS_HIST(search_hist, start);
+
+  return err;
+}
+
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_search_start(esp_ds18b20_search_st *search, uint8_t gpio_num, bool in_alert)
+{
+  esp_ds18b20_search_first(search, gpio_num, in_alert);
+  if (!esp_tim_start(search_tick, search)) return ESP_DS18B20_ERR_MEM;
+
+  return ESP_DS18B20_OK;
+}
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_monitor_init(esp_ds18b20_monitor *mon, uint8_t gpio_num, esp_ow_device *list)
+{
+  esp_ds18b20_st *st;
+
+  os_memset(mon, 0, sizeof(esp_ds18b20_monitor));
+  mon->list = list;
+  mon->gpio_num = gpio_num;
+  mon->res = ESP_DS18B20_RES_9;
+
+  for (; list; list = list->next) {
+    st = list->custom;
+    if (st->res > mon->res) mon->res = st->res;
+  }
+}
+
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_monitor_start(esp_ds18b20_monitor *mon)
+{
+  ESP_STATS_START(start);
+
+  if (mon->busy) return ESP_DS18B20_ERR_CONV_IN_PROG;
+  if (esp_ow_reset(mon->gpio_num) == false) return ESP_DS18B20_NO_DEV;
+
+  // Send conversion command to all devices at once.
+  esp_ow_write(mon->gpio_num, ESP_OW_CMD_SKIP_ROM);
+  esp_ow_write(mon->gpio_num, ESP_DS18B20_CMD_CONVERT);
+
+#ifdef ESP_DRV_STATS
+  esp_ow_device *curr;
+  for (curr = mon->list; curr; curr = curr->next) {
+    ESP_STATS_HIST(((esp_ds18b20_st *) curr->custom)->stats.conv, start);
+  }
+#endif
+
+  if (!esp_tim_start_delay(monitor_conversion, mon, conv_time(mon->res))) {
+    return ESP_DS18B20_ERR_MEM;
+  }
+
+  mon->alarms = 0;
+  mon->busy = true;
+
+  return ESP_DS18B20_OK;
+}
+
+bool ICACHE_FLASH_ATTR
+esp_ds18b20_pool_init(esp_ds18b20_pool *pool, esp_ds18b20_slot *slots, uint8_t size)
+{
+  pool->owned = false;
+  if (slots == NULL) {
+    slots = os_zalloc(sizeof(esp_ds18b20_slot) * size);
+    if (slots == NULL) return false;
+    pool->owned = true;
+  }
+
+  pool->slots = slots;
+  pool->size = size;
+  pool->used = 0;
+  pool->truncated = 0;
+
+  return true;
+}
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_pool_free(esp_ds18b20_pool *pool)
+{
+  if (pool->owned) os_free(pool->slots);
+
+  pool->slots = NULL;
+  pool->size = 0;
+  pool->used = 0;
+  pool->truncated = 0;
+  pool->owned = false;
+}
+
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_pool_search(uint8_t gpio_num, bool in_alert, esp_ds18b20_pool *pool, esp_ow_device **list)
+{
+  esp_ow_err err;
+  esp_ds18b20_search_st search;
+  esp_ds18b20_slot *slot;
+  esp_ow_device **tail = list;
+
+  esp_ds18b20_search_first(&search, gpio_num, in_alert);
+  *list = NULL;
+  pool->truncated = 0;
+
+  while (true) {
+    err = esp_ds18b20_search_next(&search);
+    if (err == ESP_OW_ERR_NO_DEV) break;
+    if (err != ESP_OW_OK) return err;
+
+    // Keep searching to tell the caller how many devices did not fit.
+    if (pool->used == pool->size) {
+      if (pool->truncated < 0xFF) pool->truncated++;
+      continue;
+    }
+
+    slot = &pool->slots[pool->used++];
+    os_memset(slot, 0, sizeof(esp_ds18b20_slot));
+    os_memcpy(slot->dev.rom, search.rom, 8);
+    slot->dev.gpio_num = gpio_num;
+    slot->dev.custom = &slot->st;
+    st_init(&slot->st);
+
+    *tail = &slot->dev;
+    tail = &slot->dev.next;
+  }
+
+  return pool->truncated > 0 ? ESP_OW_ERR_MEM : ESP_OW_OK;
+}
+
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_inv_save(uint8_t gpio_num, esp_ow_device *list)
+{
+  inv_hdr hdr;
+  inv_dev dev;
+  esp_ow_err err;
+  esp_ow_device *curr;
+  esp_ds18b20_st *st;
+  uint16_t cnt = 0;
+  uint8_t block = ESP_DS18B20_INV_RTC_BLOCK + INV_HDR_BLOCKS;
+
+  // Partial inventory would restore only some devices so nothing
+  // is saved and the old one must not be used either.
+  for (curr = list; curr; curr = curr->next) cnt++;
+  if (cnt > ESP_DS18B20_INV_MAX) {
+    esp_ds18b20_inv_clear();
+    return ESP_OW_ERR_MEM;
+  }
+
+  // Configuration register has its lower 5 bits always set so zero
+  // means the scratchpad was never read.
+  for (curr = list; curr; curr = curr->next) {
+    st = curr->custom;
+    if (st->sp[4] != 0) continue;
+
+    err = esp_d18b20_read_sp(curr);
+    if (err != ESP_OW_OK) return err;
+  }
+
+  inv_valid = false;
+  os_memset(&hdr, 0, sizeof(inv_hdr));
+  os_memset(&dev, 0, sizeof(inv_dev));
+
+  hdr.magic = INV_MAGIC;
+  hdr.gpio_num = gpio_num;
+  hdr.crc = esp_crc8_ow(0, &hdr.gpio_num, 1);
+
+  for (; list; list = list->next) {
+    st = list->custom;
+    os_memcpy(dev.rom, list->rom, 8);
+    os_memcpy(dev.sp, &st->sp[2], 3);
+
+    if (system_rtc_mem_write(block, &dev, sizeof(inv_dev)) == false) {
+      return ESP_OW_ERR_MEM;
+    }
+
+    hdr.crc = esp_crc8_ow(hdr.crc, (uint8_t *) &dev, sizeof(inv_dev));
+    block += INV_DEV_BLOCKS;
+    hdr.cnt++;
+  }
+
+  hdr.crc = esp_crc8_ow(hdr.crc, &hdr.cnt, 1);
+
+  // Header goes last so interrupted save leaves invalid inventory.
+  if (system_rtc_mem_write(ESP_DS18B20_INV_RTC_BLOCK, &hdr, sizeof(inv_hdr)) == false) {
+    return ESP_OW_ERR_MEM;
+  }
+
+  inv_valid = true;
+
+  return ESP_OW_OK;
+}
+
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_inv_load(uint8_t gpio_num, esp_ow_device **list)
+{
+  uint8_t idx;
+  uint8_t crc;
+  inv_hdr hdr;
+  inv_dev dev;
+  esp_ow_device *curr;
+  esp_ow_device **tail = list;
+  esp_ds18b20_st *st;
+  uint8_t block = ESP_DS18B20_INV_RTC_BLOCK + INV_HDR_BLOCKS;
+
+  *list = NULL;
+
+  if (system_rtc_mem_read(ESP_DS18B20_INV_RTC_BLOCK, &hdr, sizeof(inv_hdr)) == false) {
+    return ESP_OW_ERR_MEM;
+  }
+
+  if (hdr.magic != INV_MAGIC || hdr.gpio_num != gpio_num || hdr.cnt > ESP_DS18B20_INV_MAX) {
+    return ESP_OW_ERR_BAD_CRC;
+  }
+
+  crc = esp_crc8_ow(0, &hdr.gpio_num, 1);
+
+  for (idx = 0; idx < hdr.cnt; idx++) {
+    curr = NULL;
+    if (system_rtc_mem_read(block, &dev, sizeof(inv_dev))) curr = esp_ds18b20_new_dev(dev.rom);
+    if (curr == NULL) {
+      esp_ds18b20_free_list(*list);
+      *list = NULL;
+      return ESP_OW_ERR_MEM;
+    }
+
+    crc = esp_crc8_ow(crc, (uint8_t *) &dev, sizeof(inv_dev));
+    block += INV_DEV_BLOCKS;
+
+    st = curr->custom;
+    os_memcpy(&st->sp[2], dev.sp, 3);
+    st->res = (uint8_t) ((st->sp[4] & 0x60) >> 5);
+    curr->gpio_num = gpio_num;
+
+    *tail = curr;
+    tail = &curr->next;
+  }
+
+  if (esp_crc8_ow(crc, &hdr.cnt, 1) != hdr.crc) {
+    esp_ds18b20_free_list(*list);
+    *list = NULL;
+    return ESP_OW_ERR_BAD_CRC;
+  }
+
+  inv_valid = true;
+
+  return ESP_OW_OK;
+}
+
+void ICACHE_FLASH_ATTR
+esp_ds18b20_inv_clear()
+{
+  inv_hdr hdr;
+
+  os_memset(&hdr, 0, sizeof(inv_hdr));
+  system_rtc_mem_write(ESP_DS18B20_INV_RTC_BLOCK, &hdr, sizeof(inv_hdr));
+  inv_valid = false;
+}
+
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_restore(uint8_t gpio_num, esp_ow_device **list)
+{
+  esp_ow_device *curr;
+  esp_ow_err err = esp_ds18b20_inv_load(gpio_num, list);
+
+  // Every device must answer. Reading scratchpads also brings back
+  // the configuration from before deep sleep.
+  for (curr = *list; err == ESP_OW_OK && curr; curr = curr->next) {
+    err = esp_d18b20_read_sp(curr);
+  }
+
+  if (err == ESP_OW_OK && *list != NULL) return ESP_OW_OK;
+
+  esp_ds18b20_free_list(*list);
+  *list = NULL;
+
+  err = esp_ds18b20_search(gpio_num, false, list);
+  if (err != ESP_OW_OK) return err;
+
+  err = esp_ds18b20_inv_save(gpio_num, *list);
+
+  // The list is complete even when it did not fit in the inventory,
+  // the next restore runs full search again.
+  return err == ESP_OW_ERR_MEM ? ESP_OW_OK : err;
+}
@@ -18,6 +18,8 @@
 #define ESP_DS18B20_H
 
 #include <esp_ow.h>
+#include <esp_ring.h>
+#include <esp_stats.h>
 #include <c_types.h>
 
 // The DS18B20 family code from datasheet.
@@ -25,11 +27,38 @@
 
 // The absolute zero temperature is returned as error.
 #define ESP_DS18B20_TEMP_ERR (-273)
+// The absolute zero temperature in milli Celsius is returned as error.
+#define ESP_DS18B20_TEMP_ERR_MC (-273000)
+// Invalid raw temperature. Never returned by the device.
+#define ESP_DS18B20_RAW_ERR ((int16_t) 0x8000)
 
 // Temperature conversion ready.
 #define ESP_DS18B20_EV_TEMP_READY "ds18b20tReady"
 // Temperature conversion error.
 #define ESP_DS18B20_EV_TEMP_ERROR "ds18b20tError"
+// Temperature conversion on all devices on the bus finished.
+#define ESP_DS18B20_EV_BUS_READY "ds18b20bReady"
+// Temperature conversion on all sampler buses finished.
+#define ESP_DS18B20_EV_SAMPLER_READY "ds18b20sReady"
+// Device found by asynchronous search.
+#define ESP_DS18B20_EV_DEV_FOUND "ds18b20dFound"
+// Asynchronous search finished.
+#define ESP_DS18B20_EV_SEARCH_DONE "ds18b20sDone"
+// Device in alarm found by monitor.
+#define ESP_DS18B20_EV_ALARM "ds18b20Alarm"
+// Monitor cycle finished.
+#define ESP_DS18B20_EV_MONITOR_DONE "ds18b20mDone"
+
+// The first RTC user memory block (4 bytes each) for ROM inventory.
+#ifndef ESP_DS18B20_INV_RTC_BLOCK
+  #define ESP_DS18B20_INV_RTC_BLOCK 64
+#endif
+
+// Maximum number of devices in ROM inventory.
+// The inventory takes 8 + 12 * ESP_DS18B20_INV_MAX bytes of RTC memory.
+#ifndef ESP_DS18B20_INV_MAX
+  #define ESP_DS18B20_INV_MAX 32
+#endif
 
 // Temperature resolutions.
 #define ESP_DS18B20_RES_9 0x0
@@ -43,6 +72,18 @@
 #define ESP_DS18B20_STEP_11 0.125
 #define ESP_DS18B20_STEP_12 0.0625
 
+// Maximum conversion times in milliseconds (from datasheet).
+#define ESP_DS18B20_CONV_MS_9 94
+#define ESP_DS18B20_CONV_MS_10 188
+#define ESP_DS18B20_CONV_MS_11 375
+#define ESP_DS18B20_CONV_MS_12 750
+
+// Conversion status poll interval in milliseconds.
+#define ESP_DS18B20_POLL_MS 10
+
+// Asynchronous search interval between devices in milliseconds.
+#define ESP_DS18B20_SEARCH_MS 1
+
 // OneWire commands.
 typedef enum {
   ESP_DS18B20_CMD_READ_PWR = 0xB4,
@@ -55,15 +96,106 @@ typedef enum {
   ESP_DS18B20_OK,
   ESP_DS18B20_NO_DEV,
   ESP_DS18B20_ERR_CONV_IN_PROG, // Conversion in progress.
+  ESP_DS18B20_ERR_MEM,          // Out of memory.
 } esp_ds18b20_err;
 
+// DS18B20 statistics (compiled in with ESP_DRV_STATS).
+//
+// The stats field changes esp_ds18b20_st layout so ESP_DRV_STATS must be
+// defined for the driver and all the code using it (set it globally).
+//
+// Polls are counted for conversions polled for end of conversion
+// (esp_ds18b20_convert and the sampler).
+typedef struct {
+  uint32_t reads;         // Number of scratchpad reads.
+  uint32_t crc_errs;      // Number of scratchpad CRC errors.
+  uint32_t presence_errs; // Number of reads without presence pulse.
+  uint32_t timeouts;      // Number of conversions which never finished.
+  uint32_t convs;         // Number of polled conversions.
+  uint32_t polls;         // Number of status polls in all polled conversions.
+  uint8_t polls_last;     // Number of status polls in the last conversion.
+  uint8_t polls_max;      // Most status polls any conversion needed.
+  esp_stats_hist read;    // Scratchpad read transaction CPU cycles.
+  esp_stats_hist write;   // Scratchpad write transaction CPU cycles.
+  esp_stats_hist conv;    // Convert T transaction CPU cycles. Bus wide
+                          // conversion is added to every device on the bus.
+} esp_ds18b20_stats;
+
 // DS18B20 status.
+//
+// Define ESP_DS18B20_NO_FLOAT to compile out floating point
+// temperature decoding and use only the raw value. The last_temp
+// field stays so the structure layout does not depend on the define
+// but it's always ESP_DS18B20_TEMP_ERR.
 typedef struct {
   uint8_t sp[9];
   int8_t retries;  // Is greater then zero when conversion in progress.
+  uint8_t res;     // Active resolution. One of ESP_DS18B20_RES_* defines.
+  int8_t parasite; // Parasite powered: 1 - yes, 0 - no, -1 - not checked yet.
+  int16_t raw;     // Last temperature register value in 1/16 Celsius.
   float last_temp; // Last successful temperature read.
+  // CPU time in microseconds spent on the last conversion. Reset when
+  // conversion starts and accumulated over conversion command, status
+  // polls and scratchpad read.
+  uint32_t cpu_us;
+  uint8_t id;      // Sensor id for sample ring records.
+#ifdef ESP_DRV_STATS
+  esp_ds18b20_stats stats;
+#endif
 } esp_ds18b20_st;
 
+// OneWire bus with DS18B20 devices.
+typedef struct {
+  esp_ow_device *list; // The list of devices on the bus.
+  uint8_t gpio_num;    // The GPIO where OneWire bus is connected.
+  bool busy;           // Is true when conversion in progress.
+  bool parasite;       // Is true when bus has parasite powered devices.
+  esp_ow_err err;      // The device search result.
+} esp_ds18b20_bus;
+
+// Sampler for many OneWire buses.
+typedef struct {
+  esp_ds18b20_bus *buses; // The array of buses.
+  uint8_t bus_cnt;        // The number of buses.
+  uint8_t busy;           // The number of buses with conversion in progress.
+  uint8_t res;            // The highest resolution on all buses.
+  int8_t retries;         // Is greater then zero when conversion in progress.
+} esp_ds18b20_sampler;
+
+// Incremental ROM search.
+typedef struct {
+  uint8_t rom[8];    // The last found ROM address.
+  uint8_t last_disc; // The bit position (1-64) of last discrepancy.
+  bool done;         // Is true when last device was found.
+  uint8_t gpio_num;  // The GPIO where OneWire bus is connected.
+  esp_ow_cmd cmd;    // The search command.
+  esp_ow_err err;    // The asynchronous search result.
+} esp_ds18b20_search_st;
+
+// Alarm monitor for OneWire bus.
+typedef struct {
+  esp_ow_device *list;          // The list of devices on the bus.
+  esp_ds18b20_search_st search; // The alarm search state.
+  uint8_t gpio_num;             // The GPIO where OneWire bus is connected.
+  uint8_t res;                  // The highest resolution on the list.
+  uint8_t alarms;               // The number of devices in alarm in last cycle.
+  bool busy;                    // Is true when cycle is in progress.
+} esp_ds18b20_monitor;
+
+// Device pool slot.
+typedef struct {
+  esp_ow_device dev;
+  esp_ds18b20_st st;
+} esp_ds18b20_slot;
+
+// Pool of devices in one contiguous memory block.
+typedef struct {
+  esp_ds18b20_slot *slots; // The array of slots.
+  uint8_t size;            // The number of slots.
+  uint8_t used;            // The number of used slots.
+  uint8_t truncated;       // The number of devices which did not fit in last search.
+  bool owned;              // Is true when slots were allocated by the driver.
+} esp_ds18b20_pool;
 
 /**
  * Initialize OneWire bus where DS18B20 is.
@@ -136,6 +268,20 @@ esp_ds18b20_get_alarm(esp_ow_device *dev, int8_t *low, int8_t *high);
 esp_ow_err ICACHE_FLASH_ATTR
 esp_ds18b20_set_alarm(esp_ow_device *dev, int8_t low, int8_t high);
 
+/**
+ * Set DS18B20 temperature resolution.
+ *
+ * Conversion deadlines are computed from the resolution so lower
+ * resolutions allow for faster sampling.
+ *
+ * @param dev The device to set resolution for.
+ * @param res The resolution. One of ESP_DS18B20_RES_* defines.
+ *
+ * @return OneWire error code.
+ */
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_set_res(esp_ow_device *dev, uint8_t res);
+
 /**
  * Read scrachpad.
  *
@@ -164,9 +310,25 @@ esp_ds18b20_write_sp(esp_ow_device *device);
 void ICACHE_FLASH_ATTR
 esp_ds18b20_free_list(esp_ow_device *list);
 
+/**
+ * Convert raw temperature to milli Celsius.
+ *
+ * Uses only integer math.
+ *
+ * @param raw The raw temperature (esp_ds18b20_st.raw).
+ *
+ * @return The temperature in milli Celsius or ESP_DS18B20_TEMP_ERR_MC.
+ */
+int32_t ICACHE_FLASH_ATTR
+esp_ds18b20_raw_to_mc(int16_t raw);
+
 /**
  * Start temperature conversion.
  *
+ * The first call reads device power supply. Parasite powered device
+ * can't signal end of conversion so it's read after the maximum
+ * conversion time instead of polling the bus.
+ *
  * @param device The device to start conversion on.
  *
  * @return Error code.
@@ -174,6 +336,106 @@ esp_ds18b20_free_list(esp_ow_device *list);
 esp_ds18b20_err ICACHE_FLASH_ATTR
 esp_ds18b20_convert(esp_ow_device *device);
 
+/**
+ * Start temperature conversion on all devices on the bus.
+ *
+ * Sends one Skip ROM conversion command to the bus, waits for the slowest
+ * device (based on its active resolution) and then reads scratchpads
+ * of all devices in the list one after another.
+ *
+ * When finished ESP_DS18B20_EV_BUS_READY event is triggered with the list
+ * passed as the argument. Devices which failed to return temperature have
+ * raw set to ESP_DS18B20_RAW_ERR and last_temp set to ESP_DS18B20_TEMP_ERR.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param list     The list of devices on the bus (see esp_ds18b20_search).
+ *
+ * @return Error code.
+ */
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_convert_all(uint8_t gpio_num, esp_ow_device *list);
+
+/**
+ * Create sampler for many OneWire buses.
+ *
+ * Initializes and searches every bus for DS18B20 devices. The sampler owns
+ * found device lists and releases them in esp_ds18b20_sampler_free.
+ *
+ * A bus where search failed is kept with empty device list and the error
+ * in its err field. It's skipped by esp_ds18b20_sampler_start.
+ *
+ * @param gpios   The array of GPIOs where OneWire buses are connected.
+ * @param bus_cnt The number of buses.
+ *
+ * @return The sampler or NULL when out of memory.
+ */
+esp_ds18b20_sampler *ICACHE_FLASH_ATTR
+esp_ds18b20_sampler_new(const uint8_t *gpios, uint8_t bus_cnt);
+
+/**
+ * Free sampler and all its device lists.
+ *
+ * @param smp The sampler.
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_sampler_free(esp_ds18b20_sampler *smp);
+
+/**
+ * Start temperature conversion on all sampler buses.
+ *
+ * Conversions on all buses are started together and a single timer polls
+ * them. Each bus is read as soon as it finishes and ESP_DS18B20_EV_BUS_READY
+ * event is triggered with its device list. When all buses are done
+ * ESP_DS18B20_EV_SAMPLER_READY event is triggered with the sampler.
+ *
+ * Parasite powered devices can't signal end of conversion so when any
+ * busy bus has them all buses are read after the maximum conversion time.
+ *
+ * @param smp The sampler.
+ *
+ * @return Error code.
+ */
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_sampler_start(esp_ds18b20_sampler *smp);
+
+/**
+ * Set sample ring.
+ *
+ * Every temperature read (successful or not) is added to the ring
+ * as ESP_RING_DS18B20 record with esp_ds18b20_st.id as sensor id.
+ *
+ * @param ring The ring or NULL to disable.
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_set_ring(esp_ring *ring);
+
+#ifdef ESP_DRV_STATS
+
+/**
+ * Get device statistics.
+ *
+ * @param dev   The device.
+ * @param stats The statistics snapshot.
+ * @param reset Reset statistics after taking the snapshot.
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_stats_get(esp_ow_device *dev, esp_ds18b20_stats *stats, bool reset);
+
+/**
+ * Get ROM search statistics.
+ *
+ * Every esp_ds18b20_search_next call (incremental, asynchronous, pool
+ * and alarm monitor searches) adds its CPU cycles to the histogram.
+ * Full search done by esp_ds18b20_search is not timed.
+ *
+ * @param hist  The histogram snapshot.
+ * @param reset Reset the histogram after taking the snapshot.
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_search_stats_get(esp_stats_hist *hist, bool reset);
+
+#endif
+
 /**
  * Check if OneWire bus has device with parasite power supply.
  *
@@ -184,4 +446,195 @@ esp_ds18b20_convert(esp_ow_device *device);
 bool ICACHE_FLASH_ATTR
 esp_ds18b20_has_parasite(uint8_t gpio_num);
 
+/**
+ * Start incremental search.
+ *
+ * Only resets the search state, the bus is not touched.
+ *
+ * @param search   The search state.
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param in_alert Find only devices in alert mode.
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_search_first(esp_ds18b20_search_st *search, uint8_t gpio_num, bool in_alert);
+
+/**
+ * Find next DS18B20 device on OneWire bus.
+ *
+ * On success the ROM address of found device is in search->rom.
+ *
+ * @param search The search state.
+ *
+ * @return OneWire error code. ESP_OW_ERR_NO_DEV when there are no more devices.
+ */
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_search_next(esp_ds18b20_search_st *search);
+
+/**
+ * Find devices on OneWire bus one per timer tick.
+ *
+ * For every device ESP_DS18B20_EV_DEV_FOUND event is triggered with
+ * the new device as the argument. The device is ready for conversion
+ * and it's up to the event handler to keep it and release it
+ * with esp_ds18b20_free_list. When search is finished
+ * ESP_DS18B20_EV_SEARCH_DONE event is triggered with the search state
+ * as the argument and search->err set.
+ *
+ * The search state must be valid until ESP_DS18B20_EV_SEARCH_DONE.
+ *
+ * @param search   The search state.
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param in_alert Find only devices in alert mode.
+ *
+ * @return Error code.
+ */
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_search_start(esp_ds18b20_search_st *search, uint8_t gpio_num, bool in_alert);
+
+/**
+ * Initialize alarm monitor.
+ *
+ * Set alarm thresholds with esp_ds18b20_set_alarm before starting the monitor.
+ * Call it again after changing resolution of any device on the list.
+ *
+ * @param mon      The monitor.
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param list     The list of devices on the bus.
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_monitor_init(esp_ds18b20_monitor *mon, uint8_t gpio_num, esp_ow_device *list);
+
+/**
+ * Run one alarm monitor cycle.
+ *
+ * Starts conversion on all devices with one Skip ROM command and when it's
+ * done runs alarm search. Only devices in alarm are read and for each of
+ * them ESP_DS18B20_EV_ALARM event is triggered with the device as the
+ * argument. When the cycle is finished ESP_DS18B20_EV_MONITOR_DONE event is
+ * triggered with the monitor as the argument.
+ *
+ * With no alarms the cycle costs two bus resets no matter how many devices
+ * are on the bus.
+ *
+ * @param mon The monitor.
+ *
+ * @return Error code.
+ */
+esp_ds18b20_err ICACHE_FLASH_ATTR
+esp_ds18b20_monitor_start(esp_ds18b20_monitor *mon);
+
+/**
+ * Initialize device pool.
+ *
+ * Pass NULL as slots to have the driver allocate all of them
+ * with one os_zalloc call.
+ *
+ * @param pool  The pool to initialize.
+ * @param slots The array of slots or NULL.
+ * @param size  The number of slots.
+ *
+ * @return Returns true on success, false otherwise.
+ */
+bool ICACHE_FLASH_ATTR
+esp_ds18b20_pool_init(esp_ds18b20_pool *pool, esp_ds18b20_slot *slots, uint8_t size);
+
+/**
+ * Release device pool.
+ *
+ * Slots are released only when allocated by esp_ds18b20_pool_init.
+ * Devices from the pool must never be passed to esp_ds18b20_free_list.
+ *
+ * @param pool The pool to release.
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_pool_free(esp_ds18b20_pool *pool);
+
+/**
+ * Find devices on OneWire bus and put them in the pool.
+ *
+ * Search does not allocate any memory. Devices are linked in the order
+ * they were found and are appended to the ones already in the pool.
+ *
+ * When the pool gets full the search goes on only to count devices which
+ * did not fit. The count is set in pool->truncated (saturates at 255) and
+ * ESP_OW_ERR_MEM is returned with the list of devices which fit.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param in_alert Find only devices in alert mode.
+ * @param pool     The pool.
+ * @param list     The list of found devices or NULL.
+ *
+ * @return OneWire error code. ESP_OW_ERR_MEM when some devices did not fit.
+ */
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_pool_search(uint8_t gpio_num, bool in_alert, esp_ds18b20_pool *pool, esp_ow_device **list);
+
+/**
+ * Save found devices to RTC memory.
+ *
+ * Saves ROM addresses, alarm thresholds and configuration register
+ * (from last read scratchpad) of up to ESP_DS18B20_INV_MAX devices.
+ * Scratchpads of devices which were never read are read first.
+ * The inventory survives deep sleep.
+ *
+ * There is only one inventory so it serves one OneWire bus. Saving
+ * devices from another bus replaces it.
+ *
+ * Once saved or loaded the inventory is invalidated when reading
+ * temperature from any device fails.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param list     The list of devices.
+ *
+ * @return OneWire error code. ESP_OW_ERR_MEM when the list has more than
+ *         ESP_DS18B20_INV_MAX devices (nothing is saved and the inventory
+ *         is invalidated) or RTC memory write failed.
+ */
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_inv_save(uint8_t gpio_num, esp_ow_device *list);
+
+/**
+ * Load devices from RTC memory.
+ *
+ * It's up to the caller to release the list with esp_ds18b20_free_list.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param list     The list of devices or NULL.
+ *
+ * @return OneWire error code. ESP_OW_ERR_BAD_CRC when inventory is not valid,
+ *         ESP_OW_ERR_MEM when RTC memory read or allocation failed.
+ */
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_inv_load(uint8_t gpio_num, esp_ow_device **list);
+
+/**
+ * Invalidate ROM inventory in RTC memory.
+ *
+ * The next esp_ds18b20_restore runs full search. The driver calls it
+ * when reading temperature fails. Call it yourself when you know the
+ * bus changed (for example a device was added).
+ */
+void ICACHE_FLASH_ATTR
+esp_ds18b20_inv_clear();
+
+/**
+ * Get devices on OneWire bus using ROM inventory.
+ *
+ * Loads devices from RTC memory and reads scratchpad of every device
+ * which checks it's still on the bus and refreshes its configuration.
+ * Runs full search and saves new inventory when inventory is not valid
+ * or any device does not answer. Devices added to the bus are found only
+ * after the inventory is invalidated (see esp_ds18b20_inv_clear).
+ *
+ * When the bus has more than ESP_DS18B20_INV_MAX devices the inventory
+ * can't be saved and every call runs full search.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param list     The list of devices or NULL.
+ *
+ * @return OneWire error code.
+ */
+esp_ow_err ICACHE_FLASH_ATTR
+esp_ds18b20_restore(uint8_t gpio_num, esp_ow_device **list);
+
 #endif //ESP_DS18B20_H
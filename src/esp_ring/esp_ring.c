@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <esp_ring.h>
+#include <osapi.h>
+#include <mem.h>
+#include <user_interface.h>
+
+// Keep compiler from reordering record access and index update.
+// ESP8266 has one core so compiler barrier is enough. Host builds
+// (producer and consumer in different threads) need a memory fence.
+#ifdef __XTENSA__
+  #define BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+  #define BARRIER() __sync_synchronize()
+#endif
+
+bool ICACHE_FLASH_ATTR
+esp_ring_init(esp_ring *ring, esp_ring_rec *recs, uint16_t size)
+{
+  if (size == 0 || (size & (size - 1)) != 0) return false;
+
+  ring->owned = false;
+  if (recs == NULL) {
+    recs = os_zalloc(sizeof(esp_ring_rec) * size);
+    if (recs == NULL) return false;
+    ring->owned = true;
+  }
+
+  ring->recs = recs;
+  ring->mask = (uint16_t) (size - 1);
+  ring->head = 0;
+  ring->tail = 0;
+  ring->dropped = 0;
+
+  return true;
+}
+
+void ICACHE_FLASH_ATTR
+esp_ring_free(esp_ring *ring)
+{
+  if (ring->owned) os_free(ring->recs);
+
+  ring->recs = NULL;
+  ring->owned = false;
+}
+
+bool
+esp_ring_push(esp_ring *ring, uint8_t id, uint8_t type, uint8_t status, uint32_t raw)
+{
+  uint16_t head = ring->head;
+  esp_ring_rec *rec;
+
+  // Indexes are free running, the difference is the number of records.
+  if ((uint16_t) (head - ring->tail) > ring->mask) {
+    ring->dropped++;
+    return false;
+  }
+
+  rec = &ring->recs[head & ring->mask];
+  rec->time = system_get_time();
+  rec->raw = raw;
+  rec->id = id;
+  rec->type = type;
+  rec->status = status;
+  rec->pad = 0;
+
+  // Record must be complete before consumer can see it.
+  BARRIER();
+  ring->head = (uint16_t) (head + 1);
+
+  return true;
+}
+
+uint16_t ICACHE_FLASH_ATTR
+esp_ring_pop(esp_ring *ring, esp_ring_rec *recs, uint16_t max)
+{
+  uint16_t cnt = 0;
+  uint16_t tail = ring->tail;
+  uint16_t head = ring->head;
+
+  BARRIER();
+
+  while (tail != head && cnt < max) {
+    recs[cnt++] = ring->recs[tail & ring->mask];
+    tail++;
+  }
+
+  // Records must be copied before producer can reuse them.
+  BARRIER();
+  ring->tail = tail;
+
+  return cnt;
+}
+
+uint16_t ICACHE_FLASH_ATTR
+esp_ring_count(esp_ring *ring)
+{
+  return (uint16_t) (ring->head - ring->tail);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef ESP_RING_H
+#define ESP_RING_H
+
+#ifdef __XTENSA__
+  #include <c_types.h>
+#else
+  // Host (gateway) build without ESP8266 SDK.
+  #include <stdint.h>
+  #include <stdbool.h>
+  #include <stddef.h>
+  #ifndef ICACHE_FLASH_ATTR
+    #define ICACHE_FLASH_ATTR
+  #endif
+#endif
+
+// Sample record types.
+typedef enum {
+  ESP_RING_DS18B20 = 1, // DS18B20 temperature register (1/16 Celsius).
+  ESP_RING_DHT22,       // DHT22 frame bytes 0-3 (humidity, temperature) MSB first.
+  ESP_RING_SHT21_RH,    // SHT21 humidity word with status bits cleared.
+  ESP_RING_SHT21_TEMP,  // SHT21 temperature word with status bits cleared.
+} esp_ring_type;
+
+// Sample record.
+typedef struct {
+  uint32_t time;  // Sample time. Uses system_get_time().
+  uint32_t raw;   // Raw value as read from the device.
+  uint8_t id;     // Sensor id set by the user.
+  uint8_t type;   // One of esp_ring_type.
+  uint8_t status; // Driver error code. Zero on success.
+  uint8_t pad;
+} esp_ring_rec;
+
+// Single producer, single consumer ring of sample records.
+typedef struct {
+  esp_ring_rec *recs;        // The array of records.
+  uint16_t mask;             // The number of records minus one.
+  volatile uint16_t head;    // Next record to write. Changed only by producer.
+  volatile uint16_t tail;    // Next record to read. Changed only by consumer.
+  volatile uint32_t dropped; // Number of records dropped because ring was full.
+  bool owned;                // Is true when records were allocated by the ring.
+} esp_ring;
+
+
+/**
+ * Initialize ring.
+ *
+ * Pass NULL as recs to allocate records.
+ *
+ * @param ring The ring.
+ * @param recs The array of records or NULL.
+ * @param size The number of records. Must be power of two.
+ *
+ * @return Returns true on success, false otherwise.
+ */
+bool ICACHE_FLASH_ATTR
+esp_ring_init(esp_ring *ring, esp_ring_rec *recs, uint16_t size);
+
+/**
+ * Release ring records.
+ *
+ * Records are released only when allocated by esp_ring_init.
+ *
+ * @param ring The ring.
+ */
+void ICACHE_FLASH_ATTR
+esp_ring_free(esp_ring *ring);
+
+/**
+ * Add sample to the ring.
+ *
+ * Kept in IRAM so it can be called from interrupt handler. Only one
+ * context (task or interrupt) may push to the ring. When ring is full
+ * the sample is dropped and counted.
+ *
+ * @param ring   The ring.
+ * @param id     The sensor id.
+ * @param type   The record type.
+ * @param status The driver error code.
+ * @param raw    The raw value.
+ *
+ * @return Returns true on success, false when ring is full.
+ */
+bool
+esp_ring_push(esp_ring *ring, uint8_t id, uint8_t type, uint8_t status, uint32_t raw);
+
+/**
+ * Take samples from the ring.
+ *
+ * @param ring The ring.
+ * @param recs The buffer for records.
+ * @param max  The buffer size.
+ *
+ * @return The number of records copied to the buffer.
+ */
+uint16_t ICACHE_FLASH_ATTR
+esp_ring_pop(esp_ring *ring, esp_ring_rec *recs, uint16_t max);
+
+/**
+ * Get number of samples in the ring.
+ *
+ * @param ring The ring.
+ *
+ * @return The number of samples.
+ */
+uint16_t ICACHE_FLASH_ATTR
+esp_ring_count(esp_ring *ring);
+
+#endif //ESP_RING_H
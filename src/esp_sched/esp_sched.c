@@ -0,0 +1,184 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <esp_sched.h>
+#include <osapi.h>
+#include <mem.h>
+#include <user_interface.h>
+
+// Scheduled jobs sorted by priority.
+static esp_sched_job *jobs;
+// Running exclusive job.
+static esp_sched_job *excl;
+// Radio idle predicate.
+static esp_sched_idle_cb *idle_cb;
+// Scheduler timer.
+static os_timer_t timer;
+
+
+/**
+ * Run the job.
+ *
+ * @param job The job.
+ * @param now The current time.
+ */
+static void ICACHE_FLASH_ATTR
+job_run(esp_sched_job *job, uint32_t now)
+{
+  uint32_t late = now - job->next_us;
+  uint32_t period_us = job->period_ms * 1000;
+
+  job->runs++;
+  job->jitter_sum_us += late;
+  if (late > job->jitter_max_us) job->jitter_max_us = late;
+
+  // Skip periods we are too late for.
+  if (late >= period_us) {
+    job->missed += late / period_us;
+    job->next_us += (late / period_us) * period_us;
+  }
+
+  job->next_us += period_us;
+  job->busy = true;
+  if (job->exclusive) excl = job;
+
+  if (!job->cb(job->arg)) esp_sched_done(job);
+}
+
+static void ICACHE_FLASH_ATTR
+sched_tick(void *arg)
+{
+  uint32_t now;
+  esp_sched_job *job;
+  bool excl_ran = false;
+
+  for (job = jobs; job; job = job->next) {
+    if (job->busy) continue;
+
+    now = system_get_time();
+    if ((int32_t) (now - job->next_us) < 0) continue;
+
+    if (job->exclusive) {
+      // Never run two timing critical transactions in one tick.
+      if (excl != NULL || excl_ran) continue;
+
+      if (idle_cb != NULL && !idle_cb()
+          && now - job->next_us < ESP_SCHED_MAX_DEFER_MS * 1000) {
+        continue;
+      }
+
+      excl_ran = true;
+    }
+
+    job_run(job, now);
+  }
+}
+
+esp_sched_job *ICACHE_FLASH_ATTR
+esp_sched_new(esp_sched_cb *cb, void *arg, uint32_t period_ms, uint8_t prio, bool exclusive)
+{
+  esp_sched_job *job;
+
+  if (cb == NULL || period_ms == 0 || period_ms > ESP_SCHED_MAX_PERIOD_MS) return NULL;
+
+  job = os_zalloc(sizeof(esp_sched_job));
+  if (job == NULL) return NULL;
+
+  job->cb = cb;
+  job->arg = arg;
+  job->period_ms = period_ms;
+  job->prio = prio;
+  job->exclusive = exclusive;
+
+  return job;
+}
+
+void ICACHE_FLASH_ATTR
+esp_sched_add(esp_sched_job *job)
+{
+  esp_sched_job **curr = &jobs;
+
+  // Keep the list sorted by priority.
+  while (*curr && (*curr)->prio <= job->prio) curr = &(*curr)->next;
+
+  job->next = *curr;
+  job->next_us = system_get_time();
+  *curr = job;
+}
+
+bool ICACHE_FLASH_ATTR
+esp_sched_delay(esp_sched_job *job, uint32_t ms)
+{
+  if (ms > ESP_SCHED_MAX_PERIOD_MS) return false;
+
+  job->next_us += ms * 1000;
+
+  return true;
+}
+
+void ICACHE_FLASH_ATTR
+esp_sched_free(esp_sched_job *job)
+{
+  esp_sched_job **curr = &jobs;
+
+  while (*curr && *curr != job) curr = &(*curr)->next;
+  if (*curr) *curr = job->next;
+
+  // Asynchronous job still holds the pointer and calls esp_sched_done.
+  if (job->busy) {
+    job->freed = true;
+    return;
+  }
+
+  os_free(job);
+}
+
+void ICACHE_FLASH_ATTR
+esp_sched_done(esp_sched_job *job)
+{
+  job->busy = false;
+  if (excl == job) excl = NULL;
+  if (job->freed) os_free(job);
+}
+
+void ICACHE_FLASH_ATTR
+esp_sched_set_idle_cb(esp_sched_idle_cb *cb)
+{
+  idle_cb = cb;
+}
+
+void ICACHE_FLASH_ATTR
+esp_sched_reset_stats(esp_sched_job *job)
+{
+  job->runs = 0;
+  job->missed = 0;
+  job->jitter_max_us = 0;
+  job->jitter_sum_us = 0;
+}
+
+void ICACHE_FLASH_ATTR
+esp_sched_start()
+{
+  os_timer_disarm(&timer);
+  os_timer_setfn(&timer, sched_tick, NULL);
+  os_timer_arm(&timer, ESP_SCHED_TICK_MS, true);
+}
+
+void ICACHE_FLASH_ATTR
+esp_sched_stop()
+{
+  os_timer_disarm(&timer);
+}
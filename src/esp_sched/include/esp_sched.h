@@ -0,0 +1,157 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef ESP_SCHED_H
+#define ESP_SCHED_H
+
+#include <c_types.h>
+
+// Scheduler tick in milliseconds.
+#ifndef ESP_SCHED_TICK_MS
+  #define ESP_SCHED_TICK_MS 10
+#endif
+
+// Maximum time exclusive job waits for radio idle in milliseconds.
+#ifndef ESP_SCHED_MAX_DEFER_MS
+  #define ESP_SCHED_MAX_DEFER_MS 100
+#endif
+
+// Maximum job period in milliseconds. Job run times are compared
+// as signed 32 bit microsecond differences.
+#define ESP_SCHED_MAX_PERIOD_MS 1800000
+
+// Job callback.
+//
+// Returns true when the job continues asynchronously
+// and will call esp_sched_done when finished.
+typedef bool (esp_sched_cb)(void *arg);
+
+// Radio idle predicate. Returns true when radio is idle.
+typedef bool (esp_sched_idle_cb)(void);
+
+// Scheduled job.
+typedef struct esp_sched_job {
+  esp_sched_cb *cb;       // The job callback.
+  void *arg;              // The callback argument.
+  uint32_t period_ms;     // The job period in milliseconds.
+  uint8_t prio;           // The job priority. Lower value runs first.
+  bool exclusive;         // Timing critical (bit-banged) bus transaction.
+  bool busy;              // Is true when job is running.
+  bool freed;             // Is true when freed while running.
+  uint32_t next_us;       // Next run time. Uses system_get_time().
+
+  // Statistics.
+  uint32_t runs;          // Number of runs.
+  uint32_t missed;        // Number of skipped periods.
+  uint32_t jitter_max_us; // Maximum start delay.
+  uint32_t jitter_sum_us; // Sum of start delays. Divide by runs for average.
+
+  struct esp_sched_job *next;
+} esp_sched_job;
+
+
+/**
+ * Create new job.
+ *
+ * The job is not scheduled until passed to esp_sched_add.
+ *
+ * @param cb        The job callback.
+ * @param arg       The callback argument.
+ * @param period_ms The job period in milliseconds (1 to ESP_SCHED_MAX_PERIOD_MS).
+ * @param prio      The job priority. Lower value runs first.
+ * @param exclusive Set to true for timing critical bus transactions.
+ *
+ * @return The job or NULL on error or invalid period.
+ */
+esp_sched_job *ICACHE_FLASH_ATTR
+esp_sched_new(esp_sched_cb *cb, void *arg, uint32_t period_ms, uint8_t prio, bool exclusive);
+
+/**
+ * Add job to the scheduler.
+ *
+ * The job runs on the next scheduler tick.
+ *
+ * @param job The job.
+ */
+void ICACHE_FLASH_ATTR
+esp_sched_add(esp_sched_job *job);
+
+/**
+ * Delay the next run of the job.
+ *
+ * For example to give a sensor time to wake up after esp_sched_add.
+ *
+ * @param job The job.
+ * @param ms  The delay in milliseconds (up to ESP_SCHED_MAX_PERIOD_MS).
+ *
+ * @return Returns false when delay is too long.
+ */
+bool ICACHE_FLASH_ATTR
+esp_sched_delay(esp_sched_job *job, uint32_t ms);
+
+/**
+ * Remove job from the scheduler and release it.
+ *
+ * Must not be called from the job callback. Running asynchronous job
+ * is removed right away but released when it calls esp_sched_done.
+ *
+ * @param job The job.
+ */
+void ICACHE_FLASH_ATTR
+esp_sched_free(esp_sched_job *job);
+
+/**
+ * Mark asynchronous job as finished.
+ *
+ * @param job The job.
+ */
+void ICACHE_FLASH_ATTR
+esp_sched_done(esp_sched_job *job);
+
+/**
+ * Set radio idle predicate.
+ *
+ * Exclusive jobs are deferred while the radio is busy but no longer
+ * then ESP_SCHED_MAX_DEFER_MS.
+ *
+ * @param cb The predicate or NULL.
+ */
+void ICACHE_FLASH_ATTR
+esp_sched_set_idle_cb(esp_sched_idle_cb *cb);
+
+/**
+ * Reset job statistics.
+ *
+ * @param job The job.
+ */
+void ICACHE_FLASH_ATTR
+esp_sched_reset_stats(esp_sched_job *job);
+
+/**
+ * Start the scheduler.
+ */
+void ICACHE_FLASH_ATTR
+esp_sched_start();
+
+/**
+ * Stop the scheduler.
+ *
+ * Running asynchronous jobs are not interrupted.
+ */
+void ICACHE_FLASH_ATTR
+esp_sched_stop();
+
+#endif //ESP_SCHED_H
@@ -30,6 +30,12 @@ find_path(esp_sht21_INCLUDE_DIR esp_sht21.h)
 find_library(esp_sht21_LIBRARY NAMES esp_sht21)
 
 find_package(esp_i2c REQUIRED)
+find_package(esp_eb REQUIRED)
+find_package(esp_tim REQUIRED)
+find_package(esp_crc REQUIRED)
+find_package(esp_ring REQUIRED)
+find_package(esp_stats REQUIRED)
+find_package(esp_conv REQUIRED)
 
 include(FindPackageHandleStandardArgs)
 FIND_PACKAGE_HANDLE_STANDARD_ARGS(esp_sht21
@@ -39,8 +45,20 @@ FIND_PACKAGE_HANDLE_STANDARD_ARGS(esp_sht21
 
 set(esp_sht21_INCLUDE_DIRS
     ${esp_sht21_INCLUDE_DIR}
-    ${esp_i2c_INCLUDE_DIRS})
+    ${esp_i2c_INCLUDE_DIRS}
+    ${esp_eb_INCLUDE_DIRS}
+    ${esp_tim_INCLUDE_DIRS}
+    ${esp_crc_INCLUDE_DIRS}
+    ${esp_ring_INCLUDE_DIRS}
+    ${esp_stats_INCLUDE_DIRS}
+    ${esp_conv_INCLUDE_DIRS})
 
 set(esp_sht21_LIBRARIES
     ${esp_sht21_LIBRARY}
-    ${esp_i2c_LIBRARIES})
+    ${esp_i2c_LIBRARIES}
+    ${esp_eb_LIBRARIES}
+    ${esp_tim_LIBRARIES}
+    ${esp_crc_LIBRARIES}
+    ${esp_ring_LIBRARIES}
+    ${esp_stats_LIBRARIES}
+    ${esp_conv_LIBRARIES})
@@ -15,127 +15,528 @@
  */
 
 #include <esp_sht21.h>
+#include <esp_crc.h>
+#include <esp_conv.h>
+#include <esp_tim.h>
+#include <esp_eb.h>
+#include <mem.h>
+#include <osapi.h>
+#include <user_interface.h>
 
-static uint8_t ICACHE_FLASH_ATTR
-calc_crc(uint8_t init, const uint8_t *data, uint8_t len)
-{
-  uint8_t idx;
-  uint8_t bit;
-
-  // Calculates 8 bit checksum with polynomial 0x131 (10011001).
-  for (idx = 0; idx < len; idx++) {
-    init ^= (data[idx]);
-    for (bit = 0; bit < 8; bit++) {
-      if (init & 0x80) init = (uint8_t) ((init << 1) ^ 0x131);
-      else init = (init << 1);
-    }
-  }
+// Maximum humidity conversion times in ms indexed by resolution.
+static const uint8_t rh_conv_ms[4] = {29, 4, 9, 15};
+// Maximum temperature conversion times in ms indexed by resolution.
+static const uint8_t temp_conv_ms[4] = {85, 22, 43, 11};
 
-  return init;
-}
+// Pins of currently initialized I2C bus.
+static uint8_t bus_scl = 0xFF;
+static uint8_t bus_sda = 0xFF;
+
+// The device with active I2C mux channel.
+static esp_sht21_dev *selected;
+
+// Sample ring.
+static esp_ring *ring;
 
 esp_i2c_err ICACHE_FLASH_ATTR
 esp_sht21_init(uint8_t gpio_scl, uint8_t gpio_sda)
 {
+  bus_scl = gpio_scl;
+  bus_sda = gpio_sda;
+  selected = NULL;
+
   return esp_i2c_init(gpio_scl, gpio_sda);
 }
 
-static float ICACHE_FLASH_ATTR
-calc_rh(const uint8_t *data)
+esp_sht21_dev *ICACHE_FLASH_ATTR
+esp_sht21_new_dev(uint8_t gpio_scl, uint8_t gpio_sda, uint8_t address)
 {
-  float hu;
-  hu = (float) (125.0 / 65536.0);
-  hu = hu * (((data[0] << 8) | data[1]) & ~0x3);
+  esp_sht21_dev *dev = os_zalloc(sizeof(esp_sht21_dev));
+  if (dev == NULL) return NULL;
+
+  dev->gpio_scl = gpio_scl;
+  dev->gpio_sda = gpio_sda;
+  dev->address = address;
+  dev->mux_ch = -1;
+  dev->meas.retries = -1;
 
-  return hu - 6;
+  return dev;
 }
 
-static float ICACHE_FLASH_ATTR
-calc_temp(const uint8_t *data)
+void ICACHE_FLASH_ATTR
+esp_sht21_set_mux(esp_sht21_dev *dev, uint8_t mux_addr, int8_t mux_ch)
 {
-  float temp;
-  temp = (float) (175.72 / 65536.0);
-  temp = temp * (((data[0] << 8) | data[1]) & ~0x3);
-
-  return (float) (temp - 46.85);
+  dev->mux_addr = mux_addr;
+  dev->mux_ch = mux_ch;
+  if (selected == dev) selected = NULL;
 }
 
-esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_rh(float *humidity)
+/**
+ * Select device for communication.
+ *
+ * Initializes I2C on device pins and switches I2C mux channel
+ * but only when needed.
+ *
+ * @param dev The device.
+ *
+ * @return The I2C error code.
+ */
+static esp_i2c_err ICACHE_FLASH_ATTR
+select_dev(esp_sht21_dev *dev)
 {
   esp_i2c_err err;
-  uint8_t data[3];
+  uint8_t ch;
 
-  *humidity = ESP_SHT21_BAD_RH;
+  if (dev->gpio_scl != bus_scl || dev->gpio_sda != bus_sda) {
+    err = esp_sht21_init(dev->gpio_scl, dev->gpio_sda);
+    if (err != ESP_I2C_OK) return err;
+  }
+
+  if (dev->mux_ch < 0 || selected == dev) return ESP_I2C_OK;
 
-  err = esp_i2c_start_read(ESP_SHT21_ADDRESS, ESP_SHT21_RH_HM);
+  selected = NULL;
+  ch = (uint8_t) (1 << dev->mux_ch);
+
+  err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(dev->mux_addr), true);
   if (err != ESP_I2C_OK) return err;
 
-  err = esp_i2c_read_bytes(data, 3);
+  err = esp_i2c_write_bytes(&ch, 1);
   if (err != ESP_I2C_OK) return err;
 
   err = esp_i2c_stop();
+  if (err == ESP_I2C_OK) selected = dev;
 
-  if (calc_crc(0x0, data, 2) == data[2]) {
-    *humidity = calc_rh(data);
-  } else if (err == ESP_I2C_OK) {
+  return err;
+}
+
+static float ICACHE_FLASH_ATTR
+calc_rh(const uint8_t *data)
+{
+  return esp_conv_sht21_rh_f(esp_conv_sht21_word(data));
+}
+
+static float ICACHE_FLASH_ATTR
+calc_temp(const uint8_t *data)
+{
+  return esp_conv_sht21_temp_f(esp_conv_sht21_word(data));
+}
+
+/**
+ * Finish measurement. Update statistics and add result to the sample ring.
+ *
+ * @param dev  The device.
+ * @param cmd  The measurement command.
+ * @param err  The I2C error code.
+ * @param data The 2 bytes read from the device or NULL on error.
+ */
+static void ICACHE_FLASH_ATTR
+read_done(esp_sht21_dev *dev, uint8_t cmd, esp_i2c_err err, const uint8_t *data)
+{
+  uint8_t type = ESP_RING_SHT21_TEMP;
+  uint16_t raw = 0;
+
+  ESP_STATS_INC(dev->stats.reads);
+  if (err == ESP_I2C_ERR_DATA_CORRUPTED) {
+    ESP_STATS_INC(dev->stats.crc_errs);
+  } else if (err != ESP_I2C_OK) {
+    ESP_STATS_INC(dev->stats.i2c_errs);
+  }
+
+  if (ring == NULL) return;
+
+  if (cmd == ESP_SHT21_RH_HM || cmd == ESP_SHT21_RH_NHM) type = ESP_RING_SHT21_RH;
+  if (err == ESP_I2C_OK && data != NULL) raw = (uint16_t) (((data[0] << 8) | data[1]) & ~0x3);
+
+  esp_ring_push(ring, dev->id, type, (uint8_t) err, raw);
+}
+
+/**
+ * Read measurement in Hold Master mode.
+ *
+ * @param dev  The device.
+ * @param cmd  The measurement command.
+ * @param data The measurement buffer.
+ * @param len  The number of bytes to read. When 3 the CRC is validated.
+ *
+ * @return The I2C error code.
+ */
+static esp_i2c_err ICACHE_FLASH_ATTR
+read_meas(esp_sht21_dev *dev, uint8_t cmd, uint8_t *data, uint8_t len)
+{
+  esp_i2c_err err;
+  ESP_STATS_START(start);
+
+  err = select_dev(dev);
+  if (err == ESP_I2C_OK) err = esp_i2c_start_read(dev->address, cmd);
+  if (err == ESP_I2C_OK) err = esp_i2c_read_bytes(data, len);
+  if (err == ESP_I2C_OK) err = esp_i2c_stop();
+  ESP_STATS_HIST(dev->stats.xfer, start);
+
+  if (err == ESP_I2C_OK && len == 3 && esp_crc8_sht(0x0, data, 2) != data[2]) {
     err = ESP_I2C_ERR_DATA_CORRUPTED;
   }
 
+  read_done(dev, cmd, err, data);
+
+  return err;
+}
+
+esp_i2c_err ICACHE_FLASH_ATTR
+esp_sht21_get_rh(esp_sht21_dev *dev, float *humidity)
+{
+  uint8_t data[3];
+  esp_i2c_err err = read_meas(dev, ESP_SHT21_RH_HM, data, 3);
+
+  *humidity = err == ESP_I2C_OK ? calc_rh(data) : ESP_SHT21_BAD_RH;
+
   return err;
 }
 
 /**
  * Get temperature.
  *
+ * @param dev  The device.
  * @param temp The temperature.
  * @param cmd  The temperature command.
  *
  * @return The I2C error code.
  */
 static esp_i2c_err ICACHE_FLASH_ATTR
-get_temp(float *temp, uint8_t cmd)
+get_temp(esp_sht21_dev *dev, float *temp, uint8_t cmd)
 {
-  esp_i2c_err err;
   uint8_t data[3];
+  esp_i2c_err err;
 
   // When getting temperature from previous humidity measurement
   // the CRC checksum is not available.
-  uint8_t data_len = (uint8_t) (cmd == ESP_SHT21_TEMP_HM ? 3 : 2);
+  err = read_meas(dev, cmd, data, (uint8_t) (cmd == ESP_SHT21_TEMP_HM ? 3 : 2));
 
-  *temp = ESP_SHT21_BAD_TEMP;
+  *temp = err == ESP_I2C_OK ? calc_temp(data) : ESP_SHT21_BAD_TEMP;
 
-  err = esp_i2c_start_read(ESP_SHT21_ADDRESS, cmd);
-  if (err != ESP_I2C_OK) return err;
+  return err;
+}
 
-  err = esp_i2c_read_bytes(data, data_len);
-  if (err != ESP_I2C_OK) return err;
+esp_i2c_err ICACHE_FLASH_ATTR
+esp_sht21_get_temp(esp_sht21_dev *dev, float *temp)
+{
+  return get_temp(dev, temp, ESP_SHT21_TEMP_HM);
+}
 
-  err = esp_i2c_stop();
+esp_i2c_err ICACHE_FLASH_ATTR
+esp_sht21_get_temp_last(esp_sht21_dev *dev, float *temp)
+{
+  return get_temp(dev, temp, ESP_SHT21_TEMP_LAST);
+}
 
-  if (data_len == 2 || calc_crc(0x0, data, 2) == data[2]) {
-    *temp = calc_temp(data);
-  } else if (err == ESP_I2C_OK) {
+esp_i2c_err ICACHE_FLASH_ATTR
+esp_sht21_sample(esp_sht21_dev *dev, esp_sht21_smpl *smpl)
+{
+  uint8_t rh[3];
+  uint8_t temp[2];
+  uint8_t cmd = ESP_SHT21_TEMP_LAST;
+  esp_i2c_err err;
+  ESP_STATS_START(start);
+
+  smpl->rh = ESP_SHT21_BAD_RH;
+  smpl->temp = ESP_SHT21_BAD_TEMP;
+  smpl->rh_raw = 0;
+  smpl->temp_raw = 0;
+  smpl->crc_ok = false;
+  smpl->time = system_get_time();
+
+  // Humidity measurement, device measures temperature as well.
+  err = select_dev(dev);
+  if (err == ESP_I2C_OK) err = esp_i2c_start_read(dev->address, ESP_SHT21_RH_HM);
+  if (err == ESP_I2C_OK) err = esp_i2c_read_bytes(rh, 3);
+
+  // Repeated start instead of stop and start keeps it one transaction.
+  if (err == ESP_I2C_OK) err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(dev->address), true);
+  if (err == ESP_I2C_OK) err = esp_i2c_write_bytes(&cmd, 1);
+  if (err == ESP_I2C_OK) err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(dev->address), true);
+  if (err == ESP_I2C_OK) err = esp_i2c_read_bytes(temp, 2);
+  if (err == ESP_I2C_OK) err = esp_i2c_stop();
+  ESP_STATS_HIST(dev->stats.xfer, start);
+
+  // Temperature has no CRC, it's trusted only with valid humidity.
+  if (err == ESP_I2C_OK && esp_crc8_sht(0x0, rh, 2) != rh[2]) {
     err = ESP_I2C_ERR_DATA_CORRUPTED;
   }
 
-  return err;
+  read_done(dev, ESP_SHT21_RH_HM, err, rh);
+  read_done(dev, ESP_SHT21_TEMP_LAST, err, temp);
+  if (err != ESP_I2C_OK) return err;
+
+  smpl->crc_ok = true;
+  smpl->rh_raw = (uint16_t) (((rh[0] << 8) | rh[1]) & ~0x3);
+  smpl->rh = calc_rh(rh);
+  smpl->temp_raw = (uint16_t) (((temp[0] << 8) | temp[1]) & ~0x3);
+  smpl->temp = calc_temp(temp);
+
+  return ESP_I2C_OK;
 }
 
-esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_temp(float *temp)
+/**
+ * Get maximum conversion time for the command and current resolution.
+ *
+ * @param dev The device.
+ * @param cmd The measurement command.
+ *
+ * @return The conversion time in milliseconds.
+ */
+static uint8_t ICACHE_FLASH_ATTR
+conv_time(esp_sht21_dev *dev, uint8_t cmd)
 {
-  return get_temp(temp, ESP_SHT21_TEMP_HM);
+  // Power-on default resolution is assumed until user register is read.
+  uint8_t res = ESP_SHT21_RES3;
+  uint8_t ur1 = dev->st.ur1;
+  if (dev->st.ur1_ok) res = (uint8_t) (((ur1 >> 6) & 0x2) | (ur1 & 0x1));
+
+  if (cmd == ESP_SHT21_RH_NHM) return rh_conv_ms[res];
+  return temp_conv_ms[res];
 }
 
-esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_temp_last(float *temp)
+/**
+ * Finish asynchronous measurement and trigger event.
+ *
+ * @param dev  The device.
+ * @param data The 3 bytes read from the device or NULL on error.
+ */
+static void ICACHE_FLASH_ATTR
+meas_done(esp_sht21_dev *dev, const uint8_t *data)
 {
-  return get_temp(temp, ESP_SHT21_TEMP_LAST);
+  esp_sht21_meas *meas = &dev->meas;
+
+  meas->retries = -1;
+
+  if (data != NULL && esp_crc8_sht(0x0, data, 2) != data[2]) {
+    if (meas->err == ESP_I2C_OK) meas->err = ESP_I2C_ERR_DATA_CORRUPTED;
+  }
+
+  read_done(dev, meas->cmd, meas->err, data);
+
+  if (data == NULL || meas->err != ESP_I2C_OK) {
+    meas->value = meas->cmd == ESP_SHT21_RH_NHM ? ESP_SHT21_BAD_RH : ESP_SHT21_BAD_TEMP;
+    esp_eb_trigger(ESP_SHT21_EV_ERROR, dev);
+    return;
+  }
+
+  meas->raw = (uint16_t) (((data[0] << 8) | data[1]) & ~0x3);
+  if (meas->cmd == ESP_SHT21_RH_NHM) {
+    meas->value = calc_rh(data);
+  } else {
+    meas->value = calc_temp(data);
+  }
+
+  esp_eb_trigger(ESP_SHT21_EV_READY, dev);
+}
+
+/**
+ * Poll device for the end of asynchronous measurement.
+ *
+ * Must be called every ESP_SHT21_POLL_MS.
+ *
+ * @param dev The device.
+ *
+ * @return Returns true when measurement finished, false otherwise.
+ */
+static bool ICACHE_FLASH_ATTR
+meas_poll(esp_sht21_dev *dev)
+{
+  uint8_t data[3];
+  esp_sht21_meas *meas = &dev->meas;
+  uint8_t ms = conv_time(dev, meas->cmd);
+  uint16_t elapsed = (uint16_t) (++meas->retries * ESP_SHT21_POLL_MS);
+
+  // Conversion never finishes before half of the maximum time.
+  if (elapsed < ms / 2) return false;
+
+  // Device does not acknowledge read until conversion is done.
+  ESP_STATS_INC(dev->stats.polls);
+  meas->err = select_dev(dev);
+  ESP_STATS_START(poll);
+  if (meas->err == ESP_I2C_OK) {
+    meas->err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(dev->address), true);
+  }
+
+  if (meas->err != ESP_I2C_OK) {
+    esp_i2c_stop();
+    ESP_STATS_HIST(dev->stats.poll, poll);
+
+    // Poll until maximum conversion time plus 10% margin elapses.
+    if (elapsed <= ms + ms / 10) return false;
+
+    ESP_STATS_INC(dev->stats.timeouts);
+    meas_done(dev, NULL);
+    return true;
+  }
+
+  ESP_STATS_HIST(dev->stats.poll, poll);
+  ESP_STATS_START(start);
+  meas->err = esp_i2c_read_bytes(data, 3);
+  if (meas->err == ESP_I2C_OK) meas->err = esp_i2c_stop();
+  ESP_STATS_HIST(dev->stats.xfer, start);
+
+  meas_done(dev, meas->err == ESP_I2C_OK ? data : NULL);
+
+  return true;
+}
+
+/**
+ * Start asynchronous measurement.
+ *
+ * @param dev The device.
+ * @param cmd The No Hold Master measurement command.
+ *
+ * @return Returns true on success, false otherwise.
+ */
+static bool ICACHE_FLASH_ATTR
+meas_start(esp_sht21_dev *dev, uint8_t cmd)
+{
+  esp_sht21_meas *meas = &dev->meas;
+
+  if (meas->retries >= 0) return false;
+
+  meas->cmd = cmd;
+  meas->err = select_dev(dev);
+  if (meas->err != ESP_I2C_OK) return false;
+
+  meas->err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(dev->address), true);
+  if (meas->err != ESP_I2C_OK) return false;
+
+  meas->err = esp_i2c_write_bytes(&cmd, 1);
+  if (meas->err != ESP_I2C_OK) return false;
+
+  // Release the bus while device converts.
+  meas->err = esp_i2c_stop();
+  if (meas->err != ESP_I2C_OK) return false;
+
+  meas->retries = 0;
+
+  return true;
+}
+
+static void ICACHE_FLASH_ATTR
+meas_timer(void *arg)
+{
+  esp_tim_timer *timer = arg;
+
+  if (meas_poll(timer->payload) == false) esp_tim_continue(timer);
+}
+
+/**
+ * Start asynchronous measurement with its own timer.
+ *
+ * @param dev The device.
+ * @param cmd The No Hold Master measurement command.
+ *
+ * @return Returns true on success, false otherwise.
+ */
+static bool ICACHE_FLASH_ATTR
+meas_async(esp_sht21_dev *dev, uint8_t cmd)
+{
+  if (meas_start(dev, cmd) == false) return false;
+  if (esp_tim_start_delay(meas_timer, dev, ESP_SHT21_POLL_MS)) return true;
+
+  dev->meas.retries = -1;
+
+  return false;
+}
+
+bool ICACHE_FLASH_ATTR
+esp_sht21_get_rh_async(esp_sht21_dev *dev)
+{
+  return meas_async(dev, ESP_SHT21_RH_NHM);
+}
+
+bool ICACHE_FLASH_ATTR
+esp_sht21_get_temp_async(esp_sht21_dev *dev)
+{
+  return meas_async(dev, ESP_SHT21_TEMP_NHM);
+}
+
+static void ICACHE_FLASH_ATTR
+rr_timer(void *arg)
+{
+  uint8_t idx;
+  esp_sht21_dev *dev;
+  esp_tim_timer *timer = arg;
+  esp_sht21_rr *rr = timer->payload;
+
+  // Read devices in the order they finish conversion.
+  for (idx = 0; idx < rr->dev_cnt; idx++) {
+    if ((rr->started & BIT(idx)) == 0) continue;
+
+    dev = rr->devs[idx];
+    if (meas_poll(dev)) {
+      rr->started &= ~BIT(idx);
+      rr->busy--;
+    }
+  }
+
+  if (rr->busy > 0) {
+    esp_tim_continue(timer);
+    return;
+  }
+
+  esp_eb_trigger(ESP_SHT21_EV_RR_DONE, rr);
+}
+
+esp_sht21_rr *ICACHE_FLASH_ATTR
+esp_sht21_rr_new(esp_sht21_dev **devs, uint8_t dev_cnt)
+{
+  esp_sht21_rr *rr;
+
+  if (dev_cnt > ESP_SHT21_RR_MAX) return NULL;
+
+  rr = os_zalloc(sizeof(esp_sht21_rr) + dev_cnt * sizeof(esp_sht21_dev *));
+  if (rr == NULL) return NULL;
+
+  rr->devs = (esp_sht21_dev **) (rr + 1);
+  rr->dev_cnt = dev_cnt;
+  memcpy(rr->devs, devs, dev_cnt * sizeof(esp_sht21_dev *));
+
+  return rr;
+}
+
+bool ICACHE_FLASH_ATTR
+esp_sht21_rr_start(esp_sht21_rr *rr, uint8_t cmd)
+{
+  uint8_t idx;
+  esp_sht21_dev *dev;
+
+  if (rr->busy > 0) return false;
+
+  rr->started = 0;
+
+  // Start conversions on all devices, each one converts on its own.
+  for (idx = 0; idx < rr->dev_cnt; idx++) {
+    dev = rr->devs[idx];
+
+    // Device busy with its own measurement is not ours to poll.
+    if (dev->meas.retries >= 0) continue;
+
+    if (meas_start(dev, cmd)) {
+      rr->started |= BIT(idx);
+      rr->busy++;
+    } else {
+      esp_eb_trigger(ESP_SHT21_EV_ERROR, dev);
+    }
+  }
+
+  if (rr->busy == 0) return false;
+  if (esp_tim_start_delay(rr_timer, rr, ESP_SHT21_POLL_MS)) return true;
+
+  for (idx = 0; idx < rr->dev_cnt; idx++) {
+    if (rr->started & BIT(idx)) rr->devs[idx]->meas.retries = -1;
+  }
+  rr->started = 0;
+  rr->busy = 0;
+
+  return false;
 }
 
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_sn(uint8_t *sn)
+esp_sht21_get_sn(esp_sht21_dev *dev, uint8_t *sn)
 {
   uint8_t idx;
   esp_i2c_err err;
@@ -145,13 +546,16 @@ esp_sht21_get_sn(uint8_t *sn)
   uint8_t cmd2[2] = {0xFC, 0xC9};
   uint8_t data[14];
 
-  err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(ESP_SHT21_ADDRESS), true);
+  err = select_dev(dev);
+  if (err != ESP_I2C_OK) return err;
+
+  err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(dev->address), true);
   if (err != ESP_I2C_OK) return err;
 
   err = esp_i2c_write_bytes(cmd1, 2);
   if (err != ESP_I2C_OK) return err;
 
-  err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(ESP_SHT21_ADDRESS), true);
+  err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(dev->address), true);
   if (err != ESP_I2C_OK) return err;
 
   err = esp_i2c_read_bytes(data, 8);
@@ -160,13 +564,13 @@ esp_sht21_get_sn(uint8_t *sn)
   err = esp_i2c_stop();
   if (err != ESP_I2C_OK) return err;
 
-  err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(ESP_SHT21_ADDRESS), true);
+  err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(dev->address), true);
   if (err != ESP_I2C_OK) return err;
 
   err = esp_i2c_write_bytes(cmd2, 2);
   if (err != ESP_I2C_OK) return err;
 
-  err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(ESP_SHT21_ADDRESS), true);
+  err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(dev->address), true);
   if (err != ESP_I2C_OK) return err;
 
   err = esp_i2c_read_bytes((data + 8), 6);
@@ -177,7 +581,7 @@ esp_sht21_get_sn(uint8_t *sn)
   // Validate data.
   crc = 0x0;
   for (idx = 0; idx < 8; idx += 2) {
-    crc = calc_crc(crc, &data[idx], 1);
+    crc = esp_crc8_sht(crc, &data[idx], 1);
     if (data[idx + 1] != crc) {
       return ESP_I2C_ERR_DATA_CORRUPTED;
     }
@@ -186,7 +590,7 @@ esp_sht21_get_sn(uint8_t *sn)
 
   crc = 0x0;
   for (idx = 8; idx < 14; idx += 3) {
-    crc = calc_crc(crc, &data[idx], 2);
+    crc = esp_crc8_sht(crc, &data[idx], 2);
     if (data[idx + 2] != crc) {
       return ESP_I2C_ERR_DATA_CORRUPTED;
     }
@@ -198,18 +602,21 @@ esp_sht21_get_sn(uint8_t *sn)
 }
 
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_rev(uint8_t *rev)
+esp_sht21_get_rev(esp_sht21_dev *dev, uint8_t *rev)
 {
   esp_i2c_err err;
   uint8_t cmd[2] = {0x84, 0xB8};
 
-  err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(ESP_SHT21_ADDRESS), true);
+  err = select_dev(dev);
+  if (err != ESP_I2C_OK) return err;
+
+  err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(dev->address), true);
   if (err != ESP_I2C_OK) return err;
 
   err = esp_i2c_write_bytes(cmd, 2);
   if (err != ESP_I2C_OK) return err;
 
-  err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(ESP_SHT21_ADDRESS), true);
+  err = esp_i2c_start_read_write(ESP_I2C_ADDR_READ(dev->address), true);
   if (err != ESP_I2C_OK) return err;
 
   err = esp_i2c_read_bytes(rev, 1);
@@ -247,13 +654,106 @@ register_set(uint8_t address, uint8_t reg_adr, uint8_t value)
   return esp_i2c_stop();
 }
 
+/**
+ * Get register value using its shadow.
+ *
+ * The device is read only when the shadow is not valid.
+ *
+ * @param dev     The device.
+ * @param reg_adr The register read command.
+ * @param reg     The register value.
+ *
+ * @return The I2C error code.
+ */
+static esp_i2c_err ICACHE_FLASH_ATTR
+shadow_get(esp_sht21_dev *dev, uint8_t reg_adr, uint8_t *reg)
+{
+  esp_i2c_err err;
+  bool is_ur1 = reg_adr == ESP_SHT21_UR1_READ;
+  uint8_t *shadow = is_ur1 ? &dev->st.ur1 : &dev->st.hcr;
+  bool *valid = is_ur1 ? &dev->st.ur1_ok : &dev->st.hcr_ok;
+
+  if (*valid == false) {
+    err = select_dev(dev);
+    if (err != ESP_I2C_OK) return err;
+
+    ESP_STATS_START(start);
+    err = register_get(dev->address, reg_adr, shadow);
+    ESP_STATS_HIST(dev->stats.reg, start);
+    if (err != ESP_I2C_OK) return err;
+    *valid = true;
+  }
+
+  *reg = *shadow;
+
+  return ESP_I2C_OK;
+}
+
+/**
+ * Set register value and its shadow.
+ *
+ * The device is written only when the value changes.
+ *
+ * @param dev     The device.
+ * @param reg_adr The register read command.
+ * @param value   The register value.
+ *
+ * @return The I2C error code.
+ */
+static esp_i2c_err ICACHE_FLASH_ATTR
+shadow_set(esp_sht21_dev *dev, uint8_t reg_adr, uint8_t value)
+{
+  esp_i2c_err err;
+  bool is_ur1 = reg_adr == ESP_SHT21_UR1_READ;
+  uint8_t *shadow = is_ur1 ? &dev->st.ur1 : &dev->st.hcr;
+  bool *valid = is_ur1 ? &dev->st.ur1_ok : &dev->st.hcr_ok;
+
+  if (*valid && *shadow == value) return ESP_I2C_OK;
+
+  err = select_dev(dev);
+  if (err == ESP_I2C_OK) {
+    ESP_STATS_START(start);
+    err = register_set(dev->address,
+                       (uint8_t) (is_ur1 ? ESP_SHT21_UR1_WRITE : ESP_SHT21_HCR_WRITE),
+                       value);
+    ESP_STATS_HIST(dev->stats.reg, start);
+  }
+
+  // We don't know what the device has after failed write.
+  *valid = err == ESP_I2C_OK;
+  *shadow = value;
+
+  return err;
+}
+
+void ICACHE_FLASH_ATTR
+esp_sht21_invalidate(esp_sht21_dev *dev)
+{
+  dev->st.ur1_ok = false;
+  dev->st.hcr_ok = false;
+}
+
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_res_get(uint8_t *res)
+esp_sht21_refresh(esp_sht21_dev *dev)
+{
+  esp_i2c_err err;
+  uint8_t reg;
+
+  esp_sht21_invalidate(dev);
+
+  err = shadow_get(dev, ESP_SHT21_UR1_READ, &reg);
+  if (err != ESP_I2C_OK) return err;
+
+  return shadow_get(dev, ESP_SHT21_HCR_READ, &reg);
+}
+
+esp_i2c_err ICACHE_FLASH_ATTR
+esp_sht21_res_get(esp_sht21_dev *dev, uint8_t *res)
 {
   esp_i2c_err err;
   uint8_t reg1 = 0;
 
-  err = register_get(ESP_SHT21_ADDRESS, ESP_SHT21_UR1_READ, &reg1);
+  err = shadow_get(dev, ESP_SHT21_UR1_READ, &reg1);
   if (err != ESP_I2C_OK) return err;
 
   *res = (uint8_t) (((reg1 >> 6) & 0x2) | (reg1 & 0x1));
@@ -262,12 +762,12 @@ esp_sht21_res_get(uint8_t *res)
 }
 
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_res_set(uint8_t res)
+esp_sht21_res_set(esp_sht21_dev *dev, uint8_t res)
 {
   esp_i2c_err err;
   uint8_t reg1 = 0;
 
-  err = register_get(ESP_SHT21_ADDRESS, ESP_SHT21_UR1_READ, &reg1);
+  err = shadow_get(dev, ESP_SHT21_UR1_READ, &reg1);
   if (err != ESP_I2C_OK) return err;
 
   // Clear bits 7 and 0
@@ -275,19 +775,19 @@ esp_sht21_res_set(uint8_t res)
   // Logical or after some bit manipulation.
   reg1 |= ((((res & 0x3) != 0) << 7) | ((res & 0x1) != 0));
 
-  return register_set(ESP_SHT21_ADDRESS, ESP_SHT21_UR1_WRITE, reg1);
+  return shadow_set(dev, ESP_SHT21_UR1_READ, reg1);
 }
 
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_heater_get(bool *on_off, uint8_t *level)
+esp_sht21_heater_get(esp_sht21_dev *dev, bool *on_off, uint8_t *level)
 {
   esp_i2c_err err;
   uint8_t reg1 = 0;
   uint8_t hcr = 0;
 
-  err = register_get(ESP_SHT21_ADDRESS, ESP_SHT21_UR1_READ, &reg1);
+  err = shadow_get(dev, ESP_SHT21_UR1_READ, &reg1);
   if (err != ESP_I2C_OK) return err;
-  err = register_get(ESP_SHT21_ADDRESS, ESP_SHT21_HCR_READ, &hcr);
+  err = shadow_get(dev, ESP_SHT21_HCR_READ, &hcr);
   if (err != ESP_I2C_OK) return err;
 
   *on_off = (reg1 & 0x4) != 0;
@@ -297,27 +797,36 @@ esp_sht21_heater_get(bool *on_off, uint8_t *level)
 }
 
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_heater_set(bool on_off, uint8_t level)
+esp_sht21_heater_set(esp_sht21_dev *dev, bool on_off, uint8_t level)
 {
   esp_i2c_err err;
   uint8_t reg1 = 0;
   uint8_t hcr = 0;
 
-  // Read both registers.
-  err = register_get(ESP_SHT21_ADDRESS, ESP_SHT21_UR1_READ, &reg1);
+  // Get both registers.
+  err = shadow_get(dev, ESP_SHT21_UR1_READ, &reg1);
   if (err != ESP_I2C_OK) return err;
-  err = register_get(ESP_SHT21_ADDRESS, ESP_SHT21_HCR_READ, &hcr);
+  err = shadow_get(dev, ESP_SHT21_HCR_READ, &hcr);
   if (err != ESP_I2C_OK) return err;
 
   // Write new values.
   reg1 = (uint8_t) (reg1 & 0xFB);
   reg1 = reg1 | (on_off << 2);
-  err = register_set(ESP_SHT21_ADDRESS, ESP_SHT21_UR1_WRITE, reg1);
+  err = shadow_set(dev, ESP_SHT21_UR1_READ, reg1);
   if (err != ESP_I2C_OK) return err;
 
   hcr = (uint8_t) ((hcr & 0xF0) | (level & 0x0F));
-  err = register_set(ESP_SHT21_ADDRESS, ESP_SHT21_HCR_WRITE, 0x0);
-  if (err != ESP_I2C_OK) return err;
 
-  return register_set(ESP_SHT21_ADDRESS, ESP_SHT21_HCR_WRITE, hcr);
+  return shadow_set(dev, ESP_SHT21_HCR_READ, hcr);
 }
+
+#ifdef ESP_DRV_STATS
+
+void ICACHE_FLASH_ATTR
+esp_sht21_stats_get(esp_sht21_dev *dev, esp_sht21_stats *stats, bool reset)
+{
+  os_memcpy(stats, &dev->stats, sizeof(esp_sht21_stats));
+  if (reset) os_memset(&dev->stats, 0, sizeof(esp_sht21_stats));
+}
+
+#endif
@@ -19,9 +19,13 @@
 #define ESP_SHT21_H
 
 #include <esp_i2c.h>
+#include <esp_ring.h>
+#include <esp_stats.h>
 #include <c_types.h>
 
 #define ESP_SHT21_ADDRESS 0x40
+// Default I2C mux (TCA9548A) address.
+#define ESP_SHT21_MUX_ADDRESS 0x70
 // Measure relative humidity. Hold Master Mode.
 #define ESP_SHT21_RH_HM 0xE5
 // Measure relative humidity. No Hold Master Mode.
@@ -46,6 +50,16 @@
 // Invalid temperature.
 #define ESP_SHT21_BAD_TEMP ((float)-273)
 
+// Asynchronous measurement ready.
+#define ESP_SHT21_EV_READY "sht21Ready"
+// Asynchronous measurement error.
+#define ESP_SHT21_EV_ERROR "sht21Error"
+// Round-robin measurement on all devices finished.
+#define ESP_SHT21_EV_RR_DONE "sht21RRDone"
+
+// Measurement ready poll interval in milliseconds.
+#define ESP_SHT21_POLL_MS 5
+
 // SHT21 humidity and temperature resolutions.
 // RH: 12bit TEMP: 14bit
 #define ESP_SHT21_RES3 0x0
@@ -56,6 +70,73 @@
 // RH: 11bit TEMP: 11bit
 #define ESP_SHT21_RES0 0x3
 
+// SHT21 register shadows.
+typedef struct {
+  uint8_t ur1; // User register 1.
+  uint8_t hcr; // Heater control register.
+  bool ur1_ok; // User register 1 shadow is valid.
+  bool hcr_ok; // Heater control register shadow is valid.
+} esp_sht21_st;
+
+// Humidity and temperature sample.
+typedef struct {
+  float rh;          // Relative humidity.
+  float temp;        // Temperature in Celsius.
+  uint16_t rh_raw;   // Raw humidity (status bits cleared).
+  uint16_t temp_raw; // Raw temperature (status bits cleared).
+  uint32_t time;     // Sample time. Uses system_get_time().
+  bool crc_ok;       // Humidity measurement CRC status.
+} esp_sht21_smpl;
+
+// Asynchronous measurement.
+typedef struct {
+  float value;     // The measured value.
+  uint16_t raw;    // The raw measurement (status bits cleared).
+  uint8_t cmd;     // ESP_SHT21_RH_NHM or ESP_SHT21_TEMP_NHM.
+  int8_t retries;  // Is greater then zero when measurement in progress.
+  esp_i2c_err err; // The I2C error code.
+} esp_sht21_meas;
+
+// SHT21 statistics (compiled in with ESP_DRV_STATS).
+//
+// The stats field changes esp_sht21_dev layout so ESP_DRV_STATS must be
+// defined for the driver and all the code using it (set it globally).
+typedef struct {
+  uint32_t reads;      // Number of finished measurements.
+  uint32_t crc_errs;   // Number of measurements with bad CRC.
+  uint32_t i2c_errs;   // Number of measurements failed on the bus.
+  uint32_t timeouts;   // Number of asynchronous measurements which never finished.
+  uint32_t polls;      // Number of asynchronous measurement polls.
+  esp_stats_hist xfer; // Measurement read transaction CPU cycles.
+  esp_stats_hist reg;  // User and heater register read or write transaction CPU cycles.
+  esp_stats_hist poll; // Asynchronous measurement poll (read header) CPU cycles.
+} esp_sht21_stats;
+
+// Structure representing SHT21 device.
+typedef struct {
+  uint8_t gpio_scl;    // The GPIO pin used for clock.
+  uint8_t gpio_sda;    // The GPIO pin used for data.
+  uint8_t address;     // The device I2C address.
+  uint8_t mux_addr;    // The I2C mux address.
+  int8_t mux_ch;       // The I2C mux channel or -1 when not behind mux.
+  uint8_t id;          // Sensor id for sample ring records.
+  esp_sht21_st st;     // Register shadows.
+  esp_sht21_meas meas; // Asynchronous measurement.
+#ifdef ESP_DRV_STATS
+  esp_sht21_stats stats;
+#endif
+} esp_sht21_dev;
+
+// Maximum number of devices in round-robin sampler.
+#define ESP_SHT21_RR_MAX 32
+
+// Round-robin sampler for many devices.
+typedef struct {
+  esp_sht21_dev **devs; // The array of devices.
+  uint8_t dev_cnt;      // The number of devices.
+  uint8_t busy;         // The number of devices with measurement in progress.
+  uint32_t started;     // Bit mask of devices started in current round.
+} esp_sht21_rr;
 
 /**
  * Initialize SHT21.
@@ -68,15 +149,50 @@
 esp_i2c_err ICACHE_FLASH_ATTR
 esp_sht21_init(uint8_t gpio_scl, uint8_t gpio_sda);
 
+/**
+ * Create SHT21 device.
+ *
+ * It's up to a caller to release the memory at some point.
+ *
+ * Devices may be on different I2C buses (pins). The driver initializes
+ * I2C on device pins when needed.
+ *
+ * All other esp_sht21_* functions take the device. The single device
+ * API without it is gone, see README.md for migration.
+ *
+ * @param gpio_scl The GPIO pin used for clock.
+ * @param gpio_sda The GPIO pin used for data.
+ * @param address  The device I2C address (ESP_SHT21_ADDRESS).
+ *
+ * @return The device or NULL on error.
+ */
+esp_sht21_dev *ICACHE_FLASH_ATTR
+esp_sht21_new_dev(uint8_t gpio_scl, uint8_t gpio_sda, uint8_t address);
+
+/**
+ * Set I2C mux channel the device is connected to.
+ *
+ * The mux channel is switched before talking to the device when needed.
+ *
+ * @param dev      The device.
+ * @param mux_addr The I2C mux address (ESP_SHT21_MUX_ADDRESS).
+ * @param mux_ch   The mux channel 0-7 or -1 when not behind mux.
+ */
+void ICACHE_FLASH_ATTR
+esp_sht21_set_mux(esp_sht21_dev *dev, uint8_t mux_addr, int8_t mux_ch);
+
 /**
  * Measure humidity.
  *
  * It takes approximately around 20ms to return the value.
  *
+ * @param dev      The device.
+ * @param humidity The measured humidity.
+ *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_rh(float *humidity);
+esp_sht21_get_rh(esp_sht21_dev *dev, float *humidity);
 
 /**
  * Measure temperature.
@@ -85,85 +201,220 @@ esp_sht21_get_rh(float *humidity);
  * function which will return temperature value from previous
  * humidity measurement.
  *
+ * @param dev  The device.
  * @param temp The measured temperature.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_temp(float *temp);
+esp_sht21_get_temp(esp_sht21_dev *dev, float *temp);
 
 /**
  * Get temperature from previous humidity measurement.
  *
  * This function is faster then esp_sht21_get_temp.
  *
+ * @param dev  The device.
  * @param temp The measured temperature.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_temp_last(float *temp);
+esp_sht21_get_temp_last(esp_sht21_dev *dev, float *temp);
+
+/**
+ * Measure humidity and temperature.
+ *
+ * Humidity is measured first and the temperature is read from the same
+ * measurement (ESP_SHT21_TEMP_LAST) after repeated start. It takes one
+ * I2C transaction where esp_sht21_get_rh followed by
+ * esp_sht21_get_temp_last takes two.
+ *
+ * On error values are set to ESP_SHT21_BAD_RH and ESP_SHT21_BAD_TEMP and
+ * raw values to zero. The temperature is not checksummed by the device so
+ * it's returned only when humidity CRC is valid.
+ *
+ * @param dev  The device.
+ * @param smpl The sample to set values on.
+ *
+ * @return The I2C error code.
+ */
+esp_i2c_err ICACHE_FLASH_ATTR
+esp_sht21_sample(esp_sht21_dev *dev, esp_sht21_smpl *smpl);
+
+/**
+ * Start asynchronous humidity measurement.
+ *
+ * Uses No Hold Master mode so the I2C bus and the CPU are free while
+ * the SHT21 converts. The device is polled for the end of conversion
+ * on a timer based on current resolution. When done ESP_SHT21_EV_READY
+ * or ESP_SHT21_EV_ERROR event is triggered with the device as the argument.
+ * The result is in device meas field.
+ *
+ * @param dev The device.
+ *
+ * @return Returns true on success, false otherwise.
+ */
+bool ICACHE_FLASH_ATTR
+esp_sht21_get_rh_async(esp_sht21_dev *dev);
+
+/**
+ * Start asynchronous temperature measurement.
+ *
+ * See esp_sht21_get_rh_async.
+ *
+ * @param dev The device.
+ *
+ * @return Returns true on success, false otherwise.
+ */
+bool ICACHE_FLASH_ATTR
+esp_sht21_get_temp_async(esp_sht21_dev *dev);
 
 /**
  * Get 64 bit unique SHT21 serial number.
  *
- * @param sn The pointer to 8 byte array.
+ * @param dev The device.
+ * @param sn  The pointer to 8 byte array.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_sn(uint8_t *sn);
+esp_sht21_get_sn(esp_sht21_dev *dev, uint8_t *sn);
 
 /**
  * Get firmware revision.
  *
+ * @param dev The device.
  * @param rev The revision to set.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_get_rev(uint8_t *rev);
+esp_sht21_get_rev(esp_sht21_dev *dev, uint8_t *rev);
+
+/**
+ * Invalidate register shadows.
+ *
+ * The user and heater registers are read from the device only once and
+ * then served from shadows. Call this function when device was reset.
+ *
+ * @param dev The device.
+ */
+void ICACHE_FLASH_ATTR
+esp_sht21_invalidate(esp_sht21_dev *dev);
+
+/**
+ * Read user and heater registers from the device into shadows.
+ *
+ * @param dev The device.
+ *
+ * @return The I2C error code.
+ */
+esp_i2c_err ICACHE_FLASH_ATTR
+esp_sht21_refresh(esp_sht21_dev *dev);
 
 /**
  * Get humidity and temperature measurement resolution.
  *
+ * @param dev The device.
  * @param res The measurement resolution. One of the ESP_SHT21_RES* defines.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_res_get(uint8_t *res);
+esp_sht21_res_get(esp_sht21_dev *dev, uint8_t *res);
 
 /**
  * Set SHT21 humidity and temperature measurement resolution.
  *
+ * @param dev The device.
  * @param res The resolution. One of the ESP_SHT21_RES* defines.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_res_set(uint8_t res);
+esp_sht21_res_set(esp_sht21_dev *dev, uint8_t res);
 
 /**
  * Get on-board heater status.
  *
+ * @param dev    The device.
  * @param on_off The on/off status.
  * @param level  The heater level value 0-15.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_heater_get(bool *on_off, uint8_t *level);
+esp_sht21_heater_get(esp_sht21_dev *dev, bool *on_off, uint8_t *level);
 
 /**
  * Set on-board heater status.
  *
+ * @param dev    The device.
  * @param on_off The on/off status.
  * @param level  The heater level value 0-15.
  *
  * @return The I2C error code.
  */
 esp_i2c_err ICACHE_FLASH_ATTR
-esp_sht21_heater_set(bool on_off, uint8_t level);
+esp_sht21_heater_set(esp_sht21_dev *dev, bool on_off, uint8_t level);
+
+/**
+ * Create round-robin sampler for many devices.
+ *
+ * It's up to a caller to release the memory at some point.
+ *
+ * @param devs    The array of devices.
+ * @param dev_cnt The number of devices. Up to ESP_SHT21_RR_MAX.
+ *
+ * @return The sampler or NULL on error.
+ */
+esp_sht21_rr *ICACHE_FLASH_ATTR
+esp_sht21_rr_new(esp_sht21_dev **devs, uint8_t dev_cnt);
+
+/**
+ * Start asynchronous measurement on all sampler devices.
+ *
+ * Measurements on all devices are started together and each device is
+ * read as soon as it finishes conversion while others keep converting.
+ * Every started device triggers ESP_SHT21_EV_READY or ESP_SHT21_EV_ERROR
+ * event and ESP_SHT21_EV_RR_DONE is triggered with the sampler at the end.
+ *
+ * Devices with their own asynchronous measurement in progress are skipped
+ * in this round. Devices which failed to start trigger ESP_SHT21_EV_ERROR.
+ *
+ * @param rr  The sampler.
+ * @param cmd The ESP_SHT21_RH_NHM or ESP_SHT21_TEMP_NHM.
+ *
+ * @return Returns true on success, false otherwise.
+ */
+bool ICACHE_FLASH_ATTR
+esp_sht21_rr_start(esp_sht21_rr *rr, uint8_t cmd);
+
+#ifdef ESP_DRV_STATS
+
+/**
+ * Get device statistics.
+ *
+ * @param dev   The device.
+ * @param stats The statistics snapshot.
+ * @param reset Reset statistics after taking the snapshot.
+ */
+void ICACHE_FLASH_ATTR
+esp_sht21_stats_get(esp_sht21_dev *dev, esp_sht21_stats *stats, bool reset);
+
+#endif
+
+/**
+ * Set sample ring.
+ *
+ * Every humidity and temperature measurement (successful or not) is added
+ * to the ring as ESP_RING_SHT21_RH or ESP_RING_SHT21_TEMP record with
+ * esp_sht21_dev.id as sensor id.
+ *
+ * @param ring The ring or NULL to disable.
+ */
+void ICACHE_FLASH_ATTR
+esp_sht21_set_ring(esp_ring *ring);
 
 #endif //ESP_SHT21_H
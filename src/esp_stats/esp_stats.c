@@ -0,0 +1,41 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <esp_stats.h>
+
+void
+esp_stats_hist_add(esp_stats_hist *hist, uint32_t cycles)
+{
+  uint8_t bucket = 0;
+  uint32_t val = cycles >> (ESP_STATS_SHIFT - 1);
+
+  while (val > 1 && bucket < ESP_STATS_BUCKETS - 1) {
+    val >>= 1;
+    bucket++;
+  }
+
+  hist->cnt[bucket]++;
+  if (cycles > hist->max) hist->max = cycles;
+}
+
+void ICACHE_FLASH_ATTR
+esp_stats_hist_reset(esp_stats_hist *hist)
+{
+  uint8_t idx;
+
+  for (idx = 0; idx < ESP_STATS_BUCKETS; idx++) hist->cnt[idx] = 0;
+  hist->max = 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef ESP_STATS_H
+#define ESP_STATS_H
+
+#include <c_types.h>
+
+// Number of histogram buckets.
+#define ESP_STATS_BUCKETS 16
+
+// Bucket 0 counts durations below 2^ESP_STATS_SHIFT CPU cycles, bucket n
+// counts durations from 2^(ESP_STATS_SHIFT + n - 1) to 2^(ESP_STATS_SHIFT + n).
+// At 80MHz bucket 0 is below 1.6us and the last bucket is above 26ms.
+#define ESP_STATS_SHIFT 7
+
+// Instrumentation is compiled in only when ESP_DRV_STATS is defined.
+#ifdef ESP_DRV_STATS
+  #define ESP_STATS_INC(counter) ((counter)++)
+  #define ESP_STATS_ADD(counter, val) ((counter) += (val))
+  #define ESP_STATS_START(var) uint32_t var = esp_stats_ccount()
+  #define ESP_STATS_HIST(hist, start) esp_stats_hist_add(&(hist), esp_stats_ccount() - (start))
+  #define ESP_STATS_CYCLES(hist, cycles) esp_stats_hist_add(&(hist), (cycles))
+#else
+  #define ESP_STATS_INC(counter) ((void) 0)
+  #define ESP_STATS_ADD(counter, val) ((void) 0)
+  #define ESP_STATS_START(var)
+  #define ESP_STATS_HIST(hist, start) ((void) 0)
+  #define ESP_STATS_CYCLES(hist, cycles) ((void) 0)
+#endif
+
+// CPU cycles histogram.
+typedef struct {
+  uint32_t cnt[ESP_STATS_BUCKETS]; // Number of durations in each bucket.
+  uint32_t max;                    // Longest duration in CPU cycles.
+} esp_stats_hist;
+
+
+/**
+ * Get CPU cycle counter (CCOUNT).
+ *
+ * @return The cycle counter.
+ */
+#ifdef __XTENSA__
+static inline uint32_t
+esp_stats_ccount(void)
+{
+  uint32_t ccount;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+  return ccount;
+}
+#else
+// Host builds (test/) get the counter from the simulated clock.
+uint32_t
+esp_stats_ccount(void);
+#endif
+
+/**
+ * Add duration to histogram.
+ *
+ * Kept in IRAM so it can be called from interrupt handler.
+ *
+ * @param hist   The histogram.
+ * @param cycles The duration in CPU cycles.
+ */
+void
+esp_stats_hist_add(esp_stats_hist *hist, uint32_t cycles);
+
+/**
+ * Reset histogram.
+ *
+ * @param hist The histogram.
+ */
+void ICACHE_FLASH_ATTR
+esp_stats_hist_reset(esp_stats_hist *hist);
+
+#endif //ESP_STATS_H
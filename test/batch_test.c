@@ -0,0 +1,138 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// Sample batch encoder built as host (gateway) library.
+//
+// Checks 64 records round trip through one frame and prints encode and
+// decode rates.
+
+#include <drv_test.h>
+#include <esp_batch.h>
+#include <string.h>
+
+// Records in one batch.
+#define RECS 64
+// Batches encoded by the benchmark.
+#define BENCH_BATCHES 20000u
+
+static esp_ring_rec recs[RECS];
+
+// Sensors sampled every second: 4 DS18B20, DHT22 and SHT21 pair.
+static void
+recs_fill(void)
+{
+  static const uint8_t types[] = {
+    ESP_RING_DS18B20, ESP_RING_DS18B20, ESP_RING_DS18B20, ESP_RING_DS18B20,
+    ESP_RING_DHT22, ESP_RING_SHT21_RH, ESP_RING_SHT21_TEMP,
+  };
+  uint8_t sensor;
+  uint16_t idx;
+
+  for (idx = 0; idx < RECS; idx++) {
+    sensor = (uint8_t) (idx % sizeof(types));
+    recs[idx].id = (uint8_t) (sensor + 1);
+    recs[idx].type = types[sensor];
+    recs[idx].status = 0;
+    recs[idx].pad = 0;
+    recs[idx].time = 5000000 + (idx / sizeof(types)) * 1000000 + sensor * 2000 + idx % 3;
+
+    switch (types[sensor]) {
+      case ESP_RING_DS18B20:
+        recs[idx].raw = (uint16_t) (0x0150 + sensor * 8 + idx % 4);
+        break;
+      case ESP_RING_DHT22:
+        recs[idx].raw = ((uint32_t) (652 + idx % 5) << 16) | (uint16_t) (231 - idx % 3);
+        break;
+      default:
+        recs[idx].raw = (uint16_t) ((0x6800 + idx * 4) & 0xFFFC);
+        break;
+    }
+  }
+
+  // Failed read keeps only the status.
+  recs[10].status = 3;
+}
+
+static void
+test_batch_round_trip(void)
+{
+  esp_ring_rec out[RECS];
+  uint8_t frame[300];
+  uint16_t len, cnt, idx;
+  uint32_t t0;
+
+  recs_fill();
+  TEST_EQ(RECS, esp_batch_encode(recs, RECS, frame, sizeof(frame), &len));
+  printf("  %u records in %u bytes\n", RECS, len);
+  TEST_CHECK(len <= 256);
+
+  TEST_CHECK(esp_batch_decode(frame, len, out, RECS, &cnt));
+  TEST_EQ(RECS, cnt);
+
+  t0 = recs[0].time;
+  for (idx = 0; idx < cnt; idx++) {
+    TEST_EQ(recs[idx].id, out[idx].id);
+    TEST_EQ(recs[idx].type, out[idx].type);
+    TEST_EQ(recs[idx].status, out[idx].status);
+    TEST_EQ(recs[idx].status ? 0 : recs[idx].raw, out[idx].raw);
+    TEST_EQ(t0 + (recs[idx].time - t0) / ESP_BATCH_TIME_US * ESP_BATCH_TIME_US, out[idx].time);
+  }
+
+  // Corrupted frame.
+  frame[len / 2] ^= 0x10;
+  TEST_CHECK(!esp_batch_decode(frame, len, out, RECS, &cnt));
+}
+
+static void
+test_batch_bench(void)
+{
+  esp_ring_rec out[RECS];
+  uint8_t frame[300];
+  volatile uint16_t sink = 0;
+  uint16_t len = 0, cnt;
+  uint64_t start, ns;
+  uint32_t round;
+
+  recs_fill();
+
+  start = drv_test_host_ns();
+  for (round = 0; round < BENCH_BATCHES; round++) {
+    recs[round % RECS].raw ^= 1;
+    sink += esp_batch_encode(recs, RECS, frame, sizeof(frame), &len);
+  }
+  ns = drv_test_host_ns() - start;
+  printf("  encode %.2f M records/s, %.1f MB/s out\n",
+         (double) BENCH_BATCHES * RECS * 1000 / ns, (double) BENCH_BATCHES * len * 1000 / ns);
+
+  start = drv_test_host_ns();
+  for (round = 0; round < BENCH_BATCHES; round++) {
+    esp_batch_decode(frame, len, out, RECS, &cnt);
+    sink += cnt;
+  }
+  ns = drv_test_host_ns() - start;
+  printf("  decode %.2f M records/s\n", (double) BENCH_BATCHES * RECS * 1000 / ns);
+
+  (void) sink;
+}
+
+void
+batch_suite(void)
+{
+  TEST_RUN(test_batch_round_trip);
+  TEST_RUN(test_batch_bench);
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// Bulk decoder built as host (gateway) library.
+//
+// Results are checked against the scalar per-frame path (esp_crc8_*
+// and esp_conv.h called for every frame) and both are timed. This file
+// is built with -O3 like the library so the comparison is fair.
+
+#include <drv_test.h>
+#include <esp_bulk.h>
+#include <esp_crc.h>
+#include <esp_conv.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Frames decoded by correctness checks and per benchmark round.
+#define FRAMES (64u * 1024 + 7)
+// Benchmark rounds.
+#define ROUNDS 20
+
+// Every 13th frame is corrupted.
+#define BAD(idx) ((idx) % 13 == 5)
+
+static uint32_t seed = 1;
+
+static uint8_t
+rnd(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (uint8_t) (seed >> 16);
+}
+
+static uint8_t *
+ds18b20_frames(void)
+{
+  uint8_t *sp = malloc(FRAMES * 9);
+  uint8_t *curr;
+  uint32_t idx;
+  uint8_t pos;
+
+  for (idx = 0; idx < FRAMES; idx++) {
+    curr = &sp[idx * 9];
+    for (pos = 0; pos < 8; pos++) curr[pos] = rnd();
+    curr[1] &= 0x87; // Sign extended register.
+    if (curr[1] & 0x80) curr[1] |= 0xF8;
+    curr[4] = (uint8_t) ((curr[4] & 0x60) | 0x1F);
+    curr[8] = esp_crc8_ow(0, curr, 8);
+    if (BAD(idx)) curr[idx % 9] ^= 0x04;
+  }
+
+  return sp;
+}
+
+static uint8_t *
+dht22_frames(void)
+{
+  uint8_t *frame = malloc(FRAMES * 5);
+  uint8_t *curr;
+  uint32_t idx;
+
+  for (idx = 0; idx < FRAMES; idx++) {
+    curr = &frame[idx * 5];
+    curr[0] = (uint8_t) (rnd() & 0x03);
+    curr[1] = rnd();
+    curr[2] = (uint8_t) (rnd() & 0x81);
+    curr[3] = rnd();
+    curr[4] = (uint8_t) (curr[0] + curr[1] + curr[2] + curr[3]);
+    if (BAD(idx)) curr[4] ^= 0x10;
+  }
+
+  return frame;
+}
+
+static uint8_t *
+sht21_frames(void)
+{
+  uint8_t *meas = malloc(FRAMES * 3);
+  uint8_t *curr;
+  uint32_t idx;
+
+  for (idx = 0; idx < FRAMES; idx++) {
+    curr = &meas[idx * 3];
+    curr[0] = rnd();
+    curr[1] = rnd();
+    curr[2] = esp_crc8_sht(0, curr, 2);
+    if (BAD(idx)) curr[1] ^= 0x80;
+  }
+
+  return meas;
+}
+
+// Scalar per-frame paths.
+
+static uint32_t
+ds18b20_scalar(const uint8_t *sp, uint32_t cnt, esp_bulk_ds18b20 *out)
+{
+  uint32_t idx, valid = 0;
+
+  for (idx = 0; idx < cnt; idx++, sp += 9) {
+    out->ok[idx] = (uint8_t) (esp_crc8_ow(0, sp, 9) == 0);
+    valid += out->ok[idx];
+    out->raw[idx] = esp_conv_ds18b20_raw(sp);
+    out->temp_mc[idx] = esp_conv_ds18b20_mc(out->raw[idx]);
+  }
+
+  return valid;
+}
+
+static uint32_t
+dht22_scalar(const uint8_t *frame, uint32_t cnt, esp_bulk_dht22 *out)
+{
+  uint32_t idx, valid = 0;
+
+  for (idx = 0; idx < cnt; idx++, frame += 5) {
+    out->ok[idx] = esp_conv_dht22_parity(frame);
+    valid += out->ok[idx];
+    out->hum_dp[idx] = esp_conv_dht22_hum(frame);
+    out->temp_dc[idx] = esp_conv_dht22_temp(frame);
+  }
+
+  return valid;
+}
+
+static uint32_t
+sht21_rh_scalar(const uint8_t *meas, uint32_t cnt, esp_bulk_sht21 *out)
+{
+  uint32_t idx, valid = 0;
+
+  for (idx = 0; idx < cnt; idx++, meas += 3) {
+    out->ok[idx] = (uint8_t) (esp_crc8_sht(0, meas, 2) == meas[2]);
+    valid += out->ok[idx];
+    out->raw[idx] = esp_conv_sht21_word(meas);
+    out->value[idx] = esp_conv_sht21_rh(out->raw[idx]);
+  }
+
+  return valid;
+}
+
+// Frames with bad CRC or parity.
+static uint32_t
+bad_cnt(void)
+{
+  uint32_t idx, cnt = 0;
+
+  for (idx = 0; idx < FRAMES; idx++) cnt += BAD(idx);
+
+  return cnt;
+}
+
+// Values from datasheets.
+static void
+test_bulk_known(void)
+{
+  // DS18B20 +25.0625C at 12 bits and -10.125C at 11 bits.
+  uint8_t sp[18] = {0x91, 0x01, 0x4B, 0x46, 0x7F, 0xFF, 0x0F, 0x10, 0x00,
+                    0x5E, 0xFF, 0x4B, 0x46, 0x5F, 0xFF, 0x0F, 0x10, 0x00};
+  // DHT22 65.2% 35.1C and -10.1C.
+  uint8_t frame[10] = {0x02, 0x8C, 0x01, 0x5F, 0xEE, 0x02, 0x8C, 0x80, 0x65, 0x73};
+  // SHT21 humidity 0x7C80 (54.79%) and temperature 0x6850 (24.75C).
+  uint8_t meas[3] = {0x7C, 0x80, 0x00};
+  uint8_t temp[3] = {0x68, 0x50, 0x00};
+  int16_t raw[2], hum_dp[2], temp_dc[2];
+  int32_t temp_mc[2], value[1];
+  uint16_t word[1];
+  uint8_t ok[2];
+  esp_bulk_ds18b20 ds = {raw, temp_mc, ok};
+  esp_bulk_dht22 dht = {hum_dp, temp_dc, ok};
+  esp_bulk_sht21 sht = {word, value, ok};
+
+  sp[8] = esp_crc8_ow(0, sp, 8);
+  sp[17] = esp_crc8_ow(0, &sp[9], 8);
+  TEST_EQ(2, esp_bulk_ds18b20_decode(sp, 2, &ds));
+  TEST_EQ(25062, temp_mc[0]);
+  TEST_EQ(-10125, temp_mc[1]);
+
+  TEST_EQ(2, esp_bulk_dht22_decode(frame, 2, &dht));
+  TEST_EQ(652, hum_dp[0]);
+  TEST_EQ(351, temp_dc[0]);
+  TEST_EQ(-101, temp_dc[1]);
+
+  meas[2] = esp_crc8_sht(0, meas, 2);
+  TEST_EQ(1, esp_bulk_sht21_rh_decode(meas, 1, &sht));
+  TEST_EQ(5479, value[0]);
+  temp[2] = esp_crc8_sht(0, temp, 2);
+  TEST_EQ(1, esp_bulk_sht21_temp_decode(temp, 1, &sht));
+  TEST_EQ(2475, value[0]);
+}
+
+// Frames kernels give the same CRC as per-frame calls for any count.
+static void
+test_bulk_crc_frames(void)
+{
+  static const uint32_t counts[] = {0, 1, 63, 64, 65, 200};
+  uint8_t frames[200 * 9];
+  uint8_t crc[200];
+  uint32_t idx, cnt;
+
+  for (idx = 0; idx < sizeof(frames); idx++) frames[idx] = rnd();
+
+  for (cnt = 0; cnt < sizeof(counts) / sizeof(counts[0]); cnt++) {
+    memset(crc, 0xAA, sizeof(crc));
+    esp_crc8_ow_frames(frames, 9, counts[cnt], crc);
+    for (idx = 0; idx < counts[cnt]; idx++) TEST_EQ(esp_crc8_ow(0, &frames[idx * 9], 9), crc[idx]);
+    // Nothing written past cnt.
+    if (counts[cnt] < 200) TEST_EQ(0xAA, crc[counts[cnt]]);
+
+    esp_crc8_sht_frames(frames, 3, counts[cnt], crc);
+    for (idx = 0; idx < counts[cnt]; idx++) TEST_EQ(esp_crc8_sht(0, &frames[idx * 3], 3), crc[idx]);
+  }
+}
+
+// Bulk and scalar paths give the same results.
+static void
+test_bulk_matches_scalar(void)
+{
+  uint8_t *sp = ds18b20_frames();
+  uint8_t *frame = dht22_frames();
+  uint8_t *meas = sht21_frames();
+  int16_t *raw[2], *a[2], *b[2];
+  int32_t *val[2];
+  uint16_t *word[2];
+  uint8_t *ok[2];
+  uint8_t idx;
+
+  for (idx = 0; idx < 2; idx++) {
+    raw[idx] = malloc(FRAMES * sizeof(int16_t));
+    a[idx] = malloc(FRAMES * sizeof(int16_t));
+    b[idx] = malloc(FRAMES * sizeof(int16_t));
+    val[idx] = malloc(FRAMES * sizeof(int32_t));
+    word[idx] = malloc(FRAMES * sizeof(uint16_t));
+    ok[idx] = malloc(FRAMES);
+  }
+
+  {
+    esp_bulk_ds18b20 bulk = {raw[0], val[0], ok[0]};
+    esp_bulk_ds18b20 scalar = {raw[1], val[1], ok[1]};
+
+    TEST_EQ(FRAMES - bad_cnt(), esp_bulk_ds18b20_decode(sp, FRAMES, &bulk));
+    TEST_EQ(FRAMES - bad_cnt(), ds18b20_scalar(sp, FRAMES, &scalar));
+    TEST_CHECK(memcmp(ok[0], ok[1], FRAMES) == 0);
+    TEST_CHECK(memcmp(raw[0], raw[1], FRAMES * sizeof(int16_t)) == 0);
+    TEST_CHECK(memcmp(val[0], val[1], FRAMES * sizeof(int32_t)) == 0);
+  }
+
+  {
+    esp_bulk_dht22 bulk = {a[0], b[0], ok[0]};
+    esp_bulk_dht22 scalar = {a[1], b[1], ok[1]};
+
+    TEST_EQ(FRAMES - bad_cnt(), esp_bulk_dht22_decode(frame, FRAMES, &bulk));
+    TEST_EQ(FRAMES - bad_cnt(), dht22_scalar(frame, FRAMES, &scalar));
+    TEST_CHECK(memcmp(ok[0], ok[1], FRAMES) == 0);
+    TEST_CHECK(memcmp(a[0], a[1], FRAMES * sizeof(int16_t)) == 0);
+    TEST_CHECK(memcmp(b[0], b[1], FRAMES * sizeof(int16_t)) == 0);
+  }
+
+  {
+    esp_bulk_sht21 bulk = {word[0], val[0], ok[0]};
+    esp_bulk_sht21 scalar = {word[1], val[1], ok[1]};
+
+    TEST_EQ(FRAMES - bad_cnt(), esp_bulk_sht21_rh_decode(meas, FRAMES, &bulk));
+    TEST_EQ(FRAMES - bad_cnt(), sht21_rh_scalar(meas, FRAMES, &scalar));
+    TEST_CHECK(memcmp(ok[0], ok[1], FRAMES) == 0);
+    TEST_CHECK(memcmp(word[0], word[1], FRAMES * sizeof(uint16_t)) == 0);
+    TEST_CHECK(memcmp(val[0], val[1], FRAMES * sizeof(int32_t)) == 0);
+  }
+
+  for (idx = 0; idx < 2; idx++) {
+    free(raw[idx]);
+    free(a[idx]);
+    free(b[idx]);
+    free(val[idx]);
+    free(word[idx]);
+    free(ok[idx]);
+  }
+  free(sp);
+  free(frame);
+  free(meas);
+}
+
+static void
+bench_print(const char *name, uint64_t bulk_ns, uint64_t scalar_ns)
+{
+  double frames = (double) FRAMES * ROUNDS * 1000;
+
+  printf("  %-8s %10.1f %10.1f %7.1fx\n", name,
+         frames / bulk_ns, frames / scalar_ns, (double) scalar_ns / bulk_ns);
+}
+
+// Million frames per second, bulk versus scalar per-frame path.
+static void
+test_bulk_bench(void)
+{
+  uint8_t *sp = ds18b20_frames();
+  uint8_t *frame = dht22_frames();
+  uint8_t *meas = sht21_frames();
+  int16_t *a = malloc(FRAMES * sizeof(int16_t));
+  int16_t *b = malloc(FRAMES * sizeof(int16_t));
+  int32_t *val = malloc(FRAMES * sizeof(int32_t));
+  uint16_t *word = malloc(FRAMES * sizeof(uint16_t));
+  uint8_t *ok = malloc(FRAMES);
+  esp_bulk_ds18b20 ds = {a, val, ok};
+  esp_bulk_dht22 dht = {a, b, ok};
+  esp_bulk_sht21 sht = {word, val, ok};
+  volatile uint32_t sink = 0;
+  uint64_t start, bulk_ns, scalar_ns;
+  uint32_t round;
+
+  printf("  %-8s %10s %10s %8s\n", "frames", "bulk M/s", "scalar M/s", "speedup");
+
+  start = drv_test_host_ns();
+  for (round = 0; round < ROUNDS; round++) sink += esp_bulk_ds18b20_decode(sp, FRAMES, &ds);
+  bulk_ns = drv_test_host_ns() - start;
+  start = drv_test_host_ns();
+  for (round = 0; round < ROUNDS; round++) sink += ds18b20_scalar(sp, FRAMES, &ds);
+  scalar_ns = drv_test_host_ns() - start;
+  bench_print("ds18b20", bulk_ns, scalar_ns);
+
+  start = drv_test_host_ns();
+  for (round = 0; round < ROUNDS; round++) sink += esp_bulk_dht22_decode(frame, FRAMES, &dht);
+  bulk_ns = drv_test_host_ns() - start;
+  start = drv_test_host_ns();
+  for (round = 0; round < ROUNDS; round++) sink += dht22_scalar(frame, FRAMES, &dht);
+  scalar_ns = drv_test_host_ns() - start;
+  bench_print("dht22", bulk_ns, scalar_ns);
+
+  start = drv_test_host_ns();
+  for (round = 0; round < ROUNDS; round++) sink += esp_bulk_sht21_rh_decode(meas, FRAMES, &sht);
+  bulk_ns = drv_test_host_ns() - start;
+  start = drv_test_host_ns();
+  for (round = 0; round < ROUNDS; round++) sink += sht21_rh_scalar(meas, FRAMES, &sht);
+  scalar_ns = drv_test_host_ns() - start;
+  bench_print("sht21", bulk_ns, scalar_ns);
+
+  (void) sink;
+  free(a);
+  free(b);
+  free(val);
+  free(word);
+  free(ok);
+  free(sp);
+  free(frame);
+  free(meas);
+}
+
+void
+bulk_suite(void)
+{
+  TEST_RUN(test_bulk_known);
+  TEST_RUN(test_bulk_crc_frames);
+  TEST_RUN(test_bulk_matches_scalar);
+  TEST_RUN(test_bulk_bench);
+}
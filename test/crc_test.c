@@ -0,0 +1,144 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// CRC8 implementations.
+//
+// esp_crc.c is built once for every ESP_CRC_MODE with functions renamed
+// to esp_crc8_{ow,sht}_<mode> (see CMakeLists.txt) so all modes can be
+// checked against each other and benchmarked in one executable.
+
+#include <drv_test.h>
+#include <c_types.h>
+
+// Bytes processed by the benchmark for each mode.
+#define BENCH_BYTES (4u * 1024 * 1024)
+
+#define CRC_MODE_DECL(mode)                                                 \
+  uint8_t esp_crc8_ow_##mode(uint8_t crc, const uint8_t *data, uint16_t len);  \
+  uint8_t esp_crc8_sht_##mode(uint8_t crc, const uint8_t *data, uint16_t len);
+
+CRC_MODE_DECL(bitwise)
+CRC_MODE_DECL(nibble)
+CRC_MODE_DECL(table)
+
+typedef uint8_t (crc_fn)(uint8_t crc, const uint8_t *data, uint16_t len);
+
+typedef struct {
+  const char *name;
+  crc_fn *ow;
+  crc_fn *sht;
+} crc_mode;
+
+static const crc_mode modes[] = {
+  {"bitwise", esp_crc8_ow_bitwise, esp_crc8_sht_bitwise},
+  {"nibble", esp_crc8_ow_nibble, esp_crc8_sht_nibble},
+  {"table", esp_crc8_ow_table, esp_crc8_sht_table},
+};
+
+#define MODE_CNT (sizeof(modes) / sizeof(modes[0]))
+
+static uint8_t buf[4096];
+
+static void
+buf_fill(void)
+{
+  uint32_t seed = 1;
+  uint16_t idx;
+
+  for (idx = 0; idx < sizeof(buf); idx++) {
+    seed = seed * 1103515245 + 12345;
+    buf[idx] = (uint8_t) (seed >> 16);
+  }
+}
+
+// Known answers from the application notes.
+static void
+test_crc_known(void)
+{
+  // ROM example from Maxim application note 27.
+  static const uint8_t rom[8] = {0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2};
+  // SHT21 measurement 0x683A has CRC 0x7C.
+  static const uint8_t word[2] = {0x68, 0x3A};
+  uint8_t idx;
+
+  for (idx = 0; idx < MODE_CNT; idx++) {
+    TEST_EQ(rom[7], modes[idx].ow(0, rom, 7));
+    TEST_EQ(0, modes[idx].ow(0, rom, 8));
+    TEST_EQ(0x7C, modes[idx].sht(0, word, 2));
+  }
+}
+
+// All modes give the same CRC for every length and chained calls.
+static void
+test_crc_modes_agree(void)
+{
+  uint16_t len;
+  uint8_t idx, ow, sht;
+
+  buf_fill();
+
+  for (len = 0; len <= 64; len++) {
+    ow = modes[0].ow(0, buf, len);
+    sht = modes[0].sht(0, buf, len);
+
+    for (idx = 1; idx < MODE_CNT; idx++) {
+      TEST_EQ(ow, modes[idx].ow(0, buf, len));
+      TEST_EQ(sht, modes[idx].sht(0, buf, len));
+      TEST_EQ(ow, modes[idx].ow(modes[idx].ow(0, buf, len / 2), buf + len / 2, len - len / 2));
+    }
+  }
+}
+
+// Host time per byte for every mode.
+static void
+test_crc_bench(void)
+{
+  volatile uint8_t sink = 0;
+  uint64_t start, ns_ow, ns_sht, base_ow = 0;
+  uint32_t rounds = BENCH_BYTES / sizeof(buf);
+  uint32_t round;
+  uint8_t idx;
+
+  buf_fill();
+
+  printf("  %-8s %10s %10s %8s\n", "mode", "ow ns/B", "sht ns/B", "speedup");
+  for (idx = 0; idx < MODE_CNT; idx++) {
+    start = drv_test_host_ns();
+    for (round = 0; round < rounds; round++) sink ^= modes[idx].ow(sink, buf, sizeof(buf));
+    ns_ow = drv_test_host_ns() - start;
+
+    start = drv_test_host_ns();
+    for (round = 0; round < rounds; round++) sink ^= modes[idx].sht(sink, buf, sizeof(buf));
+    ns_sht = drv_test_host_ns() - start;
+
+    if (idx == 0) base_ow = ns_ow;
+    printf("  %-8s %10.2f %10.2f %7.1fx\n", modes[idx].name,
+           (double) ns_ow / BENCH_BYTES, (double) ns_sht / BENCH_BYTES,
+           ns_ow ? (double) base_ow / ns_ow : 0.0);
+  }
+
+  (void) sink;
+}
+
+void
+crc_suite(void)
+{
+  TEST_RUN(test_crc_known);
+  TEST_RUN(test_crc_modes_agree);
+  TEST_RUN(test_crc_bench);
+}
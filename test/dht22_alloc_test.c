@@ -0,0 +1,145 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// DHT22 read path does not touch the heap.
+//
+// Synthetic frames are sent by the waveform simulator. The heap is
+// checked around every read including error paths returning early.
+
+#include <drv_test.h>
+#include <sim.h>
+#include <sim_dht22.h>
+#include <esp_eb.h>
+#include <esp_dht22.h>
+#include <esp_ring.h>
+#include <mem.h>
+#include <math.h>
+
+#define GPIO 4
+
+// Synthetic frames (humidity and temperature in 0.1 units).
+static const int16_t frames[][2] = {
+  {0, 0}, {1000, 800}, {652, -105}, {1, -1}, {999, -400}, {415, 253},
+};
+
+#define FRAME_CNT (sizeof(frames) / sizeof(frames[0]))
+
+static sim_dht22 sim;
+static esp_dht22_dev *dev;
+static esp_ring ring;
+static esp_ring_rec recs[16];
+
+static void
+setup(void)
+{
+  sim_reset();
+  sim_dht22_init(&sim, GPIO);
+  esp_dht22_set_gpio_isr(NULL, NULL);
+  esp_dht22_init(GPIO);
+  dev = esp_dht22_new_dev(GPIO);
+
+  // Ring with caller provided records.
+  esp_ring_init(&ring, recs, 16);
+  esp_dht22_set_ring(&ring);
+}
+
+static void
+teardown(void)
+{
+  esp_dht22_set_ring(NULL);
+  os_free(dev);
+  sim_dht22_free(&sim);
+}
+
+static bool
+read_done(void)
+{
+  return sim_eb_count(ESP_DHT22_EV_READY) + sim_eb_count(ESP_DHT22_EV_ERROR) > 0;
+}
+
+static esp_dht22_err
+read(bool async)
+{
+  esp_dht22_err err;
+
+  sim_run_ms(ESP_DHT22_MIN_INTERVAL_US / 1000);
+  if (!async) return esp_dht22_get(dev);
+
+  sim_eb_reset();
+  err = esp_dht22_get_async(dev);
+  if (err != ESP_DHT22_OK) return err;
+  sim_run_until(read_done, 100);
+
+  // Asynchronous read reports error code in the ring record.
+  return (esp_dht22_err) ring.recs[(ring.head - 1) & ring.mask].status;
+}
+
+static void
+check_reads(bool async)
+{
+  esp_ring_rec rec[16];
+  sim_heap_st heap;
+  uint8_t idx;
+
+  setup();
+
+  for (idx = 0; idx < FRAME_CNT; idx++) {
+    sim.hum = (uint16_t) frames[idx][0];
+    sim.temp = frames[idx][1];
+
+    heap = sim_heap;
+    TEST_EQ(ESP_DHT22_OK, read(async));
+    TEST_EQ(heap.allocs, sim_heap.allocs);
+    TEST_EQ(heap.live, sim_heap.live);
+    TEST_CHECK(fabsf(dev->hum - frames[idx][0] / 10.0f) < 0.001f);
+    TEST_CHECK(fabsf(dev->temp - frames[idx][1] / 10.0f) < 0.001f);
+  }
+
+  // Error paths.
+  heap = sim_heap;
+  sim.parity_errs = 1;
+  TEST_EQ(ESP_DHT22_ERR_PARITY, read(async));
+  sim.missing = true;
+  TEST_EQ(ESP_DHT22_ERR_BAD_RESP_SIGNAL, read(async));
+  TEST_EQ(heap.allocs, sim_heap.allocs);
+  TEST_EQ(heap.live, sim_heap.live);
+
+  // Every read including failed ones was recorded.
+  TEST_EQ(FRAME_CNT + 2, esp_ring_pop(&ring, rec, 16));
+
+  teardown();
+}
+
+static void
+test_dht22_zero_alloc_blocking(void)
+{
+  check_reads(false);
+}
+
+static void
+test_dht22_zero_alloc_async(void)
+{
+  check_reads(true);
+}
+
+void
+dht22_alloc_suite(void)
+{
+  TEST_RUN(test_dht22_zero_alloc_blocking);
+  TEST_RUN(test_dht22_zero_alloc_async);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// DHT22 decode success versus waveform jitter.
+//
+// Built once per ESP_DHT22_POLL_US value. Every waveform state is randomly
+// stretched or shortened by up to the jitter and the bus is sampled
+// through BUS_READ which takes SAMPLE_NS of CPU time.
+
+#include <test.h>
+#include <sim.h>
+#include <sim_dht22.h>
+#include <esp_eb.h>
+#include <esp_dht22.h>
+#include <mem.h>
+
+#define GPIO 4
+// Reads per jitter value.
+#define READS 200
+// CPU time of one bus sample.
+#define SAMPLE_NS 500
+
+static bool
+read_done(void)
+{
+  return sim_eb_count(ESP_DHT22_EV_READY) + sim_eb_count(ESP_DHT22_EV_ERROR) > 0;
+}
+
+// Returns the number of successful reads.
+static uint16_t
+run(sim_dht22 *sim, esp_dht22_dev *dev, bool async)
+{
+  uint16_t ok = 0;
+  uint16_t idx;
+
+  for (idx = 0; idx < READS; idx++) {
+    sim->hum = (uint16_t) (idx * 5 % 1000);
+    sim->temp = (int16_t) (idx * 7 % 800 - 400);
+
+    if (async) {
+      sim_eb_reset();
+      esp_dht22_get_async(dev);
+      sim_run_until(read_done, 100);
+      if (sim_eb_count(ESP_DHT22_EV_READY)) ok++;
+    } else if (esp_dht22_get(dev) == ESP_DHT22_OK) {
+      ok++;
+    }
+
+    sim_run_ms(ESP_DHT22_MIN_INTERVAL_US / 1000);
+  }
+
+  return ok;
+}
+
+int
+main(void)
+{
+  static const uint8_t jitters[] = {0, 2, 5, 8, 10, 12, 15, 20, 25};
+  esp_dht22_dev *dev;
+  sim_dht22 sim;
+  uint16_t blocking, async;
+  uint8_t idx;
+
+  printf("ESP_DHT22_POLL_US %u, sample %uns, %u reads\n", ESP_DHT22_POLL_US, SAMPLE_NS, READS);
+  printf("  %9s %9s %9s\n", "jitter us", "blocking", "async");
+
+  for (idx = 0; idx < sizeof(jitters); idx++) {
+    sim_reset();
+    sim_dht22_init(&sim, GPIO);
+    sim.jitter_ns = jitters[idx] * 1000u;
+    sim_gpio_sample_ns = SAMPLE_NS;
+    dev = esp_dht22_new_dev(GPIO);
+
+    blocking = run(&sim, dev, false);
+    async = run(&sim, dev, true);
+    printf("  %9u %8.1f%% %8.1f%%\n", jitters[idx],
+           100.0 * blocking / READS, 100.0 * async / READS);
+
+    // Clean waveform always decodes.
+    if (jitters[idx] == 0) {
+      TEST_EQ(READS, blocking);
+      TEST_EQ(READS, async);
+    }
+
+    os_free(dev);
+    sim_dht22_free(&sim);
+  }
+
+  return test_done();
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// DHT22 driver on simulated single wire bus.
+
+#include <test.h>
+#include <sim.h>
+#include <sim_dht22.h>
+#include <esp_eb.h>
+#include <esp_dht22.h>
+#include <mem.h>
+#include <math.h>
+
+#define GPIO 4
+#define GPIO_OTHER 5
+
+static sim_dht22 sim;
+static uint32_t app_calls;
+
+static void
+setup(void)
+{
+  sim_reset();
+  sim_dht22_init(&sim, GPIO);
+  sim_gpio_sample_ns = 500;
+  esp_dht22_set_gpio_isr(NULL, NULL);
+  esp_dht22_init(GPIO);
+}
+
+static bool
+read_done(void)
+{
+  return sim_eb_count(ESP_DHT22_EV_READY) + sim_eb_count(ESP_DHT22_EV_ERROR) > 0;
+}
+
+// Application handler clearing only its own pin.
+static void
+app_isr(void *arg)
+{
+  (void) arg;
+  app_calls++;
+  GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, BIT(GPIO_OTHER));
+}
+
+static void
+test_blocking(void)
+{
+  esp_dht22_dev *dev;
+  esp_dht22_stats stats;
+
+  setup();
+  sim.hum = 652;
+  sim.temp = -105;
+  dev = esp_dht22_new_dev(GPIO);
+
+  TEST_EQ(ESP_DHT22_OK, esp_dht22_get(dev));
+  TEST_CHECK(fabsf(dev->hum - 65.2f) < 0.001f);
+  TEST_CHECK(fabsf(dev->temp + 10.5f) < 0.001f);
+  TEST_EQ(1, sim.frames);
+
+  sim.parity_errs = 1;
+  sim_run_ms(2000);
+  TEST_EQ(ESP_DHT22_ERR_PARITY, esp_dht22_get(dev));
+
+  sim.missing = true;
+  sim_run_ms(2000);
+  TEST_EQ(ESP_DHT22_ERR_BAD_RESP_SIGNAL, esp_dht22_get(dev));
+
+  esp_dht22_stats_get(dev, &stats, true);
+  TEST_EQ(3, stats.reads);
+  TEST_EQ(1, stats.parity_errs);
+  TEST_EQ(1, stats.bad_resp);
+
+  // Interrupts were disabled only for the frame.
+  TEST_CHECK(stats.irq_off.max < 6000 * SIM_CPU_MHZ);
+
+  os_free(dev);
+  sim_dht22_free(&sim);
+}
+
+static void
+test_async(void)
+{
+  esp_dht22_dev *dev, *dev2;
+
+  setup();
+  sim.hum = 415;
+  sim.temp = 253;
+  dev = esp_dht22_new_dev(GPIO);
+  dev2 = esp_dht22_new_dev(GPIO_OTHER);
+
+  TEST_EQ(ESP_DHT22_OK, esp_dht22_get_async(dev));
+  TEST_EQ(ESP_DHT22_ERR_BUSY, esp_dht22_get_async(dev2));
+  TEST_CHECK(sim_run_until(read_done, 100));
+  TEST_EQ(1, sim_eb_count(ESP_DHT22_EV_READY));
+  TEST_CHECK(fabsf(dev->hum - 41.5f) < 0.001f);
+  TEST_CHECK(fabsf(dev->temp - 25.3f) < 0.001f);
+  TEST_EQ(ESP_DHT22_EDGES, dev->edge_cnt);
+
+  // Without application handler GPIO interrupt stays off.
+  TEST_EQ(GPIO_PIN_INTR_DISABLE, sim_gpio_intr_type(GPIO));
+
+  sim.missing = true;
+  sim_eb_reset();
+  sim_run_ms(2000);
+  TEST_EQ(ESP_DHT22_OK, esp_dht22_get_async(dev));
+  TEST_CHECK(sim_run_until(read_done, 100));
+  TEST_EQ(1, sim_eb_count(ESP_DHT22_EV_ERROR));
+  TEST_EQ(0, sim_timers_armed());
+
+  os_free(dev);
+  os_free(dev2);
+  sim_dht22_free(&sim);
+}
+
+// Application GPIO interrupts during asynchronous read.
+static void
+test_async_app_isr(void)
+{
+  esp_dht22_dev *dev;
+
+  setup();
+  app_calls = 0;
+  esp_dht22_set_gpio_isr(app_isr, NULL);
+  ETS_GPIO_INTR_ATTACH(app_isr, NULL);
+  ETS_GPIO_INTR_ENABLE();
+  dev = esp_dht22_new_dev(GPIO);
+
+  TEST_EQ(ESP_DHT22_OK, esp_dht22_get_async(dev));
+
+  // Other pin interrupt in the middle of the frame.
+  sim_run_ms(3);
+  sim_gpio_raise(BIT(GPIO_OTHER));
+  TEST_EQ(1, app_calls);
+  TEST_EQ(0, GPIO_REG_READ(GPIO_STATUS_ADDRESS) & BIT(GPIO_OTHER));
+
+  TEST_CHECK(sim_run_until(read_done, 100));
+  TEST_EQ(1, sim_eb_count(ESP_DHT22_EV_READY));
+
+  // Handler is back.
+  TEST_CHECK(sim_gpio_isr() == app_isr);
+  sim_gpio_raise(BIT(GPIO_OTHER));
+  TEST_EQ(2, app_calls);
+
+  os_free(dev);
+  sim_dht22_free(&sim);
+}
+
+// Reads within minimum interval are served from cache.
+static void
+test_cached(void)
+{
+  esp_dht22_dev *dev;
+  uint32_t age;
+
+  setup();
+  dev = esp_dht22_new_dev(GPIO);
+
+  TEST_EQ(ESP_DHT22_OK, esp_dht22_get_cached(dev, &age));
+  TEST_EQ(0, age);
+  sim_run_ms(500);
+  TEST_EQ(ESP_DHT22_OK, esp_dht22_get_cached(dev, &age));
+  TEST_EQ(500000, age);
+  TEST_EQ(1, sim.frames);
+  TEST_EQ(1, dev->cache_hits);
+  TEST_EQ(1, dev->cache_misses);
+
+  // Never had a good read.
+  sim.missing = true;
+  os_free(dev);
+  dev = esp_dht22_new_dev(GPIO);
+  TEST_EQ(ESP_DHT22_ERR_BAD_RESP_SIGNAL, esp_dht22_get_cached(dev, &age));
+  TEST_EQ(ESP_DHT22_ERR_TOO_SOON, esp_dht22_get_cached(dev, &age));
+  TEST_EQ(1, dev->cache_empty);
+  TEST_EQ(0, dev->cache_hits);
+
+  os_free(dev);
+  sim_dht22_free(&sim);
+}
+
+int
+main(void)
+{
+  TEST_RUN(test_blocking);
+  TEST_RUN(test_async);
+  TEST_RUN(test_async_app_isr);
+  TEST_RUN(test_cached);
+
+  return test_done();
+}
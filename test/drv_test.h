@@ -0,0 +1,63 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// Driver library tests collected in one executable (drv_test).
+//
+// Each suite is in its own file and registered in drv_test.c.
+
+#ifndef DRV_TEST_H
+#define DRV_TEST_H
+
+#include <test.h>
+#include <stdint.h>
+
+/**
+ * Get host monotonic time.
+ *
+ * Used by benchmarks measuring real CPU time (not the virtual clock).
+ *
+ * @return The time in nanoseconds.
+ */
+uint64_t
+drv_test_host_ns(void);
+
+// CRC8 implementations (crc_test.c).
+void
+crc_suite(void);
+
+// DHT22 read path heap usage (dht22_alloc_test.c).
+void
+dht22_alloc_suite(void);
+
+// DS18B20 device list heap usage (ds18b20_pool_test.c).
+void
+ds18b20_pool_suite(void);
+
+// Sample ring with producer and consumer threads (ring_test.c).
+void
+ring_suite(void);
+
+// Sample batch encoder (batch_test.c).
+void
+batch_suite(void);
+
+// Bulk decoder (bulk_test.c).
+void
+bulk_suite(void);
+
+#endif //DRV_TEST_H
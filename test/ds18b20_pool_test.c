@@ -0,0 +1,146 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// DS18B20 device list heap usage: per-device allocations versus pool.
+//
+// Prints the number of allocations and heap high-water mark of finding
+// and releasing devices for every mode and device count.
+
+#include <drv_test.h>
+#include <sim.h>
+#include <sim_ow.h>
+#include <esp_ds18b20.h>
+#include <mem.h>
+
+#define GPIO 4
+#define MAX_DEVS 32
+
+typedef enum {
+  MODE_LIST,        // esp_ds18b20_search and esp_ds18b20_free_list.
+  MODE_POOL,        // Pool allocated by the driver.
+  MODE_POOL_CALLER, // Pool with caller provided slots.
+} pool_mode;
+
+static const char *mode_names[] = {"list", "pool", "pool caller"};
+
+static esp_ds18b20_slot slots[MAX_DEVS];
+
+static void
+setup(uint8_t cnt)
+{
+  uint8_t idx;
+
+  sim_reset();
+  sim_ow_reset();
+  for (idx = 0; idx < cnt; idx++) sim_ow_add(GPIO, 0x2000 + idx * 0x13);
+}
+
+static uint8_t
+list_len(esp_ow_device *list)
+{
+  uint8_t cnt = 0;
+
+  for (; list; list = list->next) cnt++;
+
+  return cnt;
+}
+
+// Find and release cnt devices. Returns heap statistics.
+static sim_heap_st
+run(pool_mode mode, uint8_t cnt)
+{
+  esp_ds18b20_pool pool;
+  esp_ow_device *list = NULL;
+  esp_ow_device *dev;
+  sim_heap_st heap;
+
+  setup(cnt);
+
+  if (mode == MODE_LIST) {
+    TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO, false, &list));
+  } else {
+    TEST_CHECK(esp_ds18b20_pool_init(&pool, mode == MODE_POOL ? NULL : slots, cnt));
+    TEST_EQ(ESP_OW_OK, esp_ds18b20_pool_search(GPIO, false, &pool, &list));
+    TEST_EQ(cnt, pool.used);
+
+    // All devices are in one block.
+    for (dev = list; dev; dev = dev->next) {
+      TEST_CHECK((esp_ds18b20_slot *) dev >= pool.slots);
+      TEST_CHECK((esp_ds18b20_slot *) dev < pool.slots + cnt);
+      TEST_CHECK(dev->custom == &((esp_ds18b20_slot *) dev)->st);
+    }
+  }
+  TEST_EQ(cnt, list_len(list));
+
+  if (mode == MODE_LIST) esp_ds18b20_free_list(list);
+  else esp_ds18b20_pool_free(&pool);
+
+  heap = sim_heap;
+  TEST_EQ(0, heap.live);
+
+  return heap;
+}
+
+static void
+test_pool_heap(void)
+{
+  static const uint8_t counts[] = {1, 8, 16, 32};
+  sim_heap_st heap;
+  uint8_t cnt, mode;
+
+  printf("  %-12s %5s %7s %10s\n", "mode", "devs", "allocs", "high (B)");
+  for (mode = MODE_LIST; mode <= MODE_POOL_CALLER; mode++) {
+    for (cnt = 0; cnt < sizeof(counts); cnt++) {
+      heap = run((pool_mode) mode, counts[cnt]);
+      printf("  %-12s %5u %7u %10zu\n", mode_names[mode], counts[cnt], heap.allocs, heap.high);
+
+      if (mode == MODE_LIST) {
+        // Device and its status.
+        TEST_EQ(2 * counts[cnt], heap.allocs);
+      } else if (mode == MODE_POOL) {
+        TEST_EQ(1, heap.allocs);
+        TEST_EQ(counts[cnt] * sizeof(esp_ds18b20_slot), heap.high);
+      } else {
+        TEST_EQ(0, heap.allocs);
+      }
+    }
+  }
+}
+
+// Devices which did not fit in the pool are counted without allocating.
+static void
+test_pool_truncated(void)
+{
+  esp_ds18b20_pool pool;
+  esp_ow_device *list = NULL;
+
+  setup(8);
+  TEST_CHECK(esp_ds18b20_pool_init(&pool, slots, 5));
+  TEST_EQ(ESP_OW_ERR_MEM, esp_ds18b20_pool_search(GPIO, false, &pool, &list));
+  TEST_EQ(5, list_len(list));
+  TEST_EQ(3, pool.truncated);
+  TEST_EQ(0, sim_heap.allocs);
+  esp_ds18b20_pool_free(&pool);
+}
+
+void
+ds18b20_pool_suite(void)
+{
+  TEST_RUN(test_pool_heap);
+  TEST_RUN(test_pool_truncated);
+}
@@ -0,0 +1,699 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// DS18B20 driver on simulated OneWire bus.
+//
+// Besides checking the driver it prints bus transactions and virtual
+// time one esp_ds18b20_convert_all sweep takes for different device counts.
+
+#include <test.h>
+#include <sim.h>
+#include <sim_ow.h>
+#include <esp_eb.h>
+#include <esp_ds18b20.h>
+#include <user_interface.h>
+
+#define GPIO_A 4
+#define GPIO_B 5
+#define GPIO_C 12
+
+static void
+setup(void)
+{
+  sim_reset();
+  sim_ow_reset();
+  esp_ds18b20_inv_clear();
+}
+
+// Add devices with temperatures 20, 21.25, 22.5, ... Celsius.
+static void
+add_devs(uint8_t gpio_num, uint8_t cnt)
+{
+  uint8_t idx;
+  sim_ds18b20 *dev;
+
+  for (idx = 0; idx < cnt; idx++) {
+    dev = sim_ow_add(gpio_num, 0x1000 + gpio_num * 0x100 + idx * 0x11);
+    dev->temp_mc = 20000 + idx * 1250;
+  }
+}
+
+// Find simulated device by ROM.
+static sim_ds18b20 *
+sim_find(esp_ow_device *dev)
+{
+  uint8_t idx;
+
+  for (idx = 0; idx < sim_ow_cnt(dev->gpio_num); idx++) {
+    if (memcmp(sim_ow_dev(dev->gpio_num, idx)->rom, dev->rom, 8) == 0) {
+      return sim_ow_dev(dev->gpio_num, idx);
+    }
+  }
+
+  return NULL;
+}
+
+static uint8_t
+list_len(esp_ow_device *list)
+{
+  uint8_t cnt = 0;
+
+  for (; list; list = list->next) cnt++;
+
+  return cnt;
+}
+
+static int16_t
+raw(esp_ow_device *dev)
+{
+  return ((esp_ds18b20_st *) dev->custom)->raw;
+}
+
+// Number of durations in histogram.
+static uint32_t
+hist_cnt(const esp_stats_hist *hist)
+{
+  uint32_t cnt = 0;
+  uint8_t idx;
+
+  for (idx = 0; idx < ESP_STATS_BUCKETS; idx++) cnt += hist->cnt[idx];
+
+  return cnt;
+}
+
+static bool
+bus_ready(void)
+{
+  return sim_eb_count(ESP_DS18B20_EV_BUS_READY) > 0;
+}
+
+static bool
+temp_done(void)
+{
+  return sim_eb_count(ESP_DS18B20_EV_TEMP_READY) + sim_eb_count(ESP_DS18B20_EV_TEMP_ERROR) > 0;
+}
+
+static bool
+sampler_ready(void)
+{
+  return sim_eb_count(ESP_DS18B20_EV_SAMPLER_READY) > 0;
+}
+
+static bool
+monitor_done(void)
+{
+  return sim_eb_count(ESP_DS18B20_EV_MONITOR_DONE) > 0;
+}
+
+// Run one convert_all sweep and wait for it.
+static void
+sweep(uint8_t gpio_num, esp_ow_device *list)
+{
+  sim_eb_reset();
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_convert_all(gpio_num, list));
+  TEST_CHECK(sim_run_until(bus_ready, 2000));
+  TEST_CHECK(sim_eb_arg(ESP_DS18B20_EV_BUS_READY) == list);
+}
+
+static void
+test_search(void)
+{
+  esp_ow_device *list, *curr;
+
+  setup();
+  add_devs(GPIO_A, 8);
+
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+  TEST_EQ(8, list_len(list));
+  for (curr = list; curr; curr = curr->next) {
+    TEST_CHECK(sim_find(curr) != NULL);
+    TEST_EQ(GPIO_A, curr->gpio_num);
+  }
+  TEST_CHECK(esp_ds18b20_has_parasite(GPIO_A) == false);
+
+  sim_ow_dev(GPIO_A, 3)->parasite = true;
+  TEST_CHECK(esp_ds18b20_has_parasite(GPIO_A) == true);
+
+  esp_ds18b20_free_list(list);
+  TEST_EQ(0, sim_heap.live);
+
+  // Bad ROM CRC fails the search.
+  sim_ow_dev(GPIO_A, 5)->rom[7] ^= 0x01;
+  TEST_EQ(ESP_OW_ERR_BAD_CRC, esp_ds18b20_search(GPIO_A, false, &list));
+
+  // Empty bus.
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_C, false, &list));
+  TEST_CHECK(list == NULL);
+}
+
+// Devices found by asynchronous search.
+static esp_ow_device *found;
+static esp_ow_device **found_tail;
+static uint64_t found_ns[8];
+static uint8_t found_cnt;
+
+static void
+on_dev_found(const char *event, void *arg)
+{
+  esp_ow_device *dev = arg;
+
+  if (found_cnt < 8) found_ns[found_cnt] = sim_now_ns;
+  found_cnt++;
+
+  *found_tail = dev;
+  found_tail = &dev->next;
+}
+
+static bool
+search_done(void)
+{
+  return sim_eb_count(ESP_DS18B20_EV_SEARCH_DONE) > 0;
+}
+
+// Asynchronous search finds one device per timer tick.
+static void
+test_search_async(void)
+{
+  esp_ds18b20_search_st search;
+  esp_stats_hist hist;
+  esp_ow_device *curr;
+  uint8_t idx;
+
+  setup();
+  add_devs(GPIO_A, 5);
+  found = NULL;
+  found_tail = &found;
+  found_cnt = 0;
+  esp_eb_attach(ESP_DS18B20_EV_DEV_FOUND, on_dev_found);
+  esp_ds18b20_search_stats_get(&hist, true);
+
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_search_start(&search, GPIO_A, false));
+  TEST_EQ(0, found_cnt);
+  TEST_CHECK(sim_run_until(search_done, 2000));
+  TEST_EQ(5, found_cnt);
+  TEST_EQ(5, sim_eb_count(ESP_DS18B20_EV_DEV_FOUND));
+  TEST_EQ(1, sim_eb_count(ESP_DS18B20_EV_SEARCH_DONE));
+  TEST_CHECK(sim_eb_arg(ESP_DS18B20_EV_SEARCH_DONE) == &search);
+  TEST_EQ(ESP_OW_OK, search.err);
+  TEST_CHECK(search.done);
+  for (idx = 1; idx < 5; idx++) {
+    TEST_CHECK(found_ns[idx] - found_ns[idx - 1] >= ESP_DS18B20_SEARCH_MS * 1000000ULL);
+  }
+
+  // One search pass per device and the last one finding nothing.
+  esp_ds18b20_search_stats_get(&hist, true);
+  TEST_EQ(6, hist_cnt(&hist));
+
+  // Nothing more happens after done.
+  sim_run_ms(100);
+  TEST_EQ(5, found_cnt);
+  TEST_EQ(1, sim_eb_count(ESP_DS18B20_EV_SEARCH_DONE));
+  TEST_EQ(0, sim_timers_armed());
+
+  // Every device found once and ready for conversion.
+  TEST_EQ(5, list_len(found));
+  for (idx = 0; idx < 5; idx++) {
+    for (curr = found; curr; curr = curr->next) {
+      if (sim_find(curr) == sim_ow_dev(GPIO_A, idx)) break;
+    }
+    TEST_CHECK(curr != NULL);
+  }
+  sweep(GPIO_A, found);
+  for (curr = found; curr; curr = curr->next) {
+    TEST_EQ(sim_find(curr)->temp_mc, esp_ds18b20_raw_to_mc(raw(curr)));
+  }
+
+  esp_ds18b20_free_list(found);
+  TEST_EQ(0, sim_heap.live);
+}
+
+static void
+test_sweep(void)
+{
+  static const uint8_t counts[] = {1, 4, 16, 32};
+  esp_ow_device *list, *curr;
+  sim_ow_stats *bus;
+  sim_ow_stats before;
+  uint64_t start_ns;
+  uint8_t idx;
+  uint8_t n;
+
+  printf("  %5s %7s %7s %7s %9s %9s\n", "devs", "resets", "wr B", "rd B", "bus ms", "sweep ms");
+  for (idx = 0; idx < sizeof(counts); idx++) {
+    n = counts[idx];
+    setup();
+    add_devs(GPIO_A, n);
+    TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+
+    bus = sim_ow_stats_get(GPIO_A);
+    before = *bus;
+    start_ns = sim_now_ns;
+    sweep(GPIO_A, list);
+
+    // Convert: reset, skip, convert. Read: reset, match + 8, read sp, 9 bytes.
+    TEST_EQ(1 + n, bus->resets - before.resets);
+    TEST_EQ(2 + n * 10, bus->bytes_wr - before.bytes_wr);
+    TEST_EQ(n * 9, bus->bytes_rd - before.bytes_rd);
+    printf("  %5u %7u %7u %7u %9.2f %9.2f\n", n,
+           bus->resets - before.resets,
+           bus->bytes_wr - before.bytes_wr,
+           bus->bytes_rd - before.bytes_rd,
+           (double) (bus->bus_ns - before.bus_ns) / 1e6,
+           (double) (sim_now_ns - start_ns) / 1e6);
+
+    for (curr = list; curr; curr = curr->next) {
+      TEST_EQ(sim_find(curr)->temp_mc, esp_ds18b20_raw_to_mc(raw(curr)));
+      TEST_EQ(1, sim_find(curr)->convs);
+      TEST_EQ(-1, ((esp_ds18b20_st *) curr->custom)->retries);
+    }
+
+    esp_ds18b20_free_list(list);
+    TEST_EQ(0, sim_heap.live);
+    TEST_EQ(0, sim_timers_armed());
+  }
+}
+
+static void
+test_resolution(void)
+{
+  esp_ow_device *list, *curr;
+  esp_ds18b20_stats stats;
+  uint64_t start_ns;
+
+  setup();
+  add_devs(GPIO_A, 3);
+  sim_ow_dev(GPIO_A, 0)->temp_mc = 21300;
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+
+  for (curr = list; curr; curr = curr->next) {
+    TEST_EQ(ESP_OW_OK, esp_ds18b20_set_res(curr, ESP_DS18B20_RES_9));
+    TEST_EQ(0x1F, sim_find(curr)->cfg);
+  }
+  esp_ds18b20_stats_get(list, &stats, true);
+  TEST_EQ(1, hist_cnt(&stats.write));
+  TEST_CHECK(stats.write.max > 0);
+
+  // The sweep waits for the slowest resolution on the list.
+  start_ns = sim_now_ns;
+  sweep(GPIO_A, list);
+  TEST_CHECK(sim_now_ns - start_ns < (94 + 3 * 15) * 1000000ULL);
+
+  for (curr = list; curr; curr = curr->next) {
+    TEST_EQ(0, raw(curr) & 0x7);
+    TEST_EQ(ESP_DS18B20_RES_9, ((esp_ds18b20_st *) curr->custom)->res);
+  }
+  // 21.3 Celsius at 0.5 Celsius step.
+  TEST_EQ(21000, esp_ds18b20_raw_to_mc(raw(list)) / 500 * 500);
+
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_set_res(list->next, ESP_DS18B20_RES_12));
+  start_ns = sim_now_ns;
+  sweep(GPIO_A, list);
+  TEST_CHECK(sim_now_ns - start_ns >= 750 * 1000000ULL);
+
+  esp_ds18b20_free_list(list);
+}
+
+static void
+test_crc_error(void)
+{
+  esp_ow_device *list;
+  esp_ds18b20_stats stats;
+
+  setup();
+  add_devs(GPIO_A, 3);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+
+  sim_find(list->next)->crc_errs = 1;
+  sweep(GPIO_A, list);
+  TEST_CHECK(raw(list) != ESP_DS18B20_RAW_ERR);
+  TEST_EQ(ESP_DS18B20_RAW_ERR, raw(list->next));
+  TEST_CHECK(raw(list->next->next) != ESP_DS18B20_RAW_ERR);
+
+  esp_ds18b20_stats_get(list->next, &stats, true);
+  TEST_EQ(1, stats.reads);
+  TEST_EQ(1, stats.crc_errs);
+  // Bus wide Convert T is recorded on every device.
+  TEST_EQ(1, hist_cnt(&stats.conv));
+
+  // Next sweep recovers.
+  sweep(GPIO_A, list);
+  TEST_EQ(sim_find(list->next)->temp_mc, esp_ds18b20_raw_to_mc(raw(list->next)));
+
+  esp_ds18b20_free_list(list);
+}
+
+static void
+test_missing(void)
+{
+  esp_ow_device *list;
+  esp_ds18b20_stats stats;
+
+  setup();
+  add_devs(GPIO_A, 3);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+
+  // Others give presence pulse but nobody answers the match.
+  sim_find(list)->missing = true;
+  sweep(GPIO_A, list);
+  TEST_EQ(ESP_DS18B20_RAW_ERR, raw(list));
+  TEST_CHECK(raw(list->next) != ESP_DS18B20_RAW_ERR);
+  esp_ds18b20_stats_get(list, &stats, true);
+  TEST_EQ(1, stats.crc_errs);
+
+  // Whole bus gone.
+  sim_find(list->next)->missing = true;
+  sim_find(list->next->next)->missing = true;
+  sim_eb_reset();
+  TEST_EQ(ESP_DS18B20_NO_DEV, esp_ds18b20_convert_all(GPIO_A, list));
+  esp_d18b20_read_sp(list);
+  esp_ds18b20_stats_get(list, &stats, true);
+  TEST_EQ(1, stats.presence_errs);
+
+  esp_ds18b20_free_list(list);
+}
+
+static void
+test_convert_polls(void)
+{
+  esp_ow_device *list;
+  esp_ds18b20_stats stats;
+  uint64_t start_ns;
+
+  setup();
+  add_devs(GPIO_A, 1);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+
+  // Finishes at 80% of maximum time: 600ms. Polling starts at 375ms
+  // and goes every 10ms. Bus transactions take up to 15ms.
+  sim_find(list)->conv_pct = 80;
+  start_ns = sim_now_ns;
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_convert(list));
+  TEST_EQ(ESP_DS18B20_ERR_CONV_IN_PROG, esp_ds18b20_convert(list));
+  TEST_CHECK(sim_run_until(temp_done, 2000));
+  TEST_EQ(1, sim_eb_count(ESP_DS18B20_EV_TEMP_READY));
+  TEST_CHECK(sim_now_ns - start_ns >= 600 * 1000000ULL);
+  TEST_CHECK(sim_now_ns - start_ns < 640 * 1000000ULL);
+
+  esp_ds18b20_stats_get(list, &stats, true);
+  TEST_EQ(1, stats.convs);
+  TEST_EQ(24, stats.polls_last);
+  TEST_EQ(1, hist_cnt(&stats.conv));
+  TEST_EQ(0, stats.timeouts);
+  TEST_CHECK(((esp_ds18b20_st *) list->custom)->cpu_us > 0);
+
+  // Never finishes.
+  sim_eb_reset();
+  sim_find(list)->conv_pct = 200;
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_convert(list));
+  TEST_CHECK(sim_run_until(temp_done, 2000));
+  TEST_EQ(1, sim_eb_count(ESP_DS18B20_EV_TEMP_ERROR));
+  esp_ds18b20_stats_get(list, &stats, true);
+  TEST_EQ(1, stats.timeouts);
+  TEST_EQ(0, sim_timers_armed());
+
+  esp_ds18b20_free_list(list);
+  TEST_EQ(0, sim_heap.live);
+}
+
+// Parasite powered device is read after the maximum conversion time
+// without status polls.
+static void
+test_convert_parasite(void)
+{
+  esp_ow_device *list;
+  esp_ds18b20_stats stats;
+  uint64_t start_ns;
+
+  setup();
+  add_devs(GPIO_A, 1);
+  sim_ow_dev(GPIO_A, 0)->parasite = true;
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+
+  start_ns = sim_now_ns;
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_convert(list));
+  TEST_EQ(1, ((esp_ds18b20_st *) list->custom)->parasite);
+  TEST_CHECK(sim_run_until(temp_done, 2000));
+  TEST_EQ(1, sim_eb_count(ESP_DS18B20_EV_TEMP_READY));
+  TEST_CHECK(sim_now_ns - start_ns >= ESP_DS18B20_CONV_MS_12 * 1000000ULL);
+  TEST_CHECK(raw(list) != SIM_DS18B20_POR);
+  TEST_EQ(sim_find(list)->temp_mc, esp_ds18b20_raw_to_mc(raw(list)));
+
+  esp_ds18b20_stats_get(list, &stats, true);
+  TEST_EQ(1, stats.polls_last);
+  TEST_EQ(0, sim_timers_armed());
+
+  esp_ds18b20_free_list(list);
+  TEST_EQ(0, sim_heap.live);
+}
+
+static void
+test_parasite(void)
+{
+  esp_ow_device *list, *curr;
+
+  setup();
+  add_devs(GPIO_A, 2);
+  sim_ow_dev(GPIO_A, 0)->parasite = true;
+  sim_ow_dev(GPIO_A, 1)->parasite = true;
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+  TEST_CHECK(esp_ds18b20_has_parasite(GPIO_A));
+
+  // Parasite devices can't signal end of conversion, the sweep
+  // waits the maximum conversion time and gets valid values.
+  sweep(GPIO_A, list);
+  for (curr = list; curr; curr = curr->next) {
+    TEST_CHECK(raw(curr) != SIM_DS18B20_POR);
+    TEST_EQ(sim_find(curr)->temp_mc, esp_ds18b20_raw_to_mc(raw(curr)));
+  }
+
+  esp_ds18b20_free_list(list);
+}
+
+// Broken bus must not take down the sampler.
+static void
+test_sampler(void)
+{
+  static const uint8_t gpios[] = {GPIO_A, GPIO_B, GPIO_C};
+  esp_ds18b20_sampler *smp;
+  esp_ow_device *curr;
+
+  setup();
+  add_devs(GPIO_A, 3);
+  add_devs(GPIO_B, 2);
+  sim_ow_dev(GPIO_B, 1)->rom[7] ^= 0x01;
+
+  smp = esp_ds18b20_sampler_new(gpios, 3);
+  TEST_CHECK(smp != NULL);
+  TEST_EQ(ESP_OW_OK, smp->buses[0].err);
+  TEST_EQ(3, list_len(smp->buses[0].list));
+  TEST_EQ(ESP_OW_ERR_BAD_CRC, smp->buses[1].err);
+  TEST_CHECK(smp->buses[1].list == NULL);
+  TEST_EQ(ESP_OW_OK, smp->buses[2].err);
+  TEST_CHECK(smp->buses[2].list == NULL);
+
+  sim_eb_reset();
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_sampler_start(smp));
+  TEST_CHECK(sim_run_until(sampler_ready, 2000));
+  TEST_EQ(1, sim_eb_count(ESP_DS18B20_EV_BUS_READY));
+  for (curr = smp->buses[0].list; curr; curr = curr->next) {
+    TEST_EQ(sim_find(curr)->temp_mc, esp_ds18b20_raw_to_mc(raw(curr)));
+  }
+
+  esp_ds18b20_sampler_free(smp);
+  TEST_EQ(0, sim_heap.live);
+}
+
+// Parasite powered bus can't be polled, the sampler waits the maximum
+// conversion time instead of reading power-on values.
+static void
+test_sampler_parasite(void)
+{
+  static const uint8_t gpios[] = {GPIO_A, GPIO_B};
+  esp_ds18b20_sampler *smp;
+  esp_ow_device *curr;
+  uint8_t idx;
+  uint64_t start;
+
+  setup();
+  add_devs(GPIO_A, 2);
+  add_devs(GPIO_B, 2);
+  sim_ow_dev(GPIO_B, 0)->parasite = true;
+  sim_ow_dev(GPIO_B, 1)->parasite = true;
+
+  smp = esp_ds18b20_sampler_new(gpios, 2);
+  TEST_CHECK(smp != NULL);
+  TEST_CHECK(smp->buses[0].parasite == false);
+  TEST_CHECK(smp->buses[1].parasite == true);
+
+  sim_eb_reset();
+  start = sim_now_ns;
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_sampler_start(smp));
+  TEST_CHECK(sim_run_until(sampler_ready, 2000));
+  TEST_CHECK(sim_now_ns - start >= ESP_DS18B20_CONV_MS_12 * 1000000ULL);
+  TEST_EQ(2, sim_eb_count(ESP_DS18B20_EV_BUS_READY));
+  for (idx = 0; idx < 2; idx++) {
+    for (curr = smp->buses[idx].list; curr; curr = curr->next) {
+      TEST_CHECK(raw(curr) != SIM_DS18B20_POR);
+      TEST_EQ(sim_find(curr)->temp_mc, esp_ds18b20_raw_to_mc(raw(curr)));
+    }
+  }
+  TEST_EQ(0, sim_timers_armed());
+
+  esp_ds18b20_sampler_free(smp);
+  TEST_EQ(0, sim_heap.live);
+}
+
+// ROM inventory in RTC memory.
+static void
+test_inventory(void)
+{
+  esp_ow_device *list, *loaded;
+  sim_ow_stats *bus = sim_ow_stats_get(GPIO_A);
+  uint32_t resets;
+
+  setup();
+  add_devs(GPIO_A, 4);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_set_res(list->next, ESP_DS18B20_RES_10));
+
+  // Scratchpads never read are read before save.
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_inv_save(GPIO_A, list));
+  TEST_EQ(1, sim_find(list)->sp_reads);
+  TEST_EQ(1, sim_find(list->next->next)->sp_reads);
+
+  // Restore reads each device once and runs no search.
+  resets = bus->resets;
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_restore(GPIO_A, &loaded));
+  TEST_EQ(4, list_len(loaded));
+  TEST_EQ(4, bus->resets - resets);
+  TEST_EQ(ESP_DS18B20_RES_10, ((esp_ds18b20_st *) loaded->next->custom)->res);
+  esp_ds18b20_free_list(loaded);
+
+  // Missing device makes restore fall back to search.
+  sim_find(list->next)->missing = true;
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_restore(GPIO_A, &loaded));
+  TEST_EQ(3, list_len(loaded));
+  esp_ds18b20_free_list(loaded);
+
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_inv_load(GPIO_A, &loaded));
+  TEST_EQ(3, list_len(loaded));
+  esp_ds18b20_free_list(loaded);
+
+  // Failed read invalidates inventory.
+  sweep(GPIO_A, list);
+  TEST_EQ(ESP_OW_ERR_BAD_CRC, esp_ds18b20_inv_load(GPIO_A, &loaded));
+  TEST_CHECK(loaded == NULL);
+
+  // RTC memory failure.
+  sim_find(list->next)->missing = false;
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_inv_save(GPIO_A, list));
+  sim_rtc_fail(true);
+  TEST_EQ(ESP_OW_ERR_MEM, esp_ds18b20_inv_load(GPIO_A, &loaded));
+  sim_rtc_fail(false);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_inv_load(GPIO_A, &loaded));
+  TEST_EQ(4, list_len(loaded));
+
+  esp_ds18b20_free_list(loaded);
+  esp_ds18b20_free_list(list);
+  TEST_EQ(0, sim_heap.live);
+}
+
+// Bus with more devices than fit in the inventory is never saved.
+static void
+test_inventory_full(void)
+{
+  esp_ow_device *list, *loaded;
+
+  setup();
+  add_devs(GPIO_A, 4);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_inv_save(GPIO_A, list));
+  esp_ds18b20_free_list(list);
+
+  // The old inventory is dropped too.
+  sim_ow_reset();
+  add_devs(GPIO_A, ESP_DS18B20_INV_MAX + 1);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+  TEST_EQ(ESP_DS18B20_INV_MAX + 1, list_len(list));
+  TEST_EQ(ESP_OW_ERR_MEM, esp_ds18b20_inv_save(GPIO_A, list));
+  TEST_EQ(ESP_OW_ERR_BAD_CRC, esp_ds18b20_inv_load(GPIO_A, &loaded));
+  esp_ds18b20_free_list(list);
+
+  // Restore returns all devices.
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_restore(GPIO_A, &loaded));
+  TEST_EQ(ESP_DS18B20_INV_MAX + 1, list_len(loaded));
+  esp_ds18b20_free_list(loaded);
+  TEST_EQ(ESP_OW_ERR_BAD_CRC, esp_ds18b20_inv_load(GPIO_A, &loaded));
+
+  TEST_EQ(0, sim_heap.live);
+}
+
+static void
+test_monitor(void)
+{
+  esp_ds18b20_monitor mon;
+  esp_ow_device *list, *curr;
+  sim_ow_stats *bus = sim_ow_stats_get(GPIO_A);
+  uint32_t resets;
+
+  setup();
+  add_devs(GPIO_A, 6);
+  TEST_EQ(ESP_OW_OK, esp_ds18b20_search(GPIO_A, false, &list));
+  for (curr = list; curr; curr = curr->next) {
+    TEST_EQ(ESP_OW_OK, esp_ds18b20_set_alarm(curr, 10, 30));
+  }
+  esp_ds18b20_monitor_init(&mon, GPIO_A, list);
+
+  // No alarms: two resets no matter the device count.
+  resets = bus->resets;
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_monitor_start(&mon));
+  TEST_CHECK(sim_run_until(monitor_done, 2000));
+  TEST_EQ(0, mon.alarms);
+  TEST_EQ(2, bus->resets - resets);
+
+  sim_find(list->next)->temp_mc = 35000;
+  sim_find(list->next->next->next)->temp_mc = 5000;
+  sim_eb_reset();
+  TEST_EQ(ESP_DS18B20_OK, esp_ds18b20_monitor_start(&mon));
+  TEST_CHECK(sim_run_until(monitor_done, 2000));
+  TEST_EQ(2, mon.alarms);
+  TEST_EQ(2, sim_eb_count(ESP_DS18B20_EV_ALARM));
+  TEST_EQ(35000, esp_ds18b20_raw_to_mc(raw(list->next)));
+
+  esp_ds18b20_free_list(list);
+}
+
+int
+main(void)
+{
+  TEST_RUN(test_search);
+  TEST_RUN(test_search_async);
+  TEST_RUN(test_sweep);
+  TEST_RUN(test_resolution);
+  TEST_RUN(test_crc_error);
+  TEST_RUN(test_missing);
+  TEST_RUN(test_convert_polls);
+  TEST_RUN(test_convert_parasite);
+  TEST_RUN(test_parasite);
+  TEST_RUN(test_sampler);
+  TEST_RUN(test_sampler_parasite);
+  TEST_RUN(test_inventory);
+  TEST_RUN(test_inventory_full);
+  TEST_RUN(test_monitor);
+
+  return test_done();
+}
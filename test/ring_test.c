@@ -0,0 +1,160 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// Sample ring with producer and consumer in separate threads.
+//
+// The producer pushes sequence numbers spread over all record fields so
+// a record published before it was complete shows up as a mismatch.
+
+#include <drv_test.h>
+#include <sim.h>
+#include <esp_ring.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+// Records pushed by the producer.
+#define RECS 200000u
+// Ring size.
+#define RING_SIZE 64
+// Consumer batch size.
+#define BATCH 16
+
+typedef struct {
+  esp_ring ring;
+  bool lossless;          // Producer retries when ring is full.
+  volatile bool done;     // Producer finished.
+  uint32_t pushed;        // Records pushed.
+  uint32_t received;      // Records received.
+  uint32_t bad;           // Records with fields not matching.
+  uint32_t out_of_order;  // Records with sequence or time going back.
+} ring_run;
+
+static esp_ring_rec recs[RING_SIZE];
+
+static void *
+producer(void *arg)
+{
+  ring_run *run = arg;
+  uint32_t seq;
+
+  for (seq = 0; seq < RECS; seq++) {
+    // Virtual clock is touched only by this thread.
+    sim_now_ns += 1000;
+
+    while (!esp_ring_push(&run->ring, (uint8_t) seq, ESP_RING_DHT22, (uint8_t) (seq >> 8), seq)) {
+      if (!run->lossless) break;
+      // Let the consumer run on single core hosts.
+      sched_yield();
+    }
+    run->pushed++;
+  }
+
+  run->done = true;
+
+  return NULL;
+}
+
+static void *
+consumer(void *arg)
+{
+  ring_run *run = arg;
+  esp_ring_rec batch[BATCH];
+  uint32_t last_seq = 0, last_time = 0;
+  uint16_t cnt, idx;
+  bool done;
+
+  do {
+    done = run->done;
+    cnt = esp_ring_pop(&run->ring, batch, BATCH);
+    if (cnt == 0) sched_yield();
+
+    for (idx = 0; idx < cnt; idx++) {
+      if (batch[idx].id != (uint8_t) batch[idx].raw
+          || batch[idx].status != (uint8_t) (batch[idx].raw >> 8)
+          || batch[idx].type != ESP_RING_DHT22) {
+        run->bad++;
+      }
+
+      if (run->received && (batch[idx].raw <= last_seq || batch[idx].time < last_time)) {
+        run->out_of_order++;
+      }
+
+      last_seq = batch[idx].raw;
+      last_time = batch[idx].time;
+      run->received++;
+    }
+  } while (cnt || !done);
+
+  return NULL;
+}
+
+static void
+ring_threads(ring_run *run, bool lossless)
+{
+  pthread_t prod, cons;
+  uint64_t start, ns;
+
+  sim_reset();
+  memset(run, 0, sizeof(*run));
+  run->lossless = lossless;
+  TEST_CHECK(esp_ring_init(&run->ring, recs, RING_SIZE));
+
+  start = drv_test_host_ns();
+  pthread_create(&cons, NULL, consumer, run);
+  pthread_create(&prod, NULL, producer, run);
+  pthread_join(prod, NULL);
+  pthread_join(cons, NULL);
+  ns = drv_test_host_ns() - start;
+
+  printf("  %-9s received %u dropped %u, %.1f M pushes/s\n",
+         lossless ? "lossless" : "drop", run->received, run->ring.dropped,
+         ns ? RECS * 1000.0 / ns : 0.0);
+
+  TEST_EQ(RECS, run->pushed);
+  TEST_EQ(0, run->bad);
+  TEST_EQ(0, run->out_of_order);
+  TEST_EQ(0, esp_ring_count(&run->ring));
+}
+
+// Producer never waits, full ring drops records.
+static void
+test_ring_spsc_drop(void)
+{
+  ring_run run;
+
+  ring_threads(&run, false);
+  TEST_EQ(RECS, run.received + run.ring.dropped);
+}
+
+// Producer waits for the consumer, nothing is lost.
+static void
+test_ring_spsc_lossless(void)
+{
+  ring_run run;
+
+  ring_threads(&run, true);
+  TEST_EQ(RECS, run.received);
+}
+
+void
+ring_suite(void)
+{
+  TEST_RUN(test_ring_spsc_drop);
+  TEST_RUN(test_ring_spsc_lossless);
+}
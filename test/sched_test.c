@@ -0,0 +1,297 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+// Sensor sampling scheduler on simulated timers.
+
+#include <test.h>
+#include <sim.h>
+#include <esp_sched.h>
+
+// Job run order.
+static uint8_t order[16];
+static uint8_t order_cnt;
+// Radio idle predicate result.
+static bool radio_idle;
+// Job returned true and waits for esp_sched_done.
+static bool async;
+
+static void
+setup(void)
+{
+  sim_reset();
+  order_cnt = 0;
+  radio_idle = true;
+  async = false;
+  esp_sched_set_idle_cb(NULL);
+  esp_sched_start();
+}
+
+static bool
+job_cb(void *arg)
+{
+  if (order_cnt < sizeof(order)) order[order_cnt++] = (uint8_t) (uintptr_t) arg;
+
+  return async;
+}
+
+static bool
+idle_cb(void)
+{
+  return radio_idle;
+}
+
+static esp_sched_job *
+job_add(uint8_t id, uint32_t period_ms, uint8_t prio, bool exclusive)
+{
+  esp_sched_job *job = esp_sched_new(job_cb, (void *) (uintptr_t) id, period_ms, prio, exclusive);
+
+  TEST_CHECK(job != NULL);
+  esp_sched_add(job);
+
+  return job;
+}
+
+static void
+test_new(void)
+{
+  setup();
+  TEST_CHECK(esp_sched_new(job_cb, NULL, 0, 0, false) == NULL);
+  TEST_CHECK(esp_sched_new(job_cb, NULL, ESP_SCHED_MAX_PERIOD_MS + 1, 0, false) == NULL);
+  TEST_CHECK(esp_sched_new(NULL, NULL, 100, 0, false) == NULL);
+  TEST_EQ(0, sim_heap.live);
+  esp_sched_stop();
+}
+
+// Due jobs run in priority order no matter the order they were added.
+static void
+test_priority(void)
+{
+  esp_sched_job *a, *b, *c;
+
+  setup();
+  a = job_add(3, 1000, 5, false);
+  b = job_add(1, 1000, 0, false);
+  c = job_add(2, 1000, 2, false);
+
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_EQ(3, order_cnt);
+  TEST_EQ(1, order[0]);
+  TEST_EQ(2, order[1]);
+  TEST_EQ(3, order[2]);
+
+  // Not due again until the period passes.
+  sim_run_ms(990 - ESP_SCHED_TICK_MS);
+  TEST_EQ(3, order_cnt);
+  sim_run_ms(2 * ESP_SCHED_TICK_MS);
+  TEST_EQ(6, order_cnt);
+
+  esp_sched_free(a);
+  esp_sched_free(b);
+  esp_sched_free(c);
+  TEST_EQ(0, sim_heap.live);
+  esp_sched_stop();
+}
+
+// Only one exclusive job runs per tick and asynchronous one keeps the
+// bus until esp_sched_done.
+static void
+test_exclusive(void)
+{
+  esp_sched_job *a, *b, *c;
+
+  setup();
+  a = job_add(1, 1000, 0, true);
+  b = job_add(2, 1000, 1, true);
+  c = job_add(3, 1000, 2, false);
+
+  async = true;
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_EQ(2, order_cnt);
+  TEST_EQ(1, order[0]);
+  TEST_EQ(3, order[1]);
+  TEST_CHECK(a->busy);
+
+  // Job 1 still holds the bus.
+  sim_run_ms(5 * ESP_SCHED_TICK_MS);
+  TEST_EQ(2, order_cnt);
+
+  esp_sched_done(a);
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_EQ(3, order_cnt);
+  TEST_EQ(2, order[2]);
+  esp_sched_done(b);
+  esp_sched_done(c);
+
+  // Synchronous exclusive jobs are spread over ticks too.
+  async = false;
+  order_cnt = 0;
+  sim_run_ms(1000);
+  TEST_EQ(3, order_cnt);
+  TEST_EQ(1, order[0]);
+  TEST_EQ(3, order[1]);
+  TEST_EQ(2, order[2]);
+
+  esp_sched_free(a);
+  esp_sched_free(b);
+  esp_sched_free(c);
+  TEST_EQ(0, sim_heap.live);
+  esp_sched_stop();
+}
+
+// Exclusive jobs wait for radio idle but not longer then
+// ESP_SCHED_MAX_DEFER_MS. Other jobs don't wait.
+static void
+test_idle_defer(void)
+{
+  esp_sched_job *a, *b;
+
+  setup();
+  esp_sched_set_idle_cb(idle_cb);
+  radio_idle = false;
+  a = job_add(1, 1000, 0, true);
+  b = job_add(2, 1000, 1, false);
+
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_EQ(1, order_cnt);
+  TEST_EQ(2, order[0]);
+
+  sim_run_ms(ESP_SCHED_MAX_DEFER_MS - 2 * ESP_SCHED_TICK_MS);
+  TEST_EQ(1, order_cnt);
+
+  // Runs anyway after the maximum deferral.
+  sim_run_ms(2 * ESP_SCHED_TICK_MS);
+  TEST_EQ(2, order_cnt);
+  TEST_EQ(1, order[1]);
+  TEST_CHECK(a->jitter_max_us >= ESP_SCHED_MAX_DEFER_MS * 1000);
+
+  // Runs on the first tick when radio is idle.
+  radio_idle = true;
+  esp_sched_reset_stats(a);
+  sim_run_ms(1000);
+  TEST_EQ(1, a->runs);
+  TEST_CHECK(a->jitter_max_us < ESP_SCHED_TICK_MS * 1000);
+
+  esp_sched_free(a);
+  esp_sched_free(b);
+  TEST_EQ(0, sim_heap.live);
+  esp_sched_stop();
+}
+
+// Late job skips periods it missed and records start jitter.
+static void
+test_missed(void)
+{
+  esp_sched_job *a;
+
+  setup();
+  a = job_add(1, 100, 0, false);
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_EQ(1, a->runs);
+  TEST_EQ(0, a->missed);
+
+  // Busy CPU blocks timers for 350ms.
+  sim_advance_ns(350 * 1000000ULL);
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_EQ(2, a->runs);
+  TEST_EQ(2, a->missed);
+  TEST_CHECK(a->jitter_max_us >= 250000);
+  TEST_CHECK(a->jitter_max_us < 300000);
+  TEST_EQ(ESP_SCHED_TICK_MS * 1000 + a->jitter_max_us, a->jitter_sum_us);
+
+  // Back on period grid.
+  sim_run_ms(100);
+  TEST_EQ(3, a->runs);
+  TEST_EQ(2, a->missed);
+
+  esp_sched_reset_stats(a);
+  TEST_EQ(0, a->runs);
+  TEST_EQ(0, a->missed);
+  TEST_EQ(0, a->jitter_max_us);
+  TEST_EQ(0, a->jitter_sum_us);
+
+  esp_sched_free(a);
+  TEST_EQ(0, sim_heap.live);
+  esp_sched_stop();
+}
+
+static void
+test_delay(void)
+{
+  esp_sched_job *a;
+
+  setup();
+  a = job_add(1, 1000, 0, false);
+  TEST_CHECK(esp_sched_delay(a, ESP_SCHED_MAX_PERIOD_MS + 1) == false);
+  TEST_CHECK(esp_sched_delay(a, 500));
+
+  sim_run_ms(500 - ESP_SCHED_TICK_MS);
+  TEST_EQ(0, a->runs);
+  sim_run_ms(2 * ESP_SCHED_TICK_MS);
+  TEST_EQ(1, a->runs);
+
+  esp_sched_free(a);
+  TEST_EQ(0, sim_heap.live);
+  esp_sched_stop();
+}
+
+// Job freed while running is released when it finishes.
+static void
+test_free_busy(void)
+{
+  esp_sched_job *a, *b;
+
+  setup();
+  a = job_add(1, 100, 0, true);
+  b = job_add(2, 100, 1, true);
+
+  async = true;
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_CHECK(a->busy);
+
+  esp_sched_free(a);
+  TEST_EQ(2, sim_heap.live);
+
+  // Not scheduled any more but still holds the bus.
+  sim_run_ms(200);
+  TEST_EQ(1, order_cnt);
+
+  esp_sched_done(a);
+  TEST_EQ(1, sim_heap.live);
+  sim_run_ms(ESP_SCHED_TICK_MS);
+  TEST_EQ(2, order_cnt);
+  TEST_EQ(2, order[1]);
+
+  esp_sched_done(b);
+  esp_sched_free(b);
+  TEST_EQ(0, sim_heap.live);
+  esp_sched_stop();
+}
+
+int
+main(void)
+{
+  TEST_RUN(test_new);
+  TEST_RUN(test_priority);
+  TEST_RUN(test_exclusive);
+  TEST_RUN(test_idle_defer);
+  TEST_RUN(test_missed);
+  TEST_RUN(test_delay);
+  TEST_RUN(test_free_busy);
+
+  return test_done();
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of ESP8266 SDK gpio.h and GPIO interrupt macros.
+//
+// The GPIO status register and interrupt handler are simulated
+// (see sim_gpio_* in sim.h).
+
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <c_types.h>
+
+#ifndef BIT
+  #define BIT(nr) (1UL << (nr))
+#endif
+
+#define GPIO_STATUS_ADDRESS 0x1C
+#define GPIO_STATUS_W1TS_ADDRESS 0x20
+#define GPIO_STATUS_W1TC_ADDRESS 0x24
+
+#define GPIO_ID_PIN(n) (n)
+
+typedef enum {
+  GPIO_PIN_INTR_DISABLE = 0,
+  GPIO_PIN_INTR_POSEDGE = 1,
+  GPIO_PIN_INTR_NEGEDGE = 2,
+  GPIO_PIN_INTR_ANYEDGE = 3,
+  GPIO_PIN_INTR_LOLEVEL = 4,
+  GPIO_PIN_INTR_HILEVEL = 5
+} GPIO_INT_TYPE;
+
+typedef void (sim_isr_t)(void *arg);
+
+uint32_t GPIO_REG_READ(uint32_t reg);
+void GPIO_REG_WRITE(uint32_t reg, uint32_t val);
+
+void gpio_pin_intr_state_set(uint32_t pin, GPIO_INT_TYPE type);
+
+void sim_gpio_isr_attach(sim_isr_t *isr, void *arg);
+void sim_gpio_isr_enable(bool enable);
+
+#define ETS_GPIO_INTR_ATTACH(func, arg) sim_gpio_isr_attach((sim_isr_t *) (func), (void *) (arg))
+#define ETS_GPIO_INTR_ENABLE() sim_gpio_isr_enable(true)
+#define ETS_GPIO_INTR_DISABLE() sim_gpio_isr_enable(false)
+
+#endif //GPIO_H
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of ESP8266 SDK mem.h.
+//
+// Allocations are counted by the simulator (see sim_heap in sim.h).
+
+#ifndef MEM_H
+#define MEM_H
+
+#include <c_types.h>
+
+void *sim_zalloc(size_t size);
+void *sim_malloc(size_t size);
+void sim_free(void *ptr);
+
+#define os_zalloc(s) sim_zalloc(s)
+#define os_malloc(s) sim_malloc(s)
+#define os_free(p) sim_free(p)
+
+#endif //MEM_H
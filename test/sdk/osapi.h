@@ -0,0 +1,59 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of ESP8266 SDK osapi.h.
+//
+// Timers run on the simulator virtual clock (see sim.h).
+
+#ifndef OSAPI_H
+#define OSAPI_H
+
+#include <c_types.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef BIT
+  #define BIT(nr) (1UL << (nr))
+#endif
+
+#define os_printf printf
+#define os_sprintf sprintf
+#define os_memset memset
+#define os_memcpy memcpy
+#define os_memcmp memcmp
+#define os_strlen strlen
+
+typedef void (os_timer_func_t)(void *arg);
+
+typedef struct _os_timer_t {
+  struct _os_timer_t *next; // Next armed timer.
+  os_timer_func_t *func;    // The timer callback.
+  void *arg;                // The callback argument.
+  uint64_t expire_ns;       // Expiration time on virtual clock.
+  uint32_t period_ms;       // The timer period.
+  bool repeat;              // Re-arm after expiration.
+  bool armed;               // Is true when on armed timers list.
+} os_timer_t;
+
+void os_timer_setfn(os_timer_t *timer, os_timer_func_t *func, void *arg);
+void os_timer_arm(os_timer_t *timer, uint32_t ms, bool repeat);
+void os_timer_disarm(os_timer_t *timer);
+
+// Busy wait. Advances the virtual clock.
+void os_delay_us(uint32_t us);
+
+#endif //OSAPI_H
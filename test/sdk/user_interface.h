@@ -0,0 +1,36 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of ESP8266 SDK user_interface.h.
+
+#ifndef USER_INTERFACE_H
+#define USER_INTERFACE_H
+
+#include <c_types.h>
+#include <osapi.h>
+
+// System time in microseconds from the virtual clock.
+uint32_t system_get_time(void);
+
+// Simulated CPU frequency in MHz.
+uint8_t system_get_cpu_freq(void);
+
+// RTC user memory. Blocks 64-191, 4 bytes each.
+bool system_rtc_mem_read(uint8_t src_addr, void *des_addr, uint16_t load_size);
+bool system_rtc_mem_write(uint8_t des_addr, const void *src_addr, uint16_t save_size);
+
+#endif //USER_INTERFACE_H
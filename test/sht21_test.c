@@ -0,0 +1,482 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// SHT21 driver on simulated I2C bus.
+//
+// Besides checking the driver it prints I2C conditions, bytes and bus
+// time every API call takes.
+
+#include <test.h>
+#include <sim.h>
+#include <sim_i2c.h>
+#include <esp_eb.h>
+#include <esp_sht21.h>
+#include <mem.h>
+#include <string.h>
+#include <math.h>
+
+#define SCL 5
+#define SDA 4
+
+// Humidity step at 12 bit resolution.
+#define RH_STEP (125.0f / 4096)
+
+// Bus usage of one API call.
+typedef struct {
+  const char *name;
+  sim_i2c_stats before;
+} cost;
+
+static void
+setup(void)
+{
+  sim_reset();
+  sim_i2c_reset();
+  esp_sht21_init(SCL, SDA);
+}
+
+static void
+cost_start(cost *c, const char *name)
+{
+  c->name = name;
+  c->before = sim_i2c_st;
+}
+
+static void
+cost_print(cost *c)
+{
+  sim_i2c_stats *b = &c->before;
+
+  printf("  %-22s %6u %7u %5u %5u %5u %9.0f\n", c->name,
+         sim_i2c_st.starts - b->starts,
+         sim_i2c_st.rstarts - b->rstarts,
+         sim_i2c_st.stops - b->stops,
+         sim_i2c_st.bytes_wr - b->bytes_wr,
+         sim_i2c_st.bytes_rd - b->bytes_rd,
+         (double) (sim_i2c_st.bus_ns - b->bus_ns) / 1e3);
+}
+
+static void
+cost_header(void)
+{
+  printf("  %-22s %6s %7s %5s %5s %5s %9s\n", "call", "START", "rSTART", "STOP", "wr B", "rd B", "bus us");
+}
+
+static bool
+meas_done(void)
+{
+  return sim_eb_count(ESP_SHT21_EV_READY) + sim_eb_count(ESP_SHT21_EV_ERROR) > 0;
+}
+
+static bool
+rr_done(void)
+{
+  return sim_eb_count(ESP_SHT21_EV_RR_DONE) > 0;
+}
+
+static void
+test_measure(void)
+{
+  esp_sht21_dev *dev;
+  sim_sht21 *sim;
+  float rh, temp;
+
+  setup();
+  sim = sim_i2c_add_sht21(ESP_SHT21_ADDRESS, -1);
+  sim->rh_m = 45500;
+  sim->temp_mc = 23250;
+  dev = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_rh(dev, &rh));
+  TEST_CHECK(fabsf(rh - 45.5f) < RH_STEP);
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_temp_last(dev, &temp));
+  TEST_CHECK(fabsf(temp - 23.25f) < 0.02f);
+
+  sim->temp_mc = -10000;
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_temp(dev, &temp));
+  TEST_CHECK(fabsf(temp + 10.0f) < 0.02f);
+  TEST_EQ(2, sim->convs);
+
+  // Corrupted CRC.
+  sim->crc_errs = 1;
+  TEST_EQ(ESP_I2C_ERR_DATA_CORRUPTED, esp_sht21_get_rh(dev, &rh));
+  TEST_CHECK(rh == ESP_SHT21_BAD_RH);
+
+  // Device gone.
+  sim->missing = true;
+  TEST_EQ(ESP_I2C_ERR_NO_ACK, esp_sht21_get_temp(dev, &temp));
+  TEST_CHECK(temp == ESP_SHT21_BAD_TEMP);
+
+  os_free(dev);
+  TEST_EQ(0, sim_heap.live);
+}
+
+// Number of durations in histogram.
+static uint32_t
+hist_cnt(const esp_stats_hist *hist)
+{
+  uint32_t cnt = 0;
+  uint8_t idx;
+
+  for (idx = 0; idx < ESP_STATS_BUCKETS; idx++) cnt += hist->cnt[idx];
+
+  return cnt;
+}
+
+static void
+test_sample(void)
+{
+  esp_sht21_dev *dev;
+  esp_sht21_smpl smpl;
+  esp_sht21_stats stats;
+  sim_sht21 *sim;
+
+  setup();
+  sim = sim_i2c_add_sht21(ESP_SHT21_ADDRESS, -1);
+  dev = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+
+  TEST_EQ(ESP_I2C_OK, esp_sht21_sample(dev, &smpl));
+  TEST_CHECK(smpl.crc_ok);
+  TEST_EQ(sim_sht21_rh_raw(sim, sim->rh_m), smpl.rh_raw);
+  TEST_EQ(sim_sht21_temp_raw(sim, sim->temp_mc), smpl.temp_raw);
+  TEST_EQ(1, sim->convs);
+
+  sim->crc_errs = 1;
+  TEST_EQ(ESP_I2C_ERR_DATA_CORRUPTED, esp_sht21_sample(dev, &smpl));
+  TEST_CHECK(!smpl.crc_ok);
+  TEST_EQ(0, smpl.rh_raw);
+  TEST_EQ(0, smpl.temp_raw);
+  TEST_CHECK(smpl.temp == ESP_SHT21_BAD_TEMP);
+
+  esp_sht21_stats_get(dev, &stats, true);
+  TEST_EQ(4, stats.reads);
+  TEST_EQ(2, stats.crc_errs);
+
+  os_free(dev);
+}
+
+static void
+test_async(void)
+{
+  esp_sht21_dev *dev;
+  esp_sht21_stats stats;
+  sim_sht21 *sim;
+
+  setup();
+  sim = sim_i2c_add_sht21(ESP_SHT21_ADDRESS, -1);
+  sim->rh_m = 61000;
+  dev = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+
+  // Read header is not acknowledged while converting.
+  TEST_CHECK(esp_sht21_get_rh_async(dev));
+  TEST_CHECK(!esp_sht21_get_rh_async(dev));
+  TEST_CHECK(sim_run_until(meas_done, 200));
+  TEST_EQ(1, sim_eb_count(ESP_SHT21_EV_READY));
+  TEST_CHECK(fabsf(dev->meas.value - 61.0f) < RH_STEP);
+  TEST_CHECK(sim->nacks > 0);
+  TEST_EQ(-1, dev->meas.retries);
+
+  // Every poll including the acknowledged one is timed.
+  esp_sht21_stats_get(dev, &stats, true);
+  TEST_CHECK(stats.polls > 1);
+  TEST_EQ(stats.polls, hist_cnt(&stats.poll));
+  TEST_EQ(1, hist_cnt(&stats.xfer));
+
+  // Conversion which never finishes.
+  sim_eb_reset();
+  sim->conv_pct = 200;
+  TEST_CHECK(esp_sht21_get_temp_async(dev));
+  TEST_CHECK(sim_run_until(meas_done, 500));
+  TEST_EQ(1, sim_eb_count(ESP_SHT21_EV_ERROR));
+  TEST_CHECK(dev->meas.value == ESP_SHT21_BAD_TEMP);
+
+  esp_sht21_stats_get(dev, &stats, true);
+  TEST_EQ(1, stats.timeouts);
+  TEST_EQ(0, sim_timers_armed());
+
+  os_free(dev);
+  TEST_EQ(0, sim_heap.live);
+}
+
+static void
+test_registers(void)
+{
+  esp_sht21_dev *dev;
+  esp_sht21_stats stats;
+  sim_sht21 *sim;
+  uint32_t starts;
+  uint8_t res, level, rev;
+  uint8_t sn[8];
+  bool on;
+
+  setup();
+  sim = sim_i2c_add_sht21(ESP_SHT21_ADDRESS, -1);
+  dev = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+
+  TEST_EQ(ESP_I2C_OK, esp_sht21_res_get(dev, &res));
+  TEST_EQ(ESP_SHT21_RES3, res);
+  TEST_EQ(ESP_I2C_OK, esp_sht21_res_set(dev, ESP_SHT21_RES1));
+  TEST_EQ(ESP_SHT21_RES1, ((sim->ur1 >> 6) & 0x2) | (sim->ur1 & 0x1));
+  TEST_EQ(SIM_SHT21_UR1_POR & 0x78, sim->ur1 & 0x78);
+
+  TEST_EQ(ESP_I2C_OK, esp_sht21_heater_set(dev, true, 5));
+  TEST_EQ(0x4, sim->ur1 & 0x4);
+  TEST_EQ(5, sim->hcr);
+
+  esp_sht21_stats_get(dev, &stats, true);
+  TEST_CHECK(hist_cnt(&stats.reg) >= 4);
+
+  // Served from shadows.
+  starts = sim_i2c_st.starts;
+  TEST_EQ(ESP_I2C_OK, esp_sht21_heater_get(dev, &on, &level));
+  TEST_EQ(ESP_I2C_OK, esp_sht21_res_get(dev, &res));
+  TEST_EQ(starts, sim_i2c_st.starts);
+  TEST_CHECK(on);
+  TEST_EQ(5, level);
+  TEST_EQ(ESP_SHT21_RES1, res);
+
+  // Device reset behind driver's back.
+  sim->ur1 = SIM_SHT21_UR1_POR;
+  sim->hcr = 0;
+  TEST_EQ(ESP_I2C_OK, esp_sht21_refresh(dev));
+  esp_sht21_stats_get(dev, &stats, true);
+  TEST_EQ(2, hist_cnt(&stats.reg));
+  TEST_EQ(ESP_I2C_OK, esp_sht21_heater_get(dev, &on, &level));
+  TEST_CHECK(!on);
+  TEST_EQ(0, level);
+
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_sn(dev, sn));
+  TEST_CHECK(memcmp(sn, sim->sn, 8) == 0);
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_rev(dev, &rev));
+  TEST_EQ(SIM_SHT21_REV, rev);
+
+  os_free(dev);
+}
+
+static void
+test_mux(void)
+{
+  esp_sht21_dev *dev1, *dev2;
+  sim_sht21 *sim1, *sim2;
+  uint32_t wr;
+  float rh;
+
+  setup();
+  sim_i2c_add_mux(ESP_SHT21_MUX_ADDRESS);
+  sim1 = sim_i2c_add_sht21(ESP_SHT21_ADDRESS, 0);
+  sim2 = sim_i2c_add_sht21(ESP_SHT21_ADDRESS, 3);
+  sim1->rh_m = 30000;
+  sim2->rh_m = 70000;
+  dev1 = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+  dev2 = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+  esp_sht21_set_mux(dev1, ESP_SHT21_MUX_ADDRESS, 0);
+  esp_sht21_set_mux(dev2, ESP_SHT21_MUX_ADDRESS, 3);
+
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_rh(dev1, &rh));
+  TEST_CHECK(fabsf(rh - 30.0f) < RH_STEP);
+  TEST_EQ(0x01, sim_i2c_mux_mask());
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_rh(dev2, &rh));
+  TEST_CHECK(fabsf(rh - 70.0f) < RH_STEP);
+  TEST_EQ(0x08, sim_i2c_mux_mask());
+
+  // Channel is switched only when needed.
+  wr = sim_i2c_st.bytes_wr;
+  TEST_EQ(ESP_I2C_OK, esp_sht21_get_rh(dev2, &rh));
+  TEST_EQ(3, sim_i2c_st.bytes_wr - wr);
+
+  os_free(dev1);
+  os_free(dev2);
+}
+
+// Round-robin skips devices busy with their own measurement.
+static void
+test_rr(void)
+{
+  esp_sht21_dev *devs[4];
+  esp_sht21_rr *rr;
+  uint8_t idx;
+
+  setup();
+  sim_i2c_add_mux(ESP_SHT21_MUX_ADDRESS);
+  for (idx = 0; idx < 4; idx++) {
+    sim_i2c_add_sht21(ESP_SHT21_ADDRESS, (int8_t) idx)->rh_m = 40000 + idx * 5000;
+    devs[idx] = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+    esp_sht21_set_mux(devs[idx], ESP_SHT21_MUX_ADDRESS, (int8_t) idx);
+  }
+
+  TEST_CHECK(esp_sht21_rr_new(devs, ESP_SHT21_RR_MAX + 1) == NULL);
+  rr = esp_sht21_rr_new(devs, 4);
+
+  TEST_CHECK(esp_sht21_get_temp_async(devs[1]));
+  TEST_CHECK(esp_sht21_rr_start(rr, ESP_SHT21_RH_NHM));
+  TEST_EQ(0xD, rr->started);
+  TEST_EQ(3, rr->busy);
+  TEST_EQ(0, sim_eb_count(ESP_SHT21_EV_ERROR));
+
+  TEST_CHECK(sim_run_until(rr_done, 500));
+  TEST_EQ(0, rr->started);
+  TEST_EQ(0, rr->busy);
+  for (idx = 0; idx < 4; idx++) {
+    if (idx == 1) continue;
+    TEST_CHECK(fabsf(devs[idx]->meas.value - (40.0f + idx * 5.0f)) < RH_STEP);
+  }
+
+  // Device's own measurement finishes on its own timer.
+  sim_run_ms(200);
+  TEST_EQ(4, sim_eb_count(ESP_SHT21_EV_READY));
+  TEST_CHECK(fabsf(devs[1]->meas.value - 21.0f) < 0.02f);
+  TEST_EQ(0, sim_timers_armed());
+
+  for (idx = 0; idx < 4; idx++) os_free(devs[idx]);
+  os_free(rr);
+  TEST_EQ(0, sim_heap.live);
+}
+
+static void
+test_cost(void)
+{
+  esp_sht21_dev *dev;
+  esp_sht21_smpl smpl;
+  uint8_t sn[8];
+  uint8_t val;
+  bool on;
+  float f;
+  cost c;
+
+  setup();
+  sim_i2c_add_sht21(ESP_SHT21_ADDRESS, -1);
+  dev = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+
+  cost_header();
+  cost_start(&c, "get_rh");
+  esp_sht21_get_rh(dev, &f);
+  cost_print(&c);
+  cost_start(&c, "get_temp");
+  esp_sht21_get_temp(dev, &f);
+  cost_print(&c);
+  cost_start(&c, "get_temp_last");
+  esp_sht21_get_temp_last(dev, &f);
+  cost_print(&c);
+  cost_start(&c, "sample");
+  esp_sht21_sample(dev, &smpl);
+  cost_print(&c);
+  cost_start(&c, "get_rh_async");
+  esp_sht21_get_rh_async(dev);
+  sim_run_until(meas_done, 200);
+  cost_print(&c);
+  cost_start(&c, "get_sn");
+  esp_sht21_get_sn(dev, sn);
+  cost_print(&c);
+  cost_start(&c, "get_rev");
+  esp_sht21_get_rev(dev, &val);
+  cost_print(&c);
+  cost_start(&c, "res_get (cold)");
+  esp_sht21_res_get(dev, &val);
+  cost_print(&c);
+  cost_start(&c, "res_get (shadow)");
+  esp_sht21_res_get(dev, &val);
+  cost_print(&c);
+  cost_start(&c, "res_set");
+  esp_sht21_res_set(dev, ESP_SHT21_RES2);
+  cost_print(&c);
+  cost_start(&c, "heater_set");
+  esp_sht21_heater_set(dev, true, 3);
+  cost_print(&c);
+  cost_start(&c, "heater_get");
+  esp_sht21_heater_get(dev, &on, &val);
+  cost_print(&c);
+  cost_start(&c, "refresh");
+  esp_sht21_refresh(dev);
+  cost_print(&c);
+
+  os_free(dev);
+}
+
+// Humidity and temperature sample: two calls versus esp_sht21_sample.
+static void
+test_sample_bench(void)
+{
+  esp_sht21_dev *dev;
+  esp_sht21_smpl smpl;
+  sim_i2c_stats old, new;
+  sim_i2c_stats before;
+  float rh, temp;
+  uint16_t idx;
+  uint16_t n = 100;
+
+  setup();
+  sim_i2c_add_sht21(ESP_SHT21_ADDRESS, -1);
+  dev = esp_sht21_new_dev(SCL, SDA, ESP_SHT21_ADDRESS);
+
+  before = sim_i2c_st;
+  for (idx = 0; idx < n; idx++) {
+    esp_sht21_get_rh(dev, &rh);
+    esp_sht21_get_temp_last(dev, &temp);
+  }
+  old = sim_i2c_st;
+  old.starts -= before.starts;
+  old.stops -= before.stops;
+  old.bytes_wr -= before.bytes_wr;
+  old.bytes_rd -= before.bytes_rd;
+  old.bus_ns -= before.bus_ns;
+
+  before = sim_i2c_st;
+  for (idx = 0; idx < n; idx++) {
+    TEST_EQ(ESP_I2C_OK, esp_sht21_sample(dev, &smpl));
+  }
+  new = sim_i2c_st;
+  new.starts -= before.starts;
+  new.stops -= before.stops;
+  new.bytes_wr -= before.bytes_wr;
+  new.bytes_rd -= before.bytes_rd;
+  new.bus_ns -= before.bus_ns;
+
+  TEST_CHECK(smpl.rh == rh);
+  TEST_CHECK(smpl.temp == temp);
+
+  printf("  %-26s %6s %5s %6s %8s\n", "per sample", "START", "STOP", "bytes", "bus us");
+  printf("  %-26s %6.1f %5.1f %6.1f %8.1f\n", "get_rh + get_temp_last",
+         (double) old.starts / n, (double) old.stops / n,
+         (double) (old.bytes_wr + old.bytes_rd) / n, (double) old.bus_ns / 1e3 / n);
+  printf("  %-26s %6.1f %5.1f %6.1f %8.1f\n", "sample",
+         (double) new.starts / n, (double) new.stops / n,
+         (double) (new.bytes_wr + new.bytes_rd) / n, (double) new.bus_ns / 1e3 / n);
+
+  // One transaction: bus is never released between the two reads.
+  TEST_EQ(n, new.stops);
+  TEST_EQ(2 * n, old.stops);
+  TEST_CHECK(new.starts <= old.starts);
+  TEST_CHECK(new.bytes_wr + new.bytes_rd <= old.bytes_wr + old.bytes_rd);
+  TEST_CHECK(new.bus_ns < old.bus_ns);
+
+  os_free(dev);
+}
+
+int
+main(void)
+{
+  TEST_RUN(test_measure);
+  TEST_RUN(test_sample);
+  TEST_RUN(test_async);
+  TEST_RUN(test_registers);
+  TEST_RUN(test_mux);
+  TEST_RUN(test_rr);
+  TEST_RUN(test_cost);
+  TEST_RUN(test_sample_bench);
+
+  return test_done();
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <esp_eb.h>
+#include <string.h>
+
+// Maximum number of distinct events and callbacks.
+#define EB_MAX 32
+
+typedef struct {
+  const char *event;
+  esp_eb_cb *cb;      // The callback or NULL.
+  uint32_t cnt;       // Trigger count.
+  void *arg;          // Last argument.
+} eb_entry;
+
+static eb_entry entries[EB_MAX];
+
+
+static eb_entry *
+find(const char *event, bool create)
+{
+  uint8_t idx;
+
+  for (idx = 0; idx < EB_MAX; idx++) {
+    if (entries[idx].event != NULL && strcmp(entries[idx].event, event) == 0) {
+      return &entries[idx];
+    }
+  }
+
+  if (!create) return NULL;
+
+  for (idx = 0; idx < EB_MAX; idx++) {
+    if (entries[idx].event == NULL) {
+      entries[idx].event = event;
+      return &entries[idx];
+    }
+  }
+
+  return NULL;
+}
+
+void
+esp_eb_attach(const char *event, esp_eb_cb *cb)
+{
+  eb_entry *entry = find(event, true);
+  if (entry != NULL) entry->cb = cb;
+}
+
+void
+esp_eb_detach(const char *event)
+{
+  eb_entry *entry = find(event, false);
+  if (entry != NULL) entry->cb = NULL;
+}
+
+void
+esp_eb_trigger(const char *event, void *arg)
+{
+  eb_entry *entry = find(event, true);
+  if (entry == NULL) return;
+
+  entry->cnt++;
+  entry->arg = arg;
+  if (entry->cb != NULL) entry->cb(event, arg);
+}
+
+uint32_t
+sim_eb_count(const char *event)
+{
+  eb_entry *entry = find(event, false);
+
+  return entry == NULL ? 0 : entry->cnt;
+}
+
+void *
+sim_eb_arg(const char *event)
+{
+  eb_entry *entry = find(event, false);
+
+  return entry == NULL ? NULL : entry->arg;
+}
+
+void
+sim_eb_reset(void)
+{
+  memset(entries, 0, sizeof(entries));
+}
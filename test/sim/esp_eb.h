@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of esp_eb event bus.
+//
+// Events are dispatched synchronously and counted.
+
+#ifndef ESP_EB_H
+#define ESP_EB_H
+
+#include <c_types.h>
+
+typedef void (esp_eb_cb)(const char *event, void *arg);
+
+
+/**
+ * Attach callback to the event.
+ *
+ * @param event The event name.
+ * @param cb    The callback.
+ */
+void
+esp_eb_attach(const char *event, esp_eb_cb *cb);
+
+/**
+ * Detach all callbacks from the event.
+ *
+ * @param event The event name.
+ */
+void
+esp_eb_detach(const char *event);
+
+/**
+ * Trigger the event.
+ *
+ * @param event The event name.
+ * @param arg   The argument passed to callbacks.
+ */
+void
+esp_eb_trigger(const char *event, void *arg);
+
+/**
+ * Get the number of times event was triggered since last sim_eb_reset.
+ *
+ * @param event The event name.
+ *
+ * @return The count.
+ */
+uint32_t
+sim_eb_count(const char *event);
+
+/**
+ * Get the last argument the event was triggered with.
+ *
+ * @param event The event name.
+ *
+ * @return The argument or NULL.
+ */
+void *
+sim_eb_arg(const char *event);
+
+/**
+ * Reset event counters and detach all callbacks.
+ */
+void
+sim_eb_reset(void);
+
+#endif //ESP_EB_H
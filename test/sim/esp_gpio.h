@@ -0,0 +1,41 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of esp_gpio library.
+//
+// GPIO registers are backed by simulated open drain lines (see sim.h).
+
+#ifndef ESP_GPIO_H
+#define ESP_GPIO_H
+
+#include <c_types.h>
+#include <sim.h>
+
+#define GPIO_IN (sim_gpio_read())
+#define GPIO_OUT_EN_S (*sim_gpio_out_en(true))
+#define GPIO_OUT_EN_C (*sim_gpio_out_en(false))
+
+typedef enum {
+  GPIO_MODE_INPUT,
+  GPIO_MODE_INPUT_PULLUP,
+  GPIO_MODE_OUTPUT,
+} esp_gpio_mode;
+
+
+void esp_gpio_setup(uint8_t gpio_num, esp_gpio_mode mode);
+
+#endif //ESP_GPIO_H
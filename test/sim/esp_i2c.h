@@ -0,0 +1,53 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of esp_i2c library.
+//
+// Bus operations are served by simulated slaves (see sim_i2c.h).
+
+#ifndef ESP_I2C_H
+#define ESP_I2C_H
+
+#include <c_types.h>
+
+// Address byte for writing.
+#define ESP_I2C_ADDR_WRITE(addr) ((uint8_t) ((addr) << 1))
+// Address byte for reading.
+#define ESP_I2C_ADDR_READ(addr) ((uint8_t) (((addr) << 1) | 0x1))
+
+typedef enum {
+  ESP_I2C_OK,
+  ESP_I2C_ERR_NO_ACK,
+  ESP_I2C_ERR_DATA_CORRUPTED,
+} esp_i2c_err;
+
+
+esp_i2c_err esp_i2c_init(uint8_t gpio_scl, uint8_t gpio_sda);
+
+esp_i2c_err esp_i2c_start_read_write(uint8_t addr, bool check_ack);
+
+esp_i2c_err esp_i2c_start_read(uint8_t addr, uint8_t reg);
+
+esp_i2c_err esp_i2c_start_write(uint8_t addr, uint8_t reg);
+
+esp_i2c_err esp_i2c_write_bytes(uint8_t *buf, uint16_t len);
+
+esp_i2c_err esp_i2c_read_bytes(uint8_t *buf, uint16_t len);
+
+esp_i2c_err esp_i2c_stop(void);
+
+#endif //ESP_I2C_H
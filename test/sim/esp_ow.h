@@ -0,0 +1,78 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of esp_ow OneWire library.
+//
+// Bus operations are served by simulated devices (see sim_ow.h).
+
+#ifndef ESP_OW_H
+#define ESP_OW_H
+
+#include <c_types.h>
+
+// OneWire ROM commands.
+typedef enum {
+  ESP_OW_CMD_SEARCH_ROM = 0xF0,
+  ESP_OW_CMD_SEARCH_ROM_ALERT = 0xEC,
+  ESP_OW_CMD_READ_ROM = 0x33,
+  ESP_OW_CMD_MATCH_ROM = 0x55,
+  ESP_OW_CMD_SKIP_ROM = 0xCC,
+} esp_ow_cmd;
+
+typedef enum {
+  ESP_OW_OK,
+  ESP_OW_ERR_NO_DEV,
+  ESP_OW_ERR_BAD_CRC,
+  ESP_OW_ERR_MEM,
+} esp_ow_err;
+
+// OneWire device.
+typedef struct esp_ow_device {
+  uint8_t rom[8];             // The ROM address.
+  uint8_t gpio_num;           // The GPIO where OneWire bus is connected.
+  void *custom;               // The device driver data.
+  struct esp_ow_device *next; // The next device on the list.
+} esp_ow_device;
+
+
+void esp_ow_init(uint8_t gpio_num);
+
+bool esp_ow_reset(uint8_t gpio_num);
+
+void esp_ow_write(uint8_t gpio_num, uint8_t byte);
+
+void esp_ow_write_bytes(uint8_t gpio_num, uint8_t *buf, uint16_t len);
+
+void esp_ow_write_bit(uint8_t gpio_num, uint8_t bit);
+
+uint8_t esp_ow_read(uint8_t gpio_num);
+
+void esp_ow_read_bytes(uint8_t gpio_num, uint8_t *buf, uint16_t len);
+
+uint8_t esp_ow_read_bit(uint8_t gpio_num);
+
+void esp_ow_match_dev(esp_ow_device *device);
+
+esp_ow_device *esp_ow_new_dev(uint8_t *rom);
+
+esp_ow_device *esp_ow_read_rom_dev(uint8_t gpio_num);
+
+esp_ow_err esp_ow_search_family(uint8_t gpio_num, esp_ow_cmd cmd, uint8_t family, esp_ow_device **list);
+
+void esp_ow_free_device_list(esp_ow_device *list, bool free_custom);
+
+#endif //ESP_OW_H
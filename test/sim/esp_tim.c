@@ -0,0 +1,71 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <esp_tim.h>
+#include <mem.h>
+
+uint32_t esp_tim_started;
+
+
+static void
+tim_fire(void *arg)
+{
+  esp_tim_timer *timer = arg;
+
+  timer->again = false;
+  timer->cb(timer);
+
+  // Timer not continued is done.
+  if (!timer->again) os_free(timer);
+}
+
+esp_tim_timer *
+esp_tim_start_delay(os_timer_func_t *cb, void *payload, uint32_t delay)
+{
+  esp_tim_timer *timer = os_zalloc(sizeof(esp_tim_timer));
+  if (timer == NULL) return NULL;
+
+  timer->cb = cb;
+  timer->payload = payload;
+  timer->delay = delay;
+  esp_tim_started++;
+
+  os_timer_setfn(&timer->timer, tim_fire, timer);
+  os_timer_arm(&timer->timer, delay, false);
+
+  return timer;
+}
+
+esp_tim_timer *
+esp_tim_start(os_timer_func_t *cb, void *payload)
+{
+  return esp_tim_start_delay(cb, payload, 0);
+}
+
+void
+esp_tim_continue(esp_tim_timer *timer)
+{
+  timer->again = true;
+  os_timer_arm(&timer->timer, timer->delay, false);
+}
+
+void
+esp_tim_stop(esp_tim_timer *timer)
+{
+  os_timer_disarm(&timer->timer);
+  os_free(timer);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Host replacement of esp_tim library running on simulated os_timer.
+
+#ifndef ESP_TIM_H
+#define ESP_TIM_H
+
+#include <c_types.h>
+#include <osapi.h>
+
+// Timer passed to the callback as its argument.
+typedef struct {
+  os_timer_t timer;     // The SDK timer.
+  os_timer_func_t *cb;  // The user callback.
+  void *payload;        // The user payload.
+  uint32_t delay;       // The delay used by esp_tim_continue in ms.
+  bool again;           // Is true when callback called esp_tim_continue.
+} esp_tim_timer;
+
+// Number of timers started by esp_tim_start* since last sim_reset.
+extern uint32_t esp_tim_started;
+
+
+/**
+ * Run callback as soon as possible.
+ *
+ * @param cb      The callback. Gets esp_tim_timer as the argument.
+ * @param payload The payload.
+ *
+ * @return The timer or NULL on error.
+ */
+esp_tim_timer *
+esp_tim_start(os_timer_func_t *cb, void *payload);
+
+/**
+ * Run callback after delay.
+ *
+ * @param cb      The callback. Gets esp_tim_timer as the argument.
+ * @param payload The payload.
+ * @param delay   The delay in milliseconds.
+ *
+ * @return The timer or NULL on error.
+ */
+esp_tim_timer *
+esp_tim_start_delay(os_timer_func_t *cb, void *payload, uint32_t delay);
+
+/**
+ * Run the callback again after timer->delay.
+ *
+ * Must be called from the callback.
+ *
+ * @param timer The timer.
+ */
+void
+esp_tim_continue(esp_tim_timer *timer);
+
+/**
+ * Stop and release the timer.
+ *
+ * @param timer The timer.
+ */
+void
+esp_tim_stop(esp_tim_timer *timer);
+
+#endif //ESP_TIM_H
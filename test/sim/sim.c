@@ -0,0 +1,545 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "sim.h"
+#include <esp_tim.h>
+#include <esp_eb.h>
+#include <mem.h>
+#include <osapi.h>
+#include <user_interface.h>
+#include <stdlib.h>
+
+// RTC memory size in 4 byte blocks and the first user block.
+#define RTC_BLOCKS 192
+#define RTC_USER_BLOCK 64
+
+// Allocation header keeping allocation size.
+typedef struct {
+  size_t size;
+  size_t pad;
+} heap_hdr;
+
+uint64_t sim_now_ns;
+sim_heap_st sim_heap;
+uint32_t sim_gpio_sample_ns;
+
+// Armed timers sorted by expiration time.
+static os_timer_t *timers;
+// Event sources.
+static sim_source *sources;
+// RTC memory.
+static uint8_t rtc[RTC_BLOCKS * 4];
+static bool rtc_fail;
+// GPIO interrupt.
+static uint32_t gpio_status;
+static sim_isr_t *gpio_isr;
+static void *gpio_isr_arg;
+static bool gpio_isr_on;
+static GPIO_INT_TYPE gpio_intr[17];
+// GPIO lines. Open drain with pull-up: low when the host or a device drives it.
+static uint32_t gpio_dev_low;
+static uint32_t gpio_out_en;
+static uint32_t gpio_out_en_w1ts;
+static uint32_t gpio_out_en_w1tc;
+static sim_gpio_watch_cb *gpio_watch;
+static void *gpio_watch_ctx;
+
+
+void
+sim_reset(void)
+{
+  sim_now_ns = 1000000000ULL;
+  memset(&sim_heap, 0, sizeof(sim_heap));
+  memset(rtc, 0, sizeof(rtc));
+  memset(gpio_intr, 0, sizeof(gpio_intr));
+
+  while (timers) {
+    timers->armed = false;
+    timers = timers->next;
+  }
+
+  sources = NULL;
+  esp_tim_started = 0;
+  sim_eb_reset();
+  rtc_fail = false;
+  gpio_status = 0;
+  gpio_isr = NULL;
+  gpio_isr_arg = NULL;
+  gpio_isr_on = false;
+  gpio_dev_low = 0;
+  gpio_out_en = 0;
+  gpio_out_en_w1ts = 0;
+  gpio_out_en_w1tc = 0;
+  gpio_watch = NULL;
+  gpio_watch_ctx = NULL;
+  sim_gpio_sample_ns = 0;
+}
+
+/**
+ * Find the earliest event source.
+ *
+ * @param when Set to the event time.
+ *
+ * @return The source or NULL.
+ */
+static sim_source *
+source_next(uint64_t *when)
+{
+  uint64_t t;
+  sim_source *src;
+  sim_source *best = NULL;
+
+  *when = UINT64_MAX;
+  for (src = sources; src; src = src->next) {
+    t = src->next_ns(src->ctx);
+    if (t < *when) {
+      *when = t;
+      best = src;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * Fire all event sources due before the time.
+ *
+ * @param until The time in ns.
+ */
+static void
+sources_fire(uint64_t until)
+{
+  uint64_t when;
+  sim_source *src;
+
+  while ((src = source_next(&when)) != NULL && when <= until) {
+    if (when > sim_now_ns) sim_now_ns = when;
+    src->fire(src->ctx);
+  }
+}
+
+// Latch GPIO interrupt status for lines which changed.
+static void
+gpio_edges(uint32_t before, uint32_t after)
+{
+  uint32_t pin;
+  uint32_t mask = 0;
+  GPIO_INT_TYPE type;
+
+  for (pin = 0; pin < 17; pin++) {
+    if (((before ^ after) & BIT(pin)) == 0) continue;
+    type = gpio_intr[pin];
+    if (type == GPIO_PIN_INTR_ANYEDGE
+        || (type == GPIO_PIN_INTR_NEGEDGE && (after & BIT(pin)) == 0)
+        || (type == GPIO_PIN_INTR_POSEDGE && (after & BIT(pin)) != 0)) {
+      mask |= BIT(pin);
+    }
+  }
+
+  if (mask) sim_gpio_raise(mask);
+}
+
+/**
+ * Apply GPIO output enable writes made since the last call.
+ *
+ * Registers are written through pointers (see esp_gpio.h) so writes are
+ * applied lazily on the next simulator call. No virtual time passes
+ * between the two.
+ */
+static void
+gpio_sync(void)
+{
+  uint32_t before = sim_gpio_in();
+  uint32_t changed;
+  uint32_t pin;
+
+  if (gpio_out_en_w1ts == 0 && gpio_out_en_w1tc == 0) return;
+
+  changed = gpio_out_en;
+  gpio_out_en |= gpio_out_en_w1ts;
+  gpio_out_en &= ~gpio_out_en_w1tc;
+  gpio_out_en_w1ts = 0;
+  gpio_out_en_w1tc = 0;
+  changed ^= gpio_out_en;
+
+  for (pin = 0; pin < 17 && gpio_watch; pin++) {
+    if (changed & BIT(pin)) gpio_watch((uint8_t) pin, (gpio_out_en & BIT(pin)) != 0, gpio_watch_ctx);
+  }
+
+  gpio_edges(before, sim_gpio_in());
+}
+
+void
+sim_advance_ns(uint64_t ns)
+{
+  uint64_t until;
+
+  gpio_sync();
+  until = sim_now_ns + ns;
+
+  sources_fire(until);
+  sim_now_ns = until;
+}
+
+static void
+timer_insert(os_timer_t *timer)
+{
+  os_timer_t **curr = &timers;
+
+  while (*curr && (*curr)->expire_ns <= timer->expire_ns) curr = &(*curr)->next;
+
+  timer->next = *curr;
+  timer->armed = true;
+  *curr = timer;
+}
+
+static void
+timer_remove(os_timer_t *timer)
+{
+  os_timer_t **curr = &timers;
+
+  while (*curr && *curr != timer) curr = &(*curr)->next;
+  if (*curr) *curr = timer->next;
+
+  timer->armed = false;
+  timer->next = NULL;
+}
+
+/**
+ * Run the first timer or event source due before the time.
+ *
+ * @param until The time in ns.
+ *
+ * @return Returns true when something was run.
+ */
+static bool
+step(uint64_t until)
+{
+  uint64_t when;
+  os_timer_t *timer;
+  sim_source *src;
+
+  gpio_sync();
+  timer = timers;
+  src = source_next(&when);
+
+  if (src != NULL && when <= until && (timer == NULL || when < timer->expire_ns)) {
+    if (when > sim_now_ns) sim_now_ns = when;
+    src->fire(src->ctx);
+    return true;
+  }
+
+  if (timer == NULL || timer->expire_ns > until) return false;
+
+  if (timer->expire_ns > sim_now_ns) sim_now_ns = timer->expire_ns;
+  timer_remove(timer);
+  if (timer->repeat) {
+    timer->expire_ns = sim_now_ns + (uint64_t) timer->period_ms * 1000000ULL;
+    timer_insert(timer);
+  }
+
+  timer->func(timer->arg);
+
+  return true;
+}
+
+void
+sim_run_ms(uint32_t ms)
+{
+  uint64_t until = sim_now_ns + (uint64_t) ms * 1000000ULL;
+
+  while (step(until));
+  if (sim_now_ns < until) sim_now_ns = until;
+}
+
+bool
+sim_run_until(bool (*done)(void), uint32_t max_ms)
+{
+  uint64_t until = sim_now_ns + (uint64_t) max_ms * 1000000ULL;
+
+  while (!done()) {
+    if (!step(until)) return done();
+  }
+
+  return true;
+}
+
+uint32_t
+sim_timers_armed(void)
+{
+  uint32_t cnt = 0;
+  os_timer_t *timer;
+
+  for (timer = timers; timer; timer = timer->next) cnt++;
+
+  return cnt;
+}
+
+void
+sim_source_add(sim_source *src)
+{
+  src->next = sources;
+  sources = src;
+}
+
+void
+sim_source_del(sim_source *src)
+{
+  sim_source **curr = &sources;
+
+  while (*curr && *curr != src) curr = &(*curr)->next;
+  if (*curr) *curr = src->next;
+}
+
+// Heap.
+
+void *
+sim_malloc(size_t size)
+{
+  heap_hdr *hdr = malloc(sizeof(heap_hdr) + size);
+  if (hdr == NULL) return NULL;
+
+  hdr->size = size;
+  sim_heap.allocs++;
+  sim_heap.live++;
+  sim_heap.bytes += size;
+  if (sim_heap.bytes > sim_heap.high) sim_heap.high = sim_heap.bytes;
+
+  return hdr + 1;
+}
+
+void *
+sim_zalloc(size_t size)
+{
+  void *ptr = sim_malloc(size);
+  if (ptr != NULL) memset(ptr, 0, size);
+
+  return ptr;
+}
+
+void
+sim_free(void *ptr)
+{
+  heap_hdr *hdr;
+
+  if (ptr == NULL) return;
+
+  hdr = (heap_hdr *) ptr - 1;
+  sim_heap.frees++;
+  sim_heap.live--;
+  sim_heap.bytes -= hdr->size;
+  free(hdr);
+}
+
+// SDK.
+
+void
+os_timer_setfn(os_timer_t *timer, os_timer_func_t *func, void *arg)
+{
+  timer->func = func;
+  timer->arg = arg;
+}
+
+void
+os_timer_arm(os_timer_t *timer, uint32_t ms, bool repeat)
+{
+  if (timer->armed) timer_remove(timer);
+
+  timer->period_ms = ms;
+  timer->repeat = repeat;
+  timer->expire_ns = sim_now_ns + (uint64_t) ms * 1000000ULL;
+  timer_insert(timer);
+}
+
+void
+os_timer_disarm(os_timer_t *timer)
+{
+  if (timer->armed) timer_remove(timer);
+}
+
+void
+os_delay_us(uint32_t us)
+{
+  sim_advance_ns((uint64_t) us * 1000ULL);
+}
+
+uint32_t
+system_get_time(void)
+{
+  gpio_sync();
+  return (uint32_t) (sim_now_ns / 1000ULL);
+}
+
+uint8_t
+system_get_cpu_freq(void)
+{
+  return SIM_CPU_MHZ;
+}
+
+uint32_t
+esp_stats_ccount(void)
+{
+  return (uint32_t) (sim_now_ns * SIM_CPU_MHZ / 1000ULL);
+}
+
+void
+sim_rtc_fail(bool fail)
+{
+  rtc_fail = fail;
+}
+
+/**
+ * Validate RTC user memory access.
+ *
+ * @param block The first block.
+ * @param size  The number of bytes.
+ *
+ * @return Returns true when access is valid.
+ */
+static bool
+rtc_valid(uint8_t block, uint16_t size)
+{
+  if (rtc_fail) return false;
+  if (block < RTC_USER_BLOCK || (size & 0x3) != 0) return false;
+
+  return block * 4 + size <= RTC_BLOCKS * 4;
+}
+
+bool
+system_rtc_mem_read(uint8_t src_addr, void *des_addr, uint16_t load_size)
+{
+  if (!rtc_valid(src_addr, load_size)) return false;
+
+  memcpy(des_addr, &rtc[src_addr * 4], load_size);
+
+  return true;
+}
+
+bool
+system_rtc_mem_write(uint8_t des_addr, const void *src_addr, uint16_t save_size)
+{
+  if (!rtc_valid(des_addr, save_size)) return false;
+
+  memcpy(&rtc[des_addr * 4], src_addr, save_size);
+
+  return true;
+}
+
+// GPIO.
+
+uint32_t
+GPIO_REG_READ(uint32_t reg)
+{
+  return reg == GPIO_STATUS_ADDRESS ? gpio_status : 0;
+}
+
+void
+GPIO_REG_WRITE(uint32_t reg, uint32_t val)
+{
+  if (reg == GPIO_STATUS_W1TC_ADDRESS) gpio_status &= ~val;
+  if (reg == GPIO_STATUS_W1TS_ADDRESS) gpio_status |= val;
+}
+
+void
+gpio_pin_intr_state_set(uint32_t pin, GPIO_INT_TYPE type)
+{
+  if (pin < 17) gpio_intr[pin] = type;
+}
+
+GPIO_INT_TYPE
+sim_gpio_intr_type(uint8_t pin)
+{
+  return pin < 17 ? gpio_intr[pin] : GPIO_PIN_INTR_DISABLE;
+}
+
+void
+sim_gpio_isr_attach(sim_isr_t *isr, void *arg)
+{
+  gpio_isr = isr;
+  gpio_isr_arg = arg;
+}
+
+void
+sim_gpio_isr_enable(bool enable)
+{
+  gpio_isr_on = enable;
+  if (enable && gpio_status != 0 && gpio_isr != NULL) gpio_isr(gpio_isr_arg);
+}
+
+sim_isr_t *
+sim_gpio_isr(void)
+{
+  return gpio_isr;
+}
+
+void
+sim_gpio_raise(uint32_t mask)
+{
+  gpio_status |= mask;
+  if (gpio_isr_on && gpio_isr != NULL) gpio_isr(gpio_isr_arg);
+}
+
+void
+sim_gpio_set(uint8_t pin, bool level)
+{
+  uint32_t before = sim_gpio_in();
+
+  if (level) {
+    gpio_dev_low &= ~BIT(pin);
+  } else {
+    gpio_dev_low |= BIT(pin);
+  }
+
+  gpio_edges(before, sim_gpio_in());
+}
+
+uint32_t
+sim_gpio_in(void)
+{
+  return ~(gpio_dev_low | gpio_out_en) & 0x1FFFF;
+}
+
+uint32_t
+sim_gpio_read(void)
+{
+  gpio_sync();
+
+  return sim_gpio_in();
+}
+
+bool
+sim_gpio_sample(uint8_t pin)
+{
+  if (sim_gpio_sample_ns) sim_advance_ns(sim_gpio_sample_ns);
+
+  return (sim_gpio_read() & BIT(pin)) != 0;
+}
+
+uint32_t *
+sim_gpio_out_en(bool set)
+{
+  gpio_sync();
+
+  return set ? &gpio_out_en_w1ts : &gpio_out_en_w1tc;
+}
+
+void
+sim_gpio_watch(sim_gpio_watch_cb *cb, void *ctx)
+{
+  gpio_watch = cb;
+  gpio_watch_ctx = ctx;
+}
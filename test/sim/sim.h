@@ -0,0 +1,228 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// ESP8266 host simulator core.
+//
+// Virtual clock, os_timer queue, counted heap, RTC user memory and
+// GPIO interrupt. Device models (sim_ow.h, sim_i2c.h, sim_dht22.h)
+// are built on top of it.
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <c_types.h>
+#include <gpio.h>
+
+// Simulated CPU frequency in MHz.
+#define SIM_CPU_MHZ 80
+
+// Heap statistics.
+typedef struct {
+  uint32_t allocs;  // Number of allocations.
+  uint32_t frees;   // Number of releases.
+  uint32_t live;    // Number of not released allocations.
+  size_t bytes;     // Bytes currently allocated.
+  size_t high;      // Heap high-water mark in bytes.
+} sim_heap_st;
+
+// Event source interleaved with timers (for example waveform edges).
+typedef struct sim_source {
+  // Returns time of the next event in ns or UINT64_MAX when none.
+  uint64_t (*next_ns)(void *ctx);
+  // Fires the event. Called with the virtual clock at next_ns.
+  void (*fire)(void *ctx);
+  void *ctx;
+  struct sim_source *next;
+} sim_source;
+
+// Called when the host starts or stops driving GPIO low.
+typedef void (sim_gpio_watch_cb)(uint8_t pin, bool low, void *ctx);
+
+// The virtual clock in nanoseconds.
+extern uint64_t sim_now_ns;
+// The heap statistics.
+extern sim_heap_st sim_heap;
+// CPU time of one sim_gpio_sample call in nanoseconds.
+extern uint32_t sim_gpio_sample_ns;
+
+
+/**
+ * Reset the simulator.
+ *
+ * Clock starts at 1s, all timers and event sources are dropped, heap
+ * statistics, RTC memory and esp_eb events are cleared. Memory still
+ * allocated is not released.
+ */
+void
+sim_reset(void);
+
+/**
+ * Advance the virtual clock without running timers.
+ *
+ * Used for busy CPU (bit-banged bus transactions, os_delay_us).
+ * Event sources due in that time fire (GPIO interrupts are not masked
+ * by busy wait).
+ *
+ * @param ns The number of nanoseconds.
+ */
+void
+sim_advance_ns(uint64_t ns);
+
+/**
+ * Run timers and event sources for given virtual time.
+ *
+ * @param ms The number of milliseconds.
+ */
+void
+sim_run_ms(uint32_t ms);
+
+/**
+ * Run timers and event sources until the condition is true.
+ *
+ * @param done   The condition.
+ * @param max_ms The maximum virtual time to run.
+ *
+ * @return Returns true when condition became true, false on timeout.
+ */
+bool
+sim_run_until(bool (*done)(void), uint32_t max_ms);
+
+/**
+ * Get the number of armed timers.
+ *
+ * @return The number of timers.
+ */
+uint32_t
+sim_timers_armed(void);
+
+/**
+ * Add event source.
+ *
+ * @param src The source.
+ */
+void
+sim_source_add(sim_source *src);
+
+/**
+ * Remove event source.
+ *
+ * @param src The source.
+ */
+void
+sim_source_del(sim_source *src);
+
+/**
+ * Set GPIO interrupt status bits.
+ *
+ * Calls attached handler when GPIO interrupt is enabled.
+ *
+ * @param mask The status bits.
+ */
+void
+sim_gpio_raise(uint32_t mask);
+
+/**
+ * Get GPIO pin interrupt type set by the code under test.
+ *
+ * @param pin The pin.
+ *
+ * @return The interrupt type.
+ */
+GPIO_INT_TYPE
+sim_gpio_intr_type(uint8_t pin);
+
+/**
+ * Get attached GPIO interrupt handler.
+ *
+ * @return The handler or NULL.
+ */
+sim_isr_t *
+sim_gpio_isr(void);
+
+/**
+ * Set GPIO level driven by simulated device.
+ *
+ * Lines are open drain with pull-up. Edges latch GPIO interrupt
+ * status according to the pin interrupt type.
+ *
+ * @param pin   The pin.
+ * @param level Set to false to drive the line low.
+ */
+void
+sim_gpio_set(uint8_t pin, bool level);
+
+/**
+ * Get GPIO line levels.
+ *
+ * @return The levels bit mask.
+ */
+uint32_t
+sim_gpio_in(void);
+
+/**
+ * Get GPIO line levels after applying host register writes.
+ *
+ * Backs GPIO_IN in esp_gpio.h.
+ *
+ * @return The levels bit mask.
+ */
+uint32_t
+sim_gpio_read(void);
+
+/**
+ * Sample GPIO line in a busy loop.
+ *
+ * Takes sim_gpio_sample_ns of virtual time to model the sampling loop
+ * overhead. Used to override drivers BUS_READ.
+ *
+ * @param pin The pin.
+ *
+ * @return The line level.
+ */
+bool
+sim_gpio_sample(uint8_t pin);
+
+/**
+ * Get GPIO output enable set or clear register.
+ *
+ * Backs GPIO_OUT_EN_S and GPIO_OUT_EN_C in esp_gpio.h.
+ *
+ * @param set Set to true for the set register.
+ *
+ * @return The register.
+ */
+uint32_t *
+sim_gpio_out_en(bool set);
+
+/**
+ * Watch host driving GPIO lines.
+ *
+ * @param cb  The callback or NULL.
+ * @param ctx The callback context.
+ */
+void
+sim_gpio_watch(sim_gpio_watch_cb *cb, void *ctx);
+
+/**
+ * Make next RTC memory read or write fail.
+ *
+ * @param fail Set to true to fail.
+ */
+void
+sim_rtc_fail(bool fail);
+
+#endif //SIM_H
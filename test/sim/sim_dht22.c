@@ -0,0 +1,145 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <sim_dht22.h>
+#include <esp_gpio.h>
+#include <string.h>
+
+
+// Add random deviation to state length.
+static uint64_t
+jit(sim_dht22 *dev, uint32_t us)
+{
+  int64_t ns = us * 1000LL;
+
+  if (dev->jitter_ns) {
+    dev->seed = dev->seed * 1103515245u + 12345u;
+    ns += (int64_t) ((dev->seed >> 8) % (2 * dev->jitter_ns + 1)) - dev->jitter_ns;
+  }
+
+  return (uint64_t) (ns < 1000 ? 1000 : ns);
+}
+
+static void
+frame_build(sim_dht22 *dev, uint8_t *data)
+{
+  uint16_t temp = (uint16_t) (dev->temp < 0 ? (-dev->temp) | 0x8000 : dev->temp);
+
+  data[0] = (uint8_t) (dev->hum >> 8);
+  data[1] = (uint8_t) dev->hum;
+  data[2] = (uint8_t) (temp >> 8);
+  data[3] = (uint8_t) temp;
+  data[4] = (uint8_t) (data[0] + data[1] + data[2] + data[3]);
+
+  if (dev->parity_errs) {
+    dev->parity_errs--;
+    data[4] ^= 0x01;
+  }
+}
+
+// Prepare waveform. Edges alternate falling and rising.
+static void
+waveform(sim_dht22 *dev)
+{
+  uint8_t data[5];
+  uint64_t t = sim_now_ns;
+  uint8_t idx;
+  bool one;
+
+  frame_build(dev, data);
+  dev->frames++;
+  dev->edge_cnt = 0;
+  dev->edge_idx = 0;
+
+  dev->edges[dev->edge_cnt++] = t += jit(dev, 30);
+  dev->edges[dev->edge_cnt++] = t += jit(dev, 80);
+  dev->edges[dev->edge_cnt++] = t += jit(dev, 80);
+  for (idx = 0; idx < 40; idx++) {
+    one = (data[idx >> 3] & (0x80 >> (idx & 0x7))) != 0;
+    dev->edges[dev->edge_cnt++] = t += jit(dev, 50);
+    dev->edges[dev->edge_cnt++] = t += jit(dev, one ? 70 : 26);
+  }
+  dev->edges[dev->edge_cnt++] = t + jit(dev, 50);
+}
+
+static void
+on_host(uint8_t pin, bool low, void *ctx)
+{
+  sim_dht22 *dev = ctx;
+
+  if (pin != dev->gpio_num) return;
+
+  if (low) {
+    // Host start signal aborts any transmission.
+    dev->low_ns = sim_now_ns;
+    dev->edge_cnt = 0;
+    sim_gpio_set(dev->gpio_num, true);
+    return;
+  }
+
+  if (dev->missing || sim_now_ns - dev->low_ns < SIM_DHT22_START_US * 1000ULL) return;
+
+  waveform(dev);
+}
+
+static uint64_t
+next_ns(void *ctx)
+{
+  sim_dht22 *dev = ctx;
+
+  return dev->edge_idx < dev->edge_cnt ? dev->edges[dev->edge_idx] : UINT64_MAX;
+}
+
+static void
+fire(void *ctx)
+{
+  sim_dht22 *dev = ctx;
+
+  // Even edges are falling.
+  sim_gpio_set(dev->gpio_num, (dev->edge_idx & 0x1) != 0);
+  dev->edge_idx++;
+}
+
+void
+sim_dht22_init(sim_dht22 *dev, uint8_t gpio_num)
+{
+  memset(dev, 0, sizeof(sim_dht22));
+  dev->gpio_num = gpio_num;
+  dev->hum = 500;
+  dev->temp = 210;
+  dev->seed = 1;
+  dev->src.next_ns = next_ns;
+  dev->src.fire = fire;
+  dev->src.ctx = dev;
+
+  sim_source_add(&dev->src);
+  sim_gpio_watch(on_host, dev);
+}
+
+void
+sim_dht22_free(sim_dht22 *dev)
+{
+  sim_source_del(&dev->src);
+  sim_gpio_watch(NULL, NULL);
+}
+
+void
+esp_gpio_setup(uint8_t gpio_num, esp_gpio_mode mode)
+{
+  (void) gpio_num;
+  (void) mode;
+}
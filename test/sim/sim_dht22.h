@@ -0,0 +1,78 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Simulated DHT22 (AM2302).
+//
+// Device answers start signal (line held low by the host for at least
+// 800us) with the response signal and 40 data bits. Every state of the
+// waveform can be randomly stretched or shortened to model timing jitter.
+//
+// Waveform after the host releases the line:
+//
+//   30us high, 80us low, 80us high,
+//   40 times: 50us low, 26us (bit 0) or 70us (bit 1) high,
+//   50us low, release.
+
+#ifndef SIM_DHT22_H
+#define SIM_DHT22_H
+
+#include <sim.h>
+
+// Minimum start signal length in microseconds.
+#define SIM_DHT22_START_US 800
+// Number of waveform edges.
+#define SIM_DHT22_EDGES 84
+
+// Simulated DHT22.
+typedef struct {
+  uint8_t gpio_num;    // The GPIO the device is connected to.
+  uint16_t hum;        // Humidity in 0.1 %.
+  int16_t temp;        // Temperature in 0.1 Celsius.
+  uint32_t jitter_ns;  // Maximum random deviation of every waveform state.
+  bool missing;        // Is true when device does not answer.
+  uint8_t parity_errs; // The number of next frames with bad parity.
+  uint32_t frames;     // The number of sent frames.
+
+  uint64_t low_ns;                       // Host started start signal.
+  uint64_t edges[SIM_DHT22_EDGES];       // Waveform edge times.
+  uint8_t edge_idx;                      // Next edge.
+  uint8_t edge_cnt;                      // Number of edges in waveform.
+  uint32_t seed;                         // Jitter random generator state.
+  sim_source src;
+} sim_dht22;
+
+
+/**
+ * Initialize device and connect it to the line.
+ *
+ * Only one device can be connected at a time.
+ *
+ * @param dev      The device.
+ * @param gpio_num The GPIO.
+ */
+void
+sim_dht22_init(sim_dht22 *dev, uint8_t gpio_num);
+
+/**
+ * Disconnect device from the line.
+ *
+ * @param dev The device.
+ */
+void
+sim_dht22_free(sim_dht22 *dev);
+
+#endif //SIM_DHT22_H
@@ -0,0 +1,482 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <sim.h>
+#include <sim_i2c.h>
+#include <esp_i2c.h>
+#include <string.h>
+
+// Maximum conversion times in ms indexed by resolution.
+static const uint8_t rh_conv_ms[4] = {29, 4, 9, 15};
+static const uint8_t temp_conv_ms[4] = {85, 22, 43, 11};
+// Measurement bits indexed by resolution.
+static const uint8_t rh_bits[4] = {12, 8, 10, 11};
+static const uint8_t temp_bits[4] = {14, 12, 13, 11};
+
+// Slave state in a transaction.
+typedef enum {
+  ST_IDLE,  // No transaction.
+  ST_ADDR,  // Waiting for address byte.
+  ST_WRITE, // Receiving bytes.
+  ST_READ,  // Sending bytes.
+  ST_NONE,  // Nobody acknowledged the address.
+} slave_state;
+
+sim_i2c_stats sim_i2c_st;
+
+static sim_sht21 devs[SIM_I2C_MAX_DEVS];
+static uint8_t dev_cnt;
+
+static bool mux_on;
+static uint8_t mux_addr;
+static uint8_t mux_mask;
+
+static slave_state state;
+static bool in_xfer;        // Is true between START and STOP.
+static sim_sht21 *target;   // Addressed SHT21 or NULL for the mux.
+static uint8_t cmd[2];      // Received command bytes.
+static uint8_t cmd_len;
+static uint8_t out[8];      // Bytes to send.
+static uint8_t out_len;
+static uint8_t out_idx;
+static uint8_t hm_cmd;      // Hold Master measurement to run on read header.
+
+
+static uint8_t
+crc8(uint8_t crc, const uint8_t *data, uint8_t len)
+{
+  uint8_t i;
+
+  while (len--) {
+    crc ^= *data++;
+    for (i = 0; i < 8; i++) crc = (uint8_t) (crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1);
+  }
+
+  return crc;
+}
+
+static void
+bus_time(uint64_t ns)
+{
+  sim_i2c_st.bus_ns += ns;
+  sim_advance_ns(ns);
+}
+
+static uint8_t
+dev_res(sim_sht21 *dev)
+{
+  return (uint8_t) (((dev->ur1 >> 6) & 0x2) | (dev->ur1 & 0x1));
+}
+
+static bool
+is_rh(uint8_t c)
+{
+  return c == 0xE5 || c == 0xF5;
+}
+
+static uint64_t
+conv_ns(sim_sht21 *dev, uint8_t c)
+{
+  uint8_t ms = is_rh(c) ? rh_conv_ms[dev_res(dev)] : temp_conv_ms[dev_res(dev)];
+
+  return (uint64_t) ms * 10000ULL * dev->conv_pct;
+}
+
+// Quantize 16 bit value to measurement resolution.
+static uint16_t
+quantize(int64_t val, uint8_t bits)
+{
+  if (val < 0) val = 0;
+  if (val > 0xFFFF) val = 0xFFFF;
+
+  return (uint16_t) (val & ~((1 << (16 - bits)) - 1) & 0xFFFC);
+}
+
+uint16_t
+sim_sht21_rh_raw(sim_sht21 *dev, int32_t rh_m)
+{
+  return quantize(((int64_t) rh_m + 6000) * 65536 / 125000, rh_bits[dev_res(dev)]);
+}
+
+uint16_t
+sim_sht21_temp_raw(sim_sht21 *dev, int32_t temp_mc)
+{
+  return quantize(((int64_t) temp_mc + 46850) * 65536 / 175720, temp_bits[dev_res(dev)]);
+}
+
+// Finish conversion and put measurement in the out buffer.
+static void
+meas_out(sim_sht21 *dev, uint8_t c)
+{
+  uint16_t raw;
+
+  dev->convs++;
+  if (is_rh(c)) {
+    raw = (uint16_t) (sim_sht21_rh_raw(dev, dev->rh_m) | 0x2);
+    dev->temp_last = sim_sht21_temp_raw(dev, dev->temp_mc);
+  } else {
+    raw = sim_sht21_temp_raw(dev, dev->temp_mc);
+  }
+
+  out[0] = (uint8_t) (raw >> 8);
+  out[1] = (uint8_t) raw;
+  out[2] = crc8(0, out, 2);
+  if (dev->crc_errs) {
+    dev->crc_errs--;
+    out[2] ^= 0x01;
+  }
+  out_len = 3;
+  out_idx = 0;
+}
+
+static sim_sht21 *
+find(uint8_t addr)
+{
+  uint8_t idx;
+  sim_sht21 *dev;
+
+  for (idx = 0; idx < dev_cnt; idx++) {
+    dev = &devs[idx];
+    if (dev->addr != addr || dev->missing) continue;
+    if (dev->mux_ch >= 0 && (!mux_on || !(mux_mask & (1 << dev->mux_ch)))) continue;
+    return dev;
+  }
+
+  return NULL;
+}
+
+static void
+sn_out(sim_sht21 *dev, bool sna)
+{
+  uint8_t crc = 0;
+  uint8_t idx;
+
+  out_idx = 0;
+  out_len = 0;
+  if (sna) {
+    for (idx = 0; idx < 4; idx++) {
+      crc = crc8(crc, &dev->sn[idx], 1);
+      out[out_len++] = dev->sn[idx];
+      out[out_len++] = crc;
+    }
+    return;
+  }
+
+  for (idx = 4; idx < 8; idx += 2) {
+    crc = crc8(crc, &dev->sn[idx], 2);
+    out[out_len++] = dev->sn[idx];
+    out[out_len++] = dev->sn[idx + 1];
+    out[out_len++] = crc;
+  }
+}
+
+// Handle command byte written to SHT21.
+static void
+on_cmd(sim_sht21 *dev, uint8_t b)
+{
+  cmd[cmd_len++] = b;
+
+  switch (cmd[0]) {
+    case 0xE5: // RH, Hold Master.
+    case 0xE3: // Temperature, Hold Master.
+      hm_cmd = cmd[0];
+      break;
+
+    case 0xF5: // RH, No Hold Master.
+    case 0xF3: // Temperature, No Hold Master.
+      dev->conv_cmd = cmd[0];
+      dev->conv_end_ns = sim_now_ns + conv_ns(dev, cmd[0]);
+      break;
+
+    case 0xE0: // Temperature from previous RH measurement.
+      out[0] = (uint8_t) (dev->temp_last >> 8);
+      out[1] = (uint8_t) dev->temp_last;
+      out_len = 2;
+      out_idx = 0;
+      break;
+
+    case 0xE7: // Read user register 1.
+      out[0] = dev->ur1;
+      out_len = 1;
+      out_idx = 0;
+      break;
+
+    case 0xE6: // Write user register 1. Bits 6, 5, 4 and 3 are read only.
+      if (cmd_len == 2) dev->ur1 = (uint8_t) ((dev->ur1 & 0x78) | (b & 0x87));
+      break;
+
+    case 0x11: // Read heater control register.
+      out[0] = dev->hcr;
+      out_len = 1;
+      out_idx = 0;
+      break;
+
+    case 0x51: // Write heater control register.
+      if (cmd_len == 2) dev->hcr = (uint8_t) (b & 0x0F);
+      break;
+
+    case 0xFA: // Serial number SNA.
+      if (cmd_len == 2 && b == 0x0F) sn_out(dev, true);
+      break;
+
+    case 0xFC: // Serial number SNB.
+      if (cmd_len == 2 && b == 0xC9) sn_out(dev, false);
+      break;
+
+    case 0x84: // Firmware revision.
+      if (cmd_len == 2 && b == 0xB8) {
+        out[0] = SIM_SHT21_REV;
+        out_len = 1;
+        out_idx = 0;
+      }
+      break;
+
+    case 0xFE: // Soft reset.
+      dev->ur1 = SIM_SHT21_UR1_POR;
+      dev->hcr = 0;
+      break;
+
+    default:
+      break;
+  }
+
+  if (cmd_len == sizeof(cmd)) cmd_len = 1;
+}
+
+// Handle address byte. Returns acknowledge.
+static bool
+on_addr(uint8_t b)
+{
+  uint8_t addr = (uint8_t) (b >> 1);
+  bool rd = (b & 0x1) != 0;
+
+  if (mux_on && addr == mux_addr) {
+    target = NULL;
+    state = rd ? ST_READ : ST_WRITE;
+    out[0] = mux_mask;
+    out_len = 1;
+    out_idx = 0;
+    return true;
+  }
+
+  target = find(addr);
+  if (target == NULL) {
+    state = ST_NONE;
+    return false;
+  }
+
+  if (!rd) {
+    state = ST_WRITE;
+    cmd_len = 0;
+    return true;
+  }
+
+  // No Hold Master: read header not acknowledged until conversion is done.
+  if (target->conv_end_ns) {
+    if (sim_now_ns < target->conv_end_ns) {
+      target->nacks++;
+      state = ST_NONE;
+      return false;
+    }
+    target->conv_end_ns = 0;
+    meas_out(target, target->conv_cmd);
+  }
+
+  // Hold Master: clock stretched for the whole conversion.
+  if (hm_cmd) {
+    bus_time(conv_ns(target, hm_cmd));
+    meas_out(target, hm_cmd);
+    hm_cmd = 0;
+  }
+
+  state = ST_READ;
+
+  return true;
+}
+
+static void
+cond(bool start)
+{
+  bus_time(SIM_I2C_COND_US * 1000ULL);
+
+  if (start) {
+    sim_i2c_st.starts++;
+    if (in_xfer) sim_i2c_st.rstarts++;
+    in_xfer = true;
+    state = ST_ADDR;
+    return;
+  }
+
+  sim_i2c_st.stops++;
+  in_xfer = false;
+  state = ST_IDLE;
+  hm_cmd = 0;
+  out_len = 0;
+}
+
+// Write byte to the bus. Returns acknowledge.
+static bool
+byte_write(uint8_t b)
+{
+  sim_i2c_st.bytes_wr++;
+  bus_time(SIM_I2C_BYTE_US * 1000ULL);
+
+  switch (state) {
+    case ST_ADDR:
+      if (on_addr(b)) return true;
+      sim_i2c_st.nacks++;
+      return false;
+
+    case ST_WRITE:
+      if (target == NULL) {
+        mux_mask = b;
+      } else {
+        on_cmd(target, b);
+      }
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+static uint8_t
+byte_read(void)
+{
+  sim_i2c_st.bytes_rd++;
+  bus_time(SIM_I2C_BYTE_US * 1000ULL);
+
+  if (state != ST_READ || out_idx >= out_len) return 0xFF;
+
+  return out[out_idx++];
+}
+
+void
+sim_i2c_reset(void)
+{
+  memset(&sim_i2c_st, 0, sizeof(sim_i2c_st));
+  memset(devs, 0, sizeof(devs));
+  dev_cnt = 0;
+  mux_on = false;
+  mux_mask = 0;
+  state = ST_IDLE;
+  in_xfer = false;
+  hm_cmd = 0;
+  out_len = 0;
+}
+
+sim_sht21 *
+sim_i2c_add_sht21(uint8_t addr, int8_t mux_ch)
+{
+  sim_sht21 *dev;
+  uint8_t idx;
+
+  if (dev_cnt == SIM_I2C_MAX_DEVS) return NULL;
+
+  dev = &devs[dev_cnt];
+  dev->addr = addr;
+  dev->mux_ch = mux_ch;
+  dev->rh_m = 50000;
+  dev->temp_mc = 21000;
+  dev->ur1 = SIM_SHT21_UR1_POR;
+  dev->conv_pct = 100;
+  for (idx = 0; idx < 8; idx++) dev->sn[idx] = (uint8_t) (0x10 * dev_cnt + idx + 1);
+  dev_cnt++;
+
+  return dev;
+}
+
+void
+sim_i2c_add_mux(uint8_t addr)
+{
+  mux_on = true;
+  mux_addr = addr;
+  mux_mask = 0;
+}
+
+uint8_t
+sim_i2c_mux_mask(void)
+{
+  return mux_mask;
+}
+
+// ----------------------------------------------------------------------------
+// The esp_i2c API.
+// ----------------------------------------------------------------------------
+
+esp_i2c_err
+esp_i2c_init(uint8_t gpio_scl, uint8_t gpio_sda)
+{
+  (void) gpio_scl;
+  (void) gpio_sda;
+  sim_i2c_st.inits++;
+
+  return ESP_I2C_OK;
+}
+
+esp_i2c_err
+esp_i2c_start_read_write(uint8_t addr, bool check_ack)
+{
+  cond(true);
+  if (byte_write(addr) == false && check_ack) return ESP_I2C_ERR_NO_ACK;
+
+  return ESP_I2C_OK;
+}
+
+esp_i2c_err
+esp_i2c_start_read(uint8_t addr, uint8_t reg)
+{
+  esp_i2c_err err = esp_i2c_start_write(addr, reg);
+  if (err != ESP_I2C_OK) return err;
+
+  return esp_i2c_start_read_write(ESP_I2C_ADDR_READ(addr), true);
+}
+
+esp_i2c_err
+esp_i2c_start_write(uint8_t addr, uint8_t reg)
+{
+  esp_i2c_err err = esp_i2c_start_read_write(ESP_I2C_ADDR_WRITE(addr), true);
+  if (err != ESP_I2C_OK) return err;
+
+  return esp_i2c_write_bytes(&reg, 1);
+}
+
+esp_i2c_err
+esp_i2c_write_bytes(uint8_t *buf, uint16_t len)
+{
+  while (len--) {
+    if (byte_write(*buf++) == false) return ESP_I2C_ERR_NO_ACK;
+  }
+
+  return ESP_I2C_OK;
+}
+
+esp_i2c_err
+esp_i2c_read_bytes(uint8_t *buf, uint16_t len)
+{
+  while (len--) *buf++ = byte_read();
+
+  return ESP_I2C_OK;
+}
+
+esp_i2c_err
+esp_i2c_stop(void)
+{
+  cond(false);
+
+  return ESP_I2C_OK;
+}
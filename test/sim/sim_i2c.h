@@ -0,0 +1,138 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Simulated I2C bus with SHT21 (Si7021) slaves and TCA9548A mux.
+//
+// SHT21 answers measurement commands in Hold Master mode (clock
+// stretching for the conversion time) and No Hold Master mode (read
+// header not acknowledged until conversion is done), temperature from
+// previous humidity measurement, user and heater registers, serial
+// number and firmware revision. Measurements carry CRC and status bits.
+//
+// Bus runs at 100kHz: a byte with acknowledge takes 90us, START,
+// repeated START and STOP take 10us each.
+
+#ifndef SIM_I2C_H
+#define SIM_I2C_H
+
+#include <c_types.h>
+
+// Maximum number of SHT21 on the bus (behind the mux).
+#define SIM_I2C_MAX_DEVS 32
+// Byte with acknowledge in microseconds.
+#define SIM_I2C_BYTE_US 90
+// START, repeated START or STOP condition in microseconds.
+#define SIM_I2C_COND_US 10
+// User register 1 at power-on.
+#define SIM_SHT21_UR1_POR 0x3A
+// Firmware revision.
+#define SIM_SHT21_REV 0x20
+
+// Simulated SHT21.
+typedef struct {
+  uint8_t addr;         // The I2C address.
+  int8_t mux_ch;        // The mux channel or -1 when not behind mux.
+  int32_t rh_m;         // Humidity in 1/1000 % the next conversion reads.
+  int32_t temp_mc;      // Temperature in milli Celsius the next conversion reads.
+  uint8_t ur1;          // User register 1.
+  uint8_t hcr;          // Heater control register.
+  uint8_t sn[8];        // Serial number SNA_3..SNA_0, SNB_3..SNB_0.
+  bool missing;         // Is true when device does not answer.
+  uint8_t crc_errs;     // The number of next measurements with corrupted CRC.
+  uint8_t conv_pct;     // Conversion time in percent of datasheet maximum.
+  uint16_t temp_last;   // Temperature measured with last humidity.
+  uint64_t conv_end_ns; // No Hold Master conversion end time or zero.
+  uint8_t conv_cmd;     // No Hold Master conversion command.
+  uint32_t convs;       // The number of conversions.
+  uint32_t nacks;       // The number of not acknowledged read headers.
+} sim_sht21;
+
+// Bus statistics.
+typedef struct {
+  uint32_t starts;   // START conditions (including repeated).
+  uint32_t rstarts;  // Repeated START conditions.
+  uint32_t stops;    // STOP conditions.
+  uint32_t bytes_wr; // Bytes written (including address bytes).
+  uint32_t bytes_rd; // Bytes read.
+  uint32_t nacks;    // Not acknowledged address bytes.
+  uint32_t inits;    // Bus initializations.
+  uint64_t bus_ns;   // The time the bus was busy (including clock stretching).
+} sim_i2c_stats;
+
+// The bus statistics.
+extern sim_i2c_stats sim_i2c_st;
+
+
+/**
+ * Remove all devices and the mux, reset statistics.
+ */
+void
+sim_i2c_reset(void);
+
+/**
+ * Add SHT21 to the bus.
+ *
+ * Device starts at power-on state: 12/14 bit resolution, heater off,
+ * 50% humidity and 21 Celsius.
+ *
+ * @param addr   The I2C address.
+ * @param mux_ch The mux channel or -1 when not behind mux.
+ *
+ * @return The device.
+ */
+sim_sht21 *
+sim_i2c_add_sht21(uint8_t addr, int8_t mux_ch);
+
+/**
+ * Add TCA9548A mux to the bus.
+ *
+ * @param addr The mux I2C address.
+ */
+void
+sim_i2c_add_mux(uint8_t addr);
+
+/**
+ * Get the mux channel mask.
+ *
+ * @return The channel mask.
+ */
+uint8_t
+sim_i2c_mux_mask(void);
+
+/**
+ * Get raw humidity the device reports for given value.
+ *
+ * @param dev  The device.
+ * @param rh_m The humidity in 1/1000 %.
+ *
+ * @return The raw value with status bits cleared.
+ */
+uint16_t
+sim_sht21_rh_raw(sim_sht21 *dev, int32_t rh_m);
+
+/**
+ * Get raw temperature the device reports for given value.
+ *
+ * @param dev     The device.
+ * @param temp_mc The temperature in milli Celsius.
+ *
+ * @return The raw value with status bits cleared.
+ */
+uint16_t
+sim_sht21_temp_raw(sim_sht21 *dev, int32_t temp_mc);
+
+#endif //SIM_I2C_H
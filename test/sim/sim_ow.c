@@ -0,0 +1,563 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <sim.h>
+#include <sim_ow.h>
+#include <esp_ow.h>
+#include <mem.h>
+#include <string.h>
+
+// Number of simulated buses (GPIO0 to GPIO16).
+#define SIM_OW_BUSES 17
+
+// DS18B20 function commands.
+#define CMD_CONVERT 0x44
+#define CMD_READ_SP 0xBE
+#define CMD_WRITE_SP 0x4E
+#define CMD_READ_PWR 0xB4
+
+// Bus transaction state.
+typedef enum {
+  ST_IDLE,     // Waiting for reset.
+  ST_ROM,      // Waiting for ROM command.
+  ST_MATCH,    // Receiving ROM to match.
+  ST_FUNC,     // Waiting for function command.
+  ST_SEARCH,   // Search ROM triplets.
+  ST_READ,     // Sending out buffer.
+  ST_WRITE_SP, // Receiving scratchpad.
+  ST_CONVERT,  // Conversion in progress.
+  ST_READ_PWR, // Sending power supply mode.
+} bus_state;
+
+typedef struct {
+  sim_ds18b20 devs[SIM_OW_MAX_DEVS];
+  uint8_t cnt;
+  uint64_t sel;    // Selected devices bit mask.
+  bus_state state;
+  uint8_t bit;     // Bit index in current byte or search bit.
+  uint8_t byte;    // Byte being received.
+  uint8_t idx;     // Byte index in current state.
+  uint8_t buf[9];  // Received bytes or bytes to send.
+  uint8_t len;     // Number of bytes to send.
+  uint8_t phase;   // Search triplet phase.
+  sim_ow_stats stats;
+} sim_bus;
+
+static sim_bus buses[SIM_OW_BUSES];
+
+
+static uint8_t
+crc8(const uint8_t *data, uint8_t len)
+{
+  uint8_t crc = 0;
+  uint8_t i;
+
+  while (len--) {
+    crc ^= *data++;
+    for (i = 0; i < 8; i++) crc = (uint8_t) (crc & 1 ? (crc >> 1) ^ 0x8C : crc >> 1);
+  }
+
+  return crc;
+}
+
+static void
+bus_time(sim_bus *bus, uint32_t us)
+{
+  bus->stats.bus_ns += us * 1000ULL;
+  sim_advance_ns(us * 1000ULL);
+}
+
+static uint64_t
+present(sim_bus *bus)
+{
+  uint64_t mask = 0;
+  uint8_t i;
+
+  for (i = 0; i < bus->cnt; i++) {
+    if (!bus->devs[i].missing) mask |= 1ULL << i;
+  }
+
+  return mask;
+}
+
+static uint16_t
+conv_ms(sim_ds18b20 *dev)
+{
+  switch ((dev->cfg >> 5) & 0x3) {
+    case 0: return 94;
+    case 1: return 188;
+    case 2: return 375;
+    default: return 750;
+  }
+}
+
+// Finish conversion when its time passed.
+static void
+conv_update(sim_ds18b20 *dev)
+{
+  int32_t raw;
+  int8_t whole;
+
+  if (dev->conv_end_ns == 0 || sim_now_ns < dev->conv_end_ns) return;
+
+  // Round to nearest 1/16 and drop bits undefined at lower resolutions.
+  raw = dev->temp_mc * 16;
+  raw = (raw >= 0 ? raw + 500 : raw - 500) / 1000;
+  raw &= ~((1 << (3 - ((dev->cfg >> 5) & 0x3))) - 1);
+  dev->reg = (int16_t) raw;
+
+  whole = (int8_t) (dev->reg >> 4);
+  dev->alarm = whole >= (int8_t) dev->th || whole <= (int8_t) dev->tl;
+  dev->conv_end_ns = 0;
+  dev->convs++;
+}
+
+static void
+sp_build(sim_ds18b20 *dev, uint8_t *sp)
+{
+  conv_update(dev);
+
+  sp[0] = (uint8_t) (dev->reg & 0xFF);
+  sp[1] = (uint8_t) ((uint16_t) dev->reg >> 8);
+  sp[2] = dev->th;
+  sp[3] = dev->tl;
+  sp[4] = dev->cfg;
+  sp[5] = 0xFF;
+  sp[6] = (uint8_t) (0x10 - (dev->reg & 0x0F));
+  sp[7] = 0x10;
+  sp[8] = crc8(sp, 8);
+
+  dev->sp_reads++;
+  if (dev->crc_errs) {
+    dev->crc_errs--;
+    sp[0] ^= 0x01;
+  }
+}
+
+// Prepare wired-AND of data sent by selected devices.
+static void
+out_set(sim_bus *bus, bool rom)
+{
+  uint8_t sp[9];
+  uint8_t i, j;
+
+  memset(bus->buf, 0xFF, sizeof(bus->buf));
+  bus->len = (uint8_t) (rom ? 8 : 9);
+  for (i = 0; i < bus->cnt; i++) {
+    if (!(bus->sel & (1ULL << i))) continue;
+    if (rom) {
+      memcpy(sp, bus->devs[i].rom, 8);
+    } else {
+      sp_build(&bus->devs[i], sp);
+    }
+    for (j = 0; j < bus->len; j++) bus->buf[j] &= sp[j];
+  }
+
+  bus->state = ST_READ;
+  bus->idx = 0;
+}
+
+static void
+on_byte(sim_bus *bus, uint8_t b)
+{
+  sim_ds18b20 *dev;
+  uint64_t mask;
+  uint8_t i;
+
+  switch (bus->state) {
+    case ST_ROM:
+      bus->sel = present(bus);
+      if (b == ESP_OW_CMD_SKIP_ROM) {
+        bus->state = ST_FUNC;
+      } else if (b == ESP_OW_CMD_MATCH_ROM) {
+        bus->state = ST_MATCH;
+        bus->idx = 0;
+      } else if (b == ESP_OW_CMD_READ_ROM) {
+        out_set(bus, true);
+      } else if (b == ESP_OW_CMD_SEARCH_ROM || b == ESP_OW_CMD_SEARCH_ROM_ALERT) {
+        if (b == ESP_OW_CMD_SEARCH_ROM_ALERT) {
+          for (i = 0; i < bus->cnt; i++) {
+            conv_update(&bus->devs[i]);
+            if (!bus->devs[i].alarm) bus->sel &= ~(1ULL << i);
+          }
+        }
+        bus->state = ST_SEARCH;
+        bus->bit = 0;
+        bus->phase = 0;
+      } else {
+        bus->state = ST_IDLE;
+      }
+      break;
+
+    case ST_MATCH:
+      bus->buf[bus->idx++] = b;
+      if (bus->idx < 8) break;
+      mask = 0;
+      for (i = 0; i < bus->cnt; i++) {
+        if (memcmp(bus->devs[i].rom, bus->buf, 8) == 0) mask |= 1ULL << i;
+      }
+      bus->sel &= mask;
+      bus->state = ST_FUNC;
+      break;
+
+    case ST_FUNC:
+      if (b == CMD_CONVERT) {
+        for (i = 0; i < bus->cnt; i++) {
+          if (!(bus->sel & (1ULL << i))) continue;
+          dev = &bus->devs[i];
+          dev->conv_end_ns = sim_now_ns + conv_ms(dev) * 10000ULL * dev->conv_pct;
+        }
+        bus->state = ST_CONVERT;
+      } else if (b == CMD_READ_SP) {
+        out_set(bus, false);
+      } else if (b == CMD_WRITE_SP) {
+        bus->state = ST_WRITE_SP;
+        bus->idx = 0;
+      } else if (b == CMD_READ_PWR) {
+        bus->state = ST_READ_PWR;
+      } else {
+        bus->state = ST_IDLE;
+      }
+      break;
+
+    case ST_WRITE_SP:
+      for (i = 0; i < bus->cnt; i++) {
+        if (!(bus->sel & (1ULL << i))) continue;
+        dev = &bus->devs[i];
+        if (bus->idx == 0) dev->th = b;
+        if (bus->idx == 1) dev->tl = b;
+        if (bus->idx == 2) dev->cfg = (uint8_t) ((b & 0x60) | 0x1F);
+      }
+      if (++bus->idx == 3) bus->state = ST_IDLE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+static sim_bus *
+bus_get(uint8_t gpio_num)
+{
+  return &buses[gpio_num % SIM_OW_BUSES];
+}
+
+void
+sim_ow_reset(void)
+{
+  memset(buses, 0, sizeof(buses));
+}
+
+sim_ds18b20 *
+sim_ow_add(uint8_t gpio_num, uint64_t serial)
+{
+  sim_bus *bus = bus_get(gpio_num);
+  sim_ds18b20 *dev;
+  uint8_t i;
+
+  if (bus->cnt == SIM_OW_MAX_DEVS) return NULL;
+
+  dev = &bus->devs[bus->cnt++];
+  memset(dev, 0, sizeof(sim_ds18b20));
+  dev->rom[0] = 0x28;
+  for (i = 0; i < 6; i++) dev->rom[i + 1] = (uint8_t) (serial >> (8 * i));
+  dev->rom[7] = crc8(dev->rom, 7);
+  dev->reg = SIM_DS18B20_POR;
+  dev->temp_mc = 21000;
+  dev->th = 75;
+  dev->tl = 70;
+  dev->cfg = 0x7F;
+  dev->conv_pct = 100;
+
+  return dev;
+}
+
+uint8_t
+sim_ow_cnt(uint8_t gpio_num)
+{
+  return bus_get(gpio_num)->cnt;
+}
+
+sim_ds18b20 *
+sim_ow_dev(uint8_t gpio_num, uint8_t idx)
+{
+  return &bus_get(gpio_num)->devs[idx];
+}
+
+sim_ow_stats *
+sim_ow_stats_get(uint8_t gpio_num)
+{
+  return &bus_get(gpio_num)->stats;
+}
+
+int32_t
+sim_ds18b20_reg_mc(int16_t reg)
+{
+  return reg * 1000 / 16;
+}
+
+// ----------------------------------------------------------------------------
+// The esp_ow API.
+// ----------------------------------------------------------------------------
+
+void
+esp_ow_init(uint8_t gpio_num)
+{
+  (void) gpio_num;
+}
+
+bool
+esp_ow_reset(uint8_t gpio_num)
+{
+  sim_bus *bus = bus_get(gpio_num);
+
+  bus->stats.resets++;
+  bus_time(bus, SIM_OW_RESET_US);
+
+  bus->state = ST_ROM;
+  bus->bit = 0;
+  bus->byte = 0;
+  bus->sel = 0;
+
+  return present(bus) != 0;
+}
+
+void
+esp_ow_write_bit(uint8_t gpio_num, uint8_t bit)
+{
+  sim_bus *bus = bus_get(gpio_num);
+  uint8_t i;
+
+  bus->stats.slots++;
+  bus_time(bus, SIM_OW_SLOT_US);
+
+  if (bus->state == ST_SEARCH) {
+    // Devices with different bit leave the search.
+    for (i = 0; i < bus->cnt; i++) {
+      if (((bus->devs[i].rom[bus->bit / 8] >> (bus->bit % 8)) & 1) != (bit & 1)) {
+        bus->sel &= ~(1ULL << i);
+      }
+    }
+    bus->phase = 0;
+    if (++bus->bit == 64) bus->state = ST_IDLE;
+    return;
+  }
+
+  bus->byte |= (uint8_t) ((bit & 1) << bus->bit);
+  if (++bus->bit < 8) return;
+
+  on_byte(bus, bus->byte);
+  bus->bit = 0;
+  bus->byte = 0;
+}
+
+uint8_t
+esp_ow_read_bit(uint8_t gpio_num)
+{
+  sim_bus *bus = bus_get(gpio_num);
+  uint8_t bit = 1;
+  uint8_t i, b;
+
+  bus->stats.slots++;
+  bus_time(bus, SIM_OW_SLOT_US);
+
+  switch (bus->state) {
+    case ST_SEARCH:
+      if (bus->phase > 1) break;
+      for (i = 0; i < bus->cnt; i++) {
+        if (!(bus->sel & (1ULL << i))) continue;
+        b = (uint8_t) ((bus->devs[i].rom[bus->bit / 8] >> (bus->bit % 8)) & 1);
+        bit &= (uint8_t) (bus->phase == 0 ? b : !b);
+      }
+      bus->phase++;
+      break;
+
+    case ST_READ:
+      if (bus->idx >= bus->len) break;
+      bit = (uint8_t) ((bus->buf[bus->idx] >> bus->bit) & 1);
+      if (++bus->bit == 8) {
+        bus->bit = 0;
+        bus->idx++;
+      }
+      break;
+
+    case ST_CONVERT:
+      // Externally powered device holds the line low while converting.
+      for (i = 0; i < bus->cnt; i++) {
+        if (!(bus->sel & (1ULL << i))) continue;
+        conv_update(&bus->devs[i]);
+        if (bus->devs[i].conv_end_ns && !bus->devs[i].parasite) bit = 0;
+      }
+      break;
+
+    case ST_READ_PWR:
+      for (i = 0; i < bus->cnt; i++) {
+        if ((bus->sel & (1ULL << i)) && bus->devs[i].parasite) bit = 0;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return bit;
+}
+
+void
+esp_ow_write(uint8_t gpio_num, uint8_t byte)
+{
+  uint8_t i;
+
+  for (i = 0; i < 8; i++) esp_ow_write_bit(gpio_num, (uint8_t) ((byte >> i) & 1));
+  bus_get(gpio_num)->stats.bytes_wr++;
+}
+
+void
+esp_ow_write_bytes(uint8_t gpio_num, uint8_t *buf, uint16_t len)
+{
+  while (len--) esp_ow_write(gpio_num, *buf++);
+}
+
+uint8_t
+esp_ow_read(uint8_t gpio_num)
+{
+  uint8_t byte = 0;
+  uint8_t i;
+
+  for (i = 0; i < 8; i++) byte |= (uint8_t) (esp_ow_read_bit(gpio_num) << i);
+  bus_get(gpio_num)->stats.bytes_rd++;
+
+  return byte;
+}
+
+void
+esp_ow_read_bytes(uint8_t gpio_num, uint8_t *buf, uint16_t len)
+{
+  while (len--) *buf++ = esp_ow_read(gpio_num);
+}
+
+void
+esp_ow_match_dev(esp_ow_device *device)
+{
+  esp_ow_write(device->gpio_num, ESP_OW_CMD_MATCH_ROM);
+  esp_ow_write_bytes(device->gpio_num, device->rom, 8);
+}
+
+esp_ow_device *
+esp_ow_new_dev(uint8_t *rom)
+{
+  esp_ow_device *device = os_zalloc(sizeof(esp_ow_device));
+  if (device == NULL) return NULL;
+
+  memcpy(device->rom, rom, 8);
+
+  return device;
+}
+
+esp_ow_device *
+esp_ow_read_rom_dev(uint8_t gpio_num)
+{
+  uint8_t rom[8] = {0};
+  esp_ow_device *device;
+
+  if (esp_ow_reset(gpio_num)) {
+    esp_ow_write(gpio_num, ESP_OW_CMD_READ_ROM);
+    esp_ow_read_bytes(gpio_num, rom, 8);
+    if (crc8(rom, 7) != rom[7]) memset(rom, 0, 8);
+  }
+
+  device = esp_ow_new_dev(rom);
+  if (device != NULL) device->gpio_num = gpio_num;
+
+  return device;
+}
+
+esp_ow_err
+esp_ow_search_family(uint8_t gpio_num, esp_ow_cmd cmd, uint8_t family, esp_ow_device **list)
+{
+  uint8_t rom[8] = {0};
+  int8_t last_zero, last_disc = -1;
+  uint8_t idx, id, cmp, dir;
+  esp_ow_device *device, *tail = NULL;
+
+  *list = NULL;
+
+  do {
+    if (!esp_ow_reset(gpio_num)) return ESP_OW_OK;
+    esp_ow_write(gpio_num, cmd);
+
+    last_zero = -1;
+    for (idx = 0; idx < 64; idx++) {
+      id = esp_ow_read_bit(gpio_num);
+      cmp = esp_ow_read_bit(gpio_num);
+      if (id && cmp) {
+        // No devices in (alarm) search or device left the bus.
+        if (*list == NULL) return ESP_OW_OK;
+        esp_ow_free_device_list(*list, false);
+        *list = NULL;
+        return ESP_OW_ERR_NO_DEV;
+      }
+
+      if (id != cmp) {
+        dir = id;
+      } else if (idx == last_disc) {
+        dir = 1;
+      } else if (idx > last_disc) {
+        dir = 0;
+      } else {
+        dir = (uint8_t) ((rom[idx / 8] >> (idx % 8)) & 1);
+      }
+      if (dir == 0 && id == cmp) last_zero = idx;
+
+      if (dir) {
+        rom[idx / 8] |= (uint8_t) (1 << (idx % 8));
+      } else {
+        rom[idx / 8] &= (uint8_t) ~(1 << (idx % 8));
+      }
+      esp_ow_write_bit(gpio_num, dir);
+    }
+    last_disc = last_zero;
+
+    if (crc8(rom, 7) != rom[7]) return ESP_OW_ERR_BAD_CRC;
+    if (rom[0] != family) continue;
+
+    device = esp_ow_new_dev(rom);
+    if (device == NULL) return ESP_OW_ERR_MEM;
+    device->gpio_num = gpio_num;
+    if (tail == NULL) {
+      *list = device;
+    } else {
+      tail->next = device;
+    }
+    tail = device;
+  } while (last_disc >= 0);
+
+  return ESP_OW_OK;
+}
+
+void
+esp_ow_free_device_list(esp_ow_device *list, bool free_custom)
+{
+  esp_ow_device *next;
+
+  while (list != NULL) {
+    next = list->next;
+    if (free_custom && list->custom != NULL) os_free(list->custom);
+    os_free(list);
+    list = next;
+  }
+}
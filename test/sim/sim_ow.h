@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Simulated OneWire bus with DS18B20 devices.
+//
+// Devices answer reset, ROM (skip, match, search, alarm search, read) and
+// DS18B20 function commands (convert, read / write scratchpad, read power
+// supply) at bit level. Conversion takes resolution dependent time and
+// parasite powered devices can't signal conversion end on the bus.
+
+#ifndef SIM_OW_H
+#define SIM_OW_H
+
+#include <c_types.h>
+
+// Maximum number of devices on one bus.
+#define SIM_OW_MAX_DEVS 64
+// Reset and presence detect duration in microseconds.
+#define SIM_OW_RESET_US 960
+// Read or write time slot in microseconds.
+#define SIM_OW_SLOT_US 70
+// Temperature register at power-on (85 Celsius).
+#define SIM_DS18B20_POR 0x0550
+
+// Simulated DS18B20.
+typedef struct {
+  uint8_t rom[8];       // The ROM address.
+  int32_t temp_mc;      // Temperature in milli Celsius the next conversion reads.
+  int16_t reg;          // The temperature register.
+  uint8_t th;           // Alarm high threshold.
+  uint8_t tl;           // Alarm low threshold.
+  uint8_t cfg;          // Configuration register.
+  bool parasite;        // Is true when parasite powered.
+  bool missing;         // Is true when device does not answer.
+  bool alarm;           // Is true when last conversion was outside of TL..TH.
+  uint8_t crc_errs;     // The number of next scratchpad reads to corrupt.
+  uint8_t conv_pct;     // Conversion time in percent of datasheet maximum.
+  uint64_t conv_end_ns; // Conversion end time or zero.
+  uint32_t convs;       // The number of finished conversions.
+  uint32_t sp_reads;    // The number of scratchpad reads.
+} sim_ds18b20;
+
+// Bus statistics.
+typedef struct {
+  uint32_t resets;   // The number of reset pulses (transactions).
+  uint32_t slots;    // The number of read and write time slots.
+  uint32_t bytes_wr; // The number of whole bytes written.
+  uint32_t bytes_rd; // The number of whole bytes read.
+  uint64_t bus_ns;   // The time the bus was driven in ns.
+} sim_ow_stats;
+
+
+/**
+ * Remove all devices from all buses and reset statistics.
+ */
+void
+sim_ow_reset(void);
+
+/**
+ * Add DS18B20 to the bus.
+ *
+ * The ROM is built from family code 0x28, 48 bit serial and valid CRC.
+ * Device starts at power-on state: 85 Celsius, TH 75, TL 70, 12 bits.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param serial   The serial number.
+ *
+ * @return The device.
+ */
+sim_ds18b20 *
+sim_ow_add(uint8_t gpio_num, uint64_t serial);
+
+/**
+ * Get the number of devices on the bus.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ *
+ * @return The number of devices.
+ */
+uint8_t
+sim_ow_cnt(uint8_t gpio_num);
+
+/**
+ * Get device by index.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ * @param idx      The device index.
+ *
+ * @return The device.
+ */
+sim_ds18b20 *
+sim_ow_dev(uint8_t gpio_num, uint8_t idx);
+
+/**
+ * Get bus statistics.
+ *
+ * @param gpio_num The GPIO where OneWire bus is connected.
+ *
+ * @return The statistics.
+ */
+sim_ow_stats *
+sim_ow_stats_get(uint8_t gpio_num);
+
+/**
+ * Convert temperature register to milli Celsius.
+ *
+ * @param reg The register.
+ *
+ * @return The temperature.
+ */
+int32_t
+sim_ds18b20_reg_mc(int16_t reg);
+
+#endif //SIM_OW_H
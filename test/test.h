@@ -0,0 +1,59 @@
+/*
+ * Copyright 2017 Rafal Zajac <rzajac@gmail.com>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Minimal test runner for host tests.
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Number of failed checks.
+extern int test_fails;
+
+// Fail the test when condition is false.
+#define TEST_CHECK(cond) do {                                      \
+    if (!(cond)) {                                                 \
+      printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      test_fails++;                                                \
+    }                                                              \
+  } while (0)
+
+// Fail the test when values are not equal.
+#define TEST_EQ(exp, act) do {                                     \
+    long long test_e_ = (long long) (exp);                         \
+    long long test_a_ = (long long) (act);                         \
+    if (test_e_ != test_a_) {                                      \
+      printf("  %s:%d: %s: expected %lld got %lld\n",              \
+             __FILE__, __LINE__, #act, test_e_, test_a_);          \
+      test_fails++;                                                \
+    }                                                              \
+  } while (0)
+
+// Run test function and print its name.
+#define TEST_RUN(fn) do { printf("%s\n", #fn); fn(); } while (0)
+
+
+/**
+ * Print summary.
+ *
+ * @return Process exit code.
+ */
+int
+test_done(void);
+
+#endif //TEST_H